@@ -0,0 +1,29 @@
+<?php
+// Report syscalls per command for the active I/O backend.
+//
+//   php -d hiredis.use_uring=1 bench/io_syscalls.php [host] [port] [n]
+//   php -d hiredis.use_uring=0 bench/io_syscalls.php [host] [port] [n]
+
+$host = isset($argv[1]) ? $argv[1] : 'localhost';
+$port = isset($argv[2]) ? (int)$argv[2] : 6379;
+$n = isset($argv[3]) ? (int)$argv[3] : 100000;
+
+$h = new Hiredis();
+if (!$h->connect($host, $port)) {
+    fprintf(STDERR, "connect: %s\n", $h->getLastError());
+    exit(1);
+}
+$h->sendRaw('SET', 'bench:io', 'x');
+$start = $h->getIoStats();
+
+$t = microtime(true);
+for ($i = 0; $i < $n; $i++) {
+    $h->sendRaw('GET', 'bench:io');
+}
+$t = microtime(true) - $t;
+
+$end = $h->getIoStats();
+$syscalls = $end['syscalls'] - $start['syscalls'];
+$replies = $end['replies'] - $start['replies'];
+printf("backend=%s commands=%d syscalls=%d syscalls/cmd=%.2f cmds/s=%.0f\n",
+    $end['backend'], $replies, $syscalls, $syscalls / max(1, $replies), $n / $t);
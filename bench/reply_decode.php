@@ -0,0 +1,54 @@
+<?php
+// Time decoding of large flat and nested array replies. Run against two
+// builds of the extension to compare reply decoding paths.
+//
+//   php bench/reply_decode.php [host] [port] [elements] [iterations]
+
+$host = isset($argv[1]) ? $argv[1] : 'localhost';
+$port = isset($argv[2]) ? (int)$argv[2] : 6379;
+$elements = isset($argv[3]) ? (int)$argv[3] : 100000;
+$iterations = isset($argv[4]) ? (int)$argv[4] : 20;
+
+$h = new Hiredis();
+if (!$h->connect($host, $port)) {
+    fprintf(STDERR, "connect: %s\n", $h->getLastError());
+    exit(1);
+}
+
+$h->sendRaw('DEL', 'bench:list', 'bench:zset');
+foreach (array_chunk(range(1, $elements), 1000) as $chunk) {
+    $h->sendRawArray(array_merge(['RPUSH', 'bench:list'], $chunk));
+    $zadd = ['ZADD', 'bench:zset'];
+    foreach ($chunk as $i) {
+        $zadd[] = $i;
+        $zadd[] = "member:$i";
+    }
+    $h->sendRawArray($zadd);
+}
+
+function bench($label, $iterations, $fn) {
+    $fn();
+    $mem = memory_get_usage();
+    $t = microtime(true);
+    for ($i = 0; $i < $iterations; $i++) {
+        $r = $fn();
+    }
+    $t = (microtime(true) - $t) / $iterations;
+    printf("%-28s %8.2f ms/op %10d bytes\n", $label, $t * 1000, memory_get_usage() - $mem);
+}
+
+bench("LRANGE $elements", $iterations, function () use ($h) {
+    return $h->sendRaw('LRANGE', 'bench:list', 0, -1);
+});
+bench("ZRANGE $elements WITHSCORES", $iterations, function () use ($h) {
+    return $h->sendRaw('ZRANGE', 'bench:zset', 0, -1, 'WITHSCORES');
+});
+bench("EXEC 100 x LRANGE 1000", $iterations, function () use ($h) {
+    $h->sendRaw('MULTI');
+    for ($i = 0; $i < 100; $i++) {
+        $h->sendRaw('LRANGE', 'bench:list', 0, 999);
+    }
+    return $h->sendRaw('EXEC');
+});
+
+$h->sendRaw('DEL', 'bench:list', 'bench:zset');
@@ -1,6 +1,15 @@
 PHP_ARG_WITH(hiredis, for hiredis support,
 [  --with-hiredis             Include hiredis support])
 
+PHP_ARG_ENABLE(hiredis-uring, whether to use io_uring for hiredis I/O,
+[  --disable-hiredis-uring    Do not use liburing for hiredis I/O], yes, no)
+
+PHP_ARG_ENABLE(hiredis-tls, whether to build TLS support via hiredis_ssl,
+[  --disable-hiredis-tls      Do not use hiredis_ssl for TLS connections], yes, no)
+
+PHP_ARG_ENABLE(hiredis-usdt, whether to compile USDT probes into hiredis,
+[  --disable-hiredis-usdt     Do not compile sys/sdt.h tracepoints], yes, no)
+
 if test "$PHP_HIREDIS" != "no"; then
   dnl
   dnl Find header files
@@ -38,6 +47,66 @@ if test "$PHP_HIREDIS" != "no"; then
   ],[
     -L$HIREDIS_DIR/$PHP_LIBDIR -lm
   ])
+  PHP_CHECK_LIBRARY($LIBNAME, redisReconnect,
+  [
+    AC_DEFINE(HAVE_HIREDIS_RECONNECT,1,[Whether hiredis has redisReconnect])
+  ],[],[
+    -L$HIREDIS_DIR/$PHP_LIBDIR -lm
+  ])
+
+  dnl
+  dnl Check for liburing (optional io_uring I/O backend)
+  dnl
+  if test "$PHP_HIREDIS_URING" != "no"; then
+    AC_CHECK_HEADER([liburing.h], [
+      PHP_CHECK_LIBRARY(uring, io_uring_queue_init,
+      [
+        PHP_ADD_LIBRARY(uring, 1, HIREDIS_SHARED_LIBADD)
+        AC_DEFINE(HAVE_HIREDIS_URING,1,[Whether liburing is available])
+      ],[
+        AC_MSG_WARN([liburing not usable, falling back to blocking I/O])
+      ])
+    ])
+  fi
+
+  dnl
+  dnl Check for hiredis_ssl (optional TLS connections)
+  dnl
+  if test "$PHP_HIREDIS_TLS" != "no" && test -r $HIREDIS_DIR/include/hiredis/hiredis_ssl.h; then
+    PHP_CHECK_LIBRARY(hiredis_ssl, redisInitiateSSL,
+    [
+      PHP_ADD_LIBRARY_WITH_PATH(hiredis_ssl, $HIREDIS_DIR/$PHP_LIBDIR, HIREDIS_SHARED_LIBADD)
+      PHP_ADD_LIBRARY(ssl, 1, HIREDIS_SHARED_LIBADD)
+      PHP_ADD_LIBRARY(crypto, 1, HIREDIS_SHARED_LIBADD)
+      AC_DEFINE(HAVE_HIREDIS_SSL,1,[Whether hiredis_ssl is available for TLS connections])
+    ],[
+      AC_MSG_WARN([hiredis_ssl not usable, TLS disabled])
+    ],[
+      -L$HIREDIS_DIR/$PHP_LIBDIR -lhiredis -lssl -lcrypto
+    ])
+  fi
+
+  dnl
+  dnl Check for sys/sdt.h (optional USDT probes)
+  dnl
+  if test "$PHP_HIREDIS_USDT" != "no"; then
+    AC_CHECK_HEADER([sys/sdt.h], [
+      AC_DEFINE(HAVE_HIREDIS_USDT,1,[Whether sys/sdt.h is available for USDT probes])
+    ])
+  fi
+
+  dnl
+  dnl Check for pthreads (optional background reply reader)
+  dnl
+  AC_CHECK_HEADER([pthread.h], [
+    PHP_CHECK_LIBRARY(pthread, pthread_create,
+    [
+      PHP_ADD_LIBRARY(pthread, 1, HIREDIS_SHARED_LIBADD)
+      AC_DEFINE(HAVE_HIREDIS_THREADS,1,[Whether pthreads are available for the background reader])
+    ],[
+      AC_MSG_WARN([pthreads not usable, background reader disabled])
+    ])
+  ])
   PHP_SUBST(HIREDIS_SHARED_LIBADD)
 
   PHP_NEW_EXTENSION(hiredis, hiredis.c, $ext_shared)
@@ -35,11 +35,102 @@
 #include "SAPI.h"
 
 #include <hiredis.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <signal.h>
+#include <sched.h>
+#include <time.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+#if PHP_VERSION_ID >= 80100
+#include "php_network.h"
+#include "zend_fibers.h"
+#endif
+#if PHP_MAJOR_VERSION >= 7
+#include "zend_smart_str.h"
+#endif
+#if PHP_MAJOR_VERSION == 7
+#include "ext/spl/spl_array.h"
+#endif
+#if defined(HAVE_HIREDIS_SSL) && PHP_MAJOR_VERSION >= 7
+#include <arpa/inet.h>
+#include <openssl/err.h>
+#include <openssl/x509v3.h>
+#endif
+
+#define PHP_HIREDIS_STREAM_CHUNK (64 * 1024)
+#define PHP_HIREDIS_CHUNK_WINDOW 8
+#define PHP_HIREDIS_MIGRATE_WINDOW 64
+
+#if defined(HAVE_HIREDIS_THREADS) && PHP_MAJOR_VERSION >= 7
+#define PHP_HIREDIS_BG_READER 1
+#endif
+
+#if defined(HAVE_HIREDIS_RECONNECT) && PHP_MAJOR_VERSION >= 7
+#define PHP_HIREDIS_HEALTH 1
+#endif
+
+#if defined(HAVE_HIREDIS_SSL) && PHP_MAJOR_VERSION >= 7
+#define PHP_HIREDIS_TLS 1
+#define PHP_HIREDIS_IS_TLS(client) ((client)->tls_ssl != NULL)
+#else
+#define PHP_HIREDIS_IS_TLS(client) 0
+#endif
+
+/* USDT probes (provider "hiredis"), see bench/latency.bt. Each probe has a
+   semaphore that tracers bump while attached, so timestamps and reply
+   sizes are only computed when someone is listening. Without sys/sdt.h
+   everything compiles away. */
+#ifdef HAVE_HIREDIS_USDT
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+#define PHP_HIREDIS_PROBE_SEMAPHORE(name) \
+    __extension__ unsigned short hiredis_##name##_semaphore __attribute__((unused)) __attribute__((section(".probes")))
+#define PHP_HIREDIS_PROBE_ENABLED(name) __builtin_expect(hiredis_##name##_semaphore, 0)
+#define PHP_HIREDIS_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(hiredis, name, a1, a2, a3)
+#define PHP_HIREDIS_PROBE4(name, a1, a2, a3, a4) DTRACE_PROBE4(hiredis, name, a1, a2, a3, a4)
+#define PHP_HIREDIS_PROBE5(name, a1, a2, a3, a4, a5) DTRACE_PROBE5(hiredis, name, a1, a2, a3, a4, a5)
+#define PHP_HIREDIS_PROBE6(name, a1, a2, a3, a4, a5, a6) DTRACE_PROBE6(hiredis, name, a1, a2, a3, a4, a5, a6)
+PHP_HIREDIS_PROBE_SEMAPHORE(command__start);
+PHP_HIREDIS_PROBE_SEMAPHORE(command__done);
+PHP_HIREDIS_PROBE_SEMAPHORE(reply__done);
+PHP_HIREDIS_PROBE_SEMAPHORE(reply__build);
+PHP_HIREDIS_PROBE_SEMAPHORE(connect);
+PHP_HIREDIS_PROBE_SEMAPHORE(reconnect);
+#else
+#define PHP_HIREDIS_PROBE_ENABLED(name) 0
+#define PHP_HIREDIS_PROBE3(name, a1, a2, a3)
+#define PHP_HIREDIS_PROBE4(name, a1, a2, a3, a4)
+#define PHP_HIREDIS_PROBE5(name, a1, a2, a3, a4, a5)
+#define PHP_HIREDIS_PROBE6(name, a1, a2, a3, a4, a5, a6)
+#endif
+
+#ifdef HAVE_HIREDIS_URING
+#define PHP_HIREDIS_URING_ENTRIES 8
+#define PHP_HIREDIS_URING_BUF_SIZE (64 * 1024)
+#endif
+
+ZEND_DECLARE_MODULE_GLOBALS(hiredis)
 
 static zend_object_handlers hiredis_obj_handlers;
 static zend_class_entry *hiredis_ce;
 static zend_class_entry *hiredis_exception_ce;
 static HashTable hiredis_cmd_map;
+#if PHP_MAJOR_VERSION >= 7
+static zend_object_handlers hiredis_future_obj_handlers;
+static zend_class_entry *hiredis_future_ce;
+static zend_object_handlers hiredis_stream_arg_obj_handlers;
+static zend_class_entry *hiredis_stream_arg_ce;
+static zend_object_handlers hiredis_lazy_reply_obj_handlers;
+static zend_class_entry *hiredis_lazy_reply_ce;
+static zend_object_handlers hiredis_stream_consumer_obj_handlers;
+static zend_class_entry *hiredis_stream_consumer_ce;
+#endif
 
 ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_none, 0, 0, 0)
 ZEND_END_ARG_INFO()
@@ -55,6 +146,20 @@ ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_connect, 0, 0, 2)
     ZEND_ARG_INFO(0, timeout)
 ZEND_END_ARG_INFO()
 
+ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_connect_sentinel, 0, 0, 2)
+    ZEND_ARG_INFO(0, master_name)
+    ZEND_ARG_INFO(0, sentinels)
+    ZEND_ARG_INFO(0, timeout)
+    ZEND_ARG_INFO(0, replica)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_connect_tls, 0, 0, 2)
+    ZEND_ARG_INFO(0, host)
+    ZEND_ARG_INFO(0, port)
+    ZEND_ARG_INFO(0, options)
+    ZEND_ARG_INFO(0, timeout)
+ZEND_END_ARG_INFO()
+
 ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_connect_unix, 0, 0, 1)
     ZEND_ARG_INFO(0, path)
 ZEND_END_ARG_INFO()
@@ -79,13 +184,156 @@ ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_send_raw_array, 0, 0, 1)
     ZEND_ARG_INFO(0, command_argv)
 ZEND_END_ARG_INFO()
 
+ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_set_background_reader, 0, 0, 1)
+    ZEND_ARG_INFO(0, on_off)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_set_hedging, 0, 0, 1)
+    ZEND_ARG_INFO(0, replicas)
+    ZEND_ARG_INFO(0, options)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_set_health_check, 0, 0, 1)
+    ZEND_ARG_INFO(0, idle_ms)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_set_decode_hint, 0, 0, 2)
+    ZEND_ARG_INFO(0, command)
+    ZEND_ARG_INFO(0, hint)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_decode_next, 0, 0, 1)
+    ZEND_ARG_INFO(0, hint)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_set_lazy_replies, 0, 0, 1)
+    ZEND_ARG_INFO(0, min_elements)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_lazy_reply_offset, 0, 0, 1)
+    ZEND_ARG_INFO(0, offset)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_lazy_reply_offset_set, 0, 0, 2)
+    ZEND_ARG_INFO(0, offset)
+    ZEND_ARG_INFO(0, value)
+ZEND_END_ARG_INFO()
+
+#if PHP_MAJOR_VERSION >= 7
+ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_stream_consumer_construct, 0, 0, 4)
+    ZEND_ARG_OBJ_INFO(0, client, Hiredis, 0)
+    ZEND_ARG_INFO(0, stream)
+    ZEND_ARG_INFO(0, group)
+    ZEND_ARG_INFO(0, consumer)
+    ZEND_ARG_ARRAY_INFO(0, options, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_stream_consumer_create_group, 0, 0, 0)
+    ZEND_ARG_INFO(0, start_id)
+    ZEND_ARG_INFO(0, mkstream)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_stream_consumer_ack, 0, 0, 1)
+    ZEND_ARG_VARIADIC_INFO(0, ids)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_stream_consumer_claim, 0, 0, 1)
+    ZEND_ARG_INFO(0, min_idle_ms)
+    ZEND_ARG_INFO(0, start_id)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_stream_consumer_set_count, 0, 0, 1)
+    ZEND_ARG_INFO(0, count)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_stream_consumer_set_block, 0, 0, 1)
+    ZEND_ARG_INFO(0, block_ms)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_stream_consumer_set_auto_ack, 0, 0, 1)
+    ZEND_ARG_INFO(0, on_off)
+ZEND_END_ARG_INFO()
+#endif
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_mget_chunked, 0, 0, 2)
+    ZEND_ARG_INFO(0, keys)
+    ZEND_ARG_INFO(0, chunk)
+    ZEND_ARG_INFO(0, assoc)
+    ZEND_ARG_INFO(0, window)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_key_chunked, 0, 0, 3)
+    ZEND_ARG_INFO(0, key)
+    ZEND_ARG_INFO(0, items)
+    ZEND_ARG_INFO(0, chunk)
+    ZEND_ARG_INFO(0, assoc)
+    ZEND_ARG_INFO(0, window)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_migrate_keys, 0, 0, 2)
+    ZEND_ARG_INFO(0, dest)
+    ZEND_ARG_INFO(0, keys)
+    ZEND_ARG_INFO(0, window)
+    ZEND_ARG_INFO(0, replace)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_cached_get, 0, 0, 2)
+    ZEND_ARG_INFO(0, key)
+    ZEND_ARG_INFO(0, ttl_ms)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_cache_invalidate, 0, 0, 1)
+    ZEND_ARG_INFO(0, key)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_get_hot_keys, 0, 0, 0)
+    ZEND_ARG_INFO(0, limit)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_get_command_info, 0, 0, 1)
+    ZEND_ARG_INFO(0, cmd)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_get_to_stream, 0, 0, 2)
+    ZEND_ARG_INFO(0, key)
+    ZEND_ARG_INFO(0, stream)
+    ZEND_ARG_INFO(0, chunk_size)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_send_raw_array_to_stream, 0, 0, 2)
+    ZEND_ARG_INFO(0, command_argv)
+    ZEND_ARG_INFO(0, stream)
+    ZEND_ARG_INFO(0, chunk_size)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_stream_arg_construct, 0, 0, 1)
+    ZEND_ARG_INFO(0, stream)
+    ZEND_ARG_INFO(0, length)
+ZEND_END_ARG_INFO()
+
 ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_set_throw_exceptions, 0, 0, 1)
     ZEND_ARG_INFO(0, true_or_false)
 ZEND_END_ARG_INFO()
 
+ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_set_auto_pipeline, 0, 0, 1)
+    ZEND_ARG_INFO(0, true_or_false)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_hiredis_set_fiber_scheduler, 0, 0, 1)
+    ZEND_ARG_INFO(0, scheduler)
+ZEND_END_ARG_INFO()
+
+#ifndef ZEND_ACC_CTOR
+    #define ZEND_ACC_CTOR 0
+#endif
+
 #if PHP_MAJOR_VERSION >= 7
     typedef size_t strlen_t;
     #define Z_HIREDIS_P(zv) hiredis_obj_fetch(Z_OBJ_P((zv)))
+    #define Z_HIREDIS_FUTURE_P(zv) hiredis_future_obj_fetch(Z_OBJ_P((zv)))
+    #define Z_HIREDIS_STREAM_ARG_P(zv) hiredis_stream_arg_obj_fetch(Z_OBJ_P((zv)))
+    #define Z_HIREDIS_LAZY_REPLY_P(zv) hiredis_lazy_reply_obj_fetch(Z_OBJ_P((zv)))
+    #define Z_HIREDIS_STREAM_CONSUMER_P(zv) hiredis_stream_consumer_obj_fetch(Z_OBJ_P((zv)))
     #define MAKE_STD_ZVAL(zv) do { \
         zval _sz; \
         (zv) = &_sz; \
@@ -102,10 +350,33 @@ ZEND_END_ARG_INFO()
     #define ZEND_HASH_FOREACH_END() } } while (0)
 #endif
 
+/* Command args converted for redis*CommandArgv. Stream args (PHP 7+) are
+   left NULL in argv and recorded in streams. */
+typedef struct {
+    int argc;
+    char** argv;
+    size_t* argvlen;
+    zend_string** zstrs;
+    zval** streams;
+} hiredis_argv_t;
+
+/* Drop a cached Sentinel topology that an error shows to be stale */
+#if PHP_MAJOR_VERSION >= 7
+static void _hiredis_sentinel_on_error(hiredis_t* client);
+#define PHP_HIREDIS_SENTINEL_CHECK(client) do { \
+    if ((client)->sentinel_name) { \
+        _hiredis_sentinel_on_error(client); \
+    } \
+} while(0)
+#else
+#define PHP_HIREDIS_SENTINEL_CHECK(client)
+#endif
+
 /* Macro to set custom err and errstr together */
 #define PHP_HIREDIS_SET_ERROR_EX(client, perr, perrstr) do { \
     (client)->err = (perr); \
     snprintf((client)->errstr, sizeof((client)->errstr), "%s", (perrstr)); \
+    PHP_HIREDIS_SENTINEL_CHECK(client); \
     if ((client)->throw_exceptions) { \
         zend_throw_exception(hiredis_exception_ce, (client)->errstr, (client)->err); \
     } \
@@ -116,42 +387,46 @@ ZEND_END_ARG_INFO()
     PHP_HIREDIS_SET_ERROR_EX((client), (client)->ctx->err, (client)->ctx->errstr); \
 } while(0)
 
+/* Macro to fail while another Fiber is suspended in the middle of a
+   command on this client. Its request is on the wire and its reply not
+   read yet, so any other use would interleave with it. */
+#if PHP_VERSION_ID >= 80100
+#define PHP_HIREDIS_ENSURE_IDLE(client) do { \
+    if (_hiredis_fiber_busy(client)) { \
+        RETURN_FALSE; \
+    } \
+} while(0)
+#else
+#define PHP_HIREDIS_ENSURE_IDLE(client)
+#endif
+
 /* Macro to ensure ctx is not NULL */
 #define PHP_HIREDIS_ENSURE_CTX(client) do { \
     if (!(client)->ctx) { \
         PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "No redisContext"); \
         RETURN_FALSE; \
     } \
+    PHP_HIREDIS_ENSURE_IDLE(client); \
 } while(0)
 
-/* Macro to handle returning/throwing a zval to userland */
+/* Macro to handle returning/throwing a zval to userland. A top-level error
+   reply arrives as a plain string with reply_is_error set; an exception is
+   only created here, and only if throw_exceptions is on. */
 #if PHP_MAJOR_VERSION >= 7
     #define PHP_HIREDIS_RETVAL_COPY_DTOR 1
 #else
     #define PHP_HIREDIS_RETVAL_COPY_DTOR 0
 #endif
 #define PHP_HIREDIS_RETURN_OR_THROW(client, zv) do { \
-    if (Z_TYPE_P(zv) == IS_OBJECT && instanceof_function(Z_OBJCE_P(zv), hiredis_exception_ce)) { \
-        PHP_HIREDIS_SET_ERROR_EX((client), REDIS_ERR, _hidreis_get_exception_message(zv)); \
-        if (PHP_HIREDIS_RETVAL_COPY_DTOR) zval_dtor(zv); \
+    if ((client)->reply_is_error) { \
+        PHP_HIREDIS_SET_ERROR_EX((client), REDIS_ERR, Z_STRVAL_P(zv)); \
+        zval_dtor(zv); \
         RETVAL_FALSE; \
     } else { \
         RETVAL_ZVAL((zv), PHP_HIREDIS_RETVAL_COPY_DTOR, PHP_HIREDIS_RETVAL_COPY_DTOR); \
     } \
 } while(0)
 
-/* Return exception message */
-static char* _hidreis_get_exception_message(zval* ex) {
-    zval* zp = NULL;
-    #if PHP_MAJOR_VERSION >= 7
-        zval z = {0};
-        zp = zend_read_property(hiredis_exception_ce, ex, "message", sizeof("message")-1, 1, &z);
-    #else
-        zp = zend_read_property(hiredis_exception_ce, ex, "message", sizeof("message")-1, 1);
-    #endif
-    return Z_STRVAL_P(zp);
-}
-
 /* Fetch hiredis_t inside zval */
 #if PHP_MAJOR_VERSION >= 7
 static inline hiredis_t* hiredis_obj_fetch(zend_object* obj) {
@@ -163,6 +438,71 @@ static inline hiredis_t* hiredis_obj_fetch(zval* obj TSRMLS_DC) {
 }
 #endif
 
+/* Detach queued futures and free the pending queue */
+static void _hiredis_pipeline_free(hiredis_t* client) {
+    #if PHP_MAJOR_VERSION >= 7
+        int i;
+        for (i = 0; i < client->pending_len; i++) {
+            if (client->pending[i]) {
+                client->pending[i]->slot = -1;
+            }
+        }
+    #endif
+    if (client->pending) {
+        efree(client->pending);
+    }
+    if (client->sf_map) {
+        zend_hash_destroy(client->sf_map);
+        FREE_HASHTABLE(client->sf_map);
+    }
+    client->sf_map = NULL;
+    client->pending = NULL;
+    client->pending_len = 0;
+    client->pending_cap = 0;
+}
+
+#if PHP_VERSION_ID >= 80100
+/* Expose the fiber scheduler callable to the cycle collector */
+static HashTable* hiredis_obj_get_gc(zend_object* object, zval** table, int* n) {
+    hiredis_t* client = hiredis_obj_fetch(object);
+    *table = &client->fiber_scheduler;
+    *n = 1;
+    return zend_std_get_properties(object);
+}
+#endif
+
+#ifdef PHP_HIREDIS_BG_READER
+static void _hiredis_bg_free(hiredis_t* client);
+#endif
+#if PHP_MAJOR_VERSION >= 7
+static void _hiredis_lazy_scan_reset(hiredis_t* client);
+static void _hiredis_hedge_free(hiredis_t* client);
+static void _hiredis_hedge_reset_primary(hiredis_t* client);
+static int _hiredis_hedge_settle(hiredis_t* client);
+#define PHP_HIREDIS_HEDGE_SETTLE(client) \
+    ((client)->hedge_discard > 0 ? _hiredis_hedge_settle(client) : REDIS_OK)
+#endif
+static int _hiredis_io_get_reply(hiredis_t* client, zval* dest);
+static int _hiredis_io_before_send(hiredis_t* client);
+#if PHP_VERSION_ID >= 80100
+static int _hiredis_fiber_busy(hiredis_t* client);
+#endif
+#ifdef PHP_HIREDIS_HEALTH
+static void _hiredis_health_track_tx(hiredis_t* client, hiredis_argv_t* a);
+static int _hiredis_health_replay(hiredis_t* client);
+
+/* Coarse monotonic clock in ms for idle tracking */
+static uint64_t _hiredis_health_now_ms(void) {
+    struct timespec ts;
+    #ifdef CLOCK_MONOTONIC_COARSE
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    #else
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+    #endif
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+#endif
+
 /* Allocate/deallocate hiredis_t object */
 #if PHP_MAJOR_VERSION >= 7
 static void hiredis_obj_free(zend_object *object) {
@@ -175,15 +515,47 @@ static void hiredis_obj_free(zend_object *object) {
     if (!client) {
         return;
     }
+    #ifdef PHP_HIREDIS_BG_READER
+        _hiredis_bg_free(client);
+    #endif
     if (client->ctx) {
         redisFree(client->ctx);
     }
+    _hiredis_pipeline_free(client);
+    _hiredis_lazy_scan_reset(client);
+    _hiredis_hedge_free(client);
+    if (client->decode_hints) {
+        zend_hash_destroy(client->decode_hints);
+        FREE_HASHTABLE(client->decode_hints);
+    }
+    if (client->session_cmds) {
+        zend_hash_destroy(client->session_cmds);
+        FREE_HASHTABLE(client->session_cmds);
+    }
+    if (client->sentinel_name) {
+        efree(client->sentinel_name);
+    }
+    #ifdef PHP_HIREDIS_TLS
+        if (client->tls_key) {
+            efree(client->tls_key);
+        }
+        if (client->tls_name) {
+            efree(client->tls_name);
+        }
+    #endif
+    #if PHP_VERSION_ID >= 80100
+        zval_ptr_dtor(&client->fiber_scheduler);
+        zval_ptr_dtor(&client->fiber_stream);
+    #endif
     zend_object_std_dtor(&client->std);
-    efree(client);
 }
 static inline zend_object* hiredis_obj_new(zend_class_entry *ce) {
     hiredis_t* client;
     client = ecalloc(1, sizeof(hiredis_t) + zend_object_properties_size(ce));
+    #if PHP_VERSION_ID >= 80100
+        ZVAL_UNDEF(&client->fiber_scheduler);
+        ZVAL_UNDEF(&client->fiber_stream);
+    #endif
     zend_object_std_init(&client->std, ce);
     object_properties_init(&client->std, ce);
     client->std.handlers = &hiredis_obj_handlers;
@@ -198,6 +570,7 @@ static void hiredis_obj_free(void *obj TSRMLS_DC) {
     if (client->ctx) {
         redisFree(client->ctx);
     }
+    _hiredis_pipeline_free(client);
     zend_object_std_dtor(&client->std TSRMLS_CC);
     efree(client);
 }
@@ -239,6 +612,38 @@ static int _hiredis_set_keep_alive_int(hiredis_t* client, int interval) {
     return REDIS_OK;
 }
 
+#if PHP_MAJOR_VERSION >= 7
+/* Append z at idx of a packed array by writing the slot directly. hiredis
+   creates elements in order, so idx is always the next free slot, and the
+   array was sized for all elements in hiredis_replyobj_create_array. */
+static zend_always_inline zval* _hiredis_array_append(HashTable* ht, zend_ulong idx, zval* z) {
+    zval* slot;
+    if (!HT_IS_PACKED(ht) || idx != ht->nNumUsed || idx >= ht->nTableSize) {
+        return zend_hash_index_update(ht, idx, z);
+    }
+    #if PHP_VERSION_ID >= 80200
+        slot = ht->arPacked + idx;
+    #else
+        {
+            Bucket* p = ht->arData + idx;
+            p->h = idx;
+            p->key = NULL;
+            slot = &p->val;
+        }
+        #if PHP_VERSION_ID < 70300
+            if (ht->nInternalPointer == HT_INVALID_IDX) {
+                ht->nInternalPointer = idx;
+            }
+        #endif
+    #endif
+    ZVAL_COPY_VALUE(slot, z);
+    ht->nNumUsed = idx + 1;
+    ht->nNumOfElements++;
+    ht->nNextFreeElement = idx + 1;
+    return slot;
+}
+#endif
+
 /* redisReplyObjectFunctions: Nest zval in parent array */
 static zval* _hiredis_replyobj_nest(const redisReadTask* task, zval* z) {
     zval* rv = z;
@@ -247,7 +652,7 @@ static zval* _hiredis_replyobj_nest(const redisReadTask* task, zval* z) {
         parent = (zval*)task->parent->obj;
         assert(Z_TYPE_P(parent) == IS_ARRAY);
         #if PHP_MAJOR_VERSION >= 7
-            rv = zend_hash_index_update(Z_ARRVAL_P(parent), task->idx, z);
+            rv = _hiredis_array_append(Z_ARRVAL_P(parent), task->idx, z);
         #else
             add_index_zval(parent, task->idx, z);
         #endif
@@ -265,25 +670,129 @@ static zval* _hiredis_replyobj_get_zval(const redisReadTask* task, zval* stack_z
             MAKE_STD_ZVAL(rv);
         #endif
     } else {
-        rv = (zval*)task->privdata;
+        rv = ((hiredis_t*)task->privdata)->reply_root;
     }
     return rv;
 }
 
+/* Init z as a HiredisException for an error nested in an array reply. The
+   object is built without the exception create_object handler so no
+   backtrace is captured for a value that is never thrown. */
+static void _hiredis_replyobj_error(zval* z, char* str, size_t len) {
+    #if PHP_MAJOR_VERSION >= 7
+        zend_object* obj;
+        obj = zend_objects_new(hiredis_exception_ce);
+        object_properties_init(obj, hiredis_exception_ce);
+        ZVAL_OBJ(z, obj);
+    #else
+        object_init_ex(z, hiredis_exception_ce);
+    #endif
+    #if PHP_VERSION_ID >= 80000
+        zend_update_property_stringl(hiredis_exception_ce, Z_OBJ_P(z), "message", sizeof("message")-1, str, len);
+    #else
+        zend_update_property_stringl(hiredis_exception_ce, z, "message", sizeof("message")-1, str, len);
+    #endif
+}
+
+#if PHP_MAJOR_VERSION >= 7
+/* Return a zend_string for a short reply string, shared with earlier
+   replies in this request. Single chars and "" come from the engine's
+   interned strings; anything else up to intern_max_len goes through a
+   per-request table (capped at PHP_HIREDIS_INTERN_MAX entries) whose
+   strings carry a precomputed hash, so they are cheap array keys. */
+static zend_string* _hiredis_intern(const char* str, size_t len) {
+    HashTable* ht;
+    zval* zv;
+    zval tmp;
+    zend_string* s;
+    if (len == 0) {
+        return ZSTR_EMPTY_ALLOC();
+    }
+    #if PHP_VERSION_ID >= 70300
+        if (len == 1) {
+            return ZSTR_CHAR((zend_uchar)*str);
+        }
+    #endif
+    if (!(ht = HIREDIS_G(intern_table))) {
+        ALLOC_HASHTABLE(ht);
+        zend_hash_init(ht, 64, NULL, ZVAL_PTR_DTOR, 0);
+        HIREDIS_G(intern_table) = ht;
+    } else if ((zv = zend_hash_str_find(ht, str, len))) {
+        return zend_string_copy(Z_STR_P(zv));
+    }
+    s = zend_string_init(str, len, 0);
+    if (zend_hash_num_elements(ht) < PHP_HIREDIS_INTERN_MAX) {
+        ZVAL_STR_COPY(&tmp, s);
+        zend_hash_add_new(ht, s, &tmp);
+    }
+    return s;
+}
+
+/* Init z as a number for a bulk string under a decode hint. Returns 0 to
+   keep it a string: it does not look numeric, or it is a key of a map. */
+static int _hiredis_decode_string(zval* z, long hint, const redisReadTask* task, const char* str, size_t len) {
+    zend_long lval;
+    double dval;
+    if (!(hint & (PHP_HIREDIS_DECODE_NUMERIC | PHP_HIREDIS_DECODE_DOUBLE))) {
+        return 0;
+    } else if ((hint & PHP_HIREDIS_DECODE_MAP) && !(task->parent && !task->parent->parent && (task->idx & 1))) {
+        return 0;
+    }
+    switch (is_numeric_string(str, len, &lval, &dval, 0)) {
+        case IS_LONG:
+            if (hint & PHP_HIREDIS_DECODE_DOUBLE) {
+                ZVAL_DOUBLE(z, (double)lval);
+            } else {
+                ZVAL_LONG(z, lval);
+            }
+            return 1;
+        case IS_DOUBLE:
+            ZVAL_DOUBLE(z, dval);
+            return 1;
+    }
+    // Sorted set scores may be infinite
+    if ((hint & PHP_HIREDIS_DECODE_DOUBLE) && len >= 3 && len <= 4 && strncasecmp(str + len - 3, "inf", 3) == 0
+        && (len == 3 || str[0] == '+' || str[0] == '-')
+    ) {
+        ZVAL_DOUBLE(z, str[0] == '-' ? -ZEND_INFINITY : ZEND_INFINITY);
+        return 1;
+    }
+    return 0;
+}
+
+/* Init z as a reply string, interning it if it is short enough */
+static zend_always_inline void _hiredis_zval_stringl(zval* z, const char* str, size_t len) {
+    if ((zend_long)len <= HIREDIS_G(intern_max_len)) {
+        ZVAL_STR(z, _hiredis_intern(str, len));
+    } else {
+        ZVAL_STRINGL(z, str, len);
+    }
+}
+#endif
+
 /* redisReplyObjectFunctions: Create string */
 static void* hiredis_replyobj_create_string(const redisReadTask* task, char* str, size_t len) {
     zval sz;
     zval* z = _hiredis_replyobj_get_zval(task, &sz);
-    if (task->type == REDIS_REPLY_ERROR) {
-        object_init_ex(z, hiredis_exception_ce);
-        zend_update_property_stringl(hiredis_exception_ce, z, "message", sizeof("message")-1, str, len);
+    if (task->type == REDIS_REPLY_ERROR && task->parent) {
+        _hiredis_replyobj_error(z, str, len);
     } else {
+        if (task->type == REDIS_REPLY_ERROR) {
+            ((hiredis_t*)task->privdata)->reply_is_error = 1;
+        }
         #if PHP_MAJOR_VERSION >= 7
-            ZVAL_STRINGL(z, str, len);
+            if (task->type != REDIS_REPLY_STRING || !((hiredis_t*)task->privdata)->decode_hint
+                || !_hiredis_decode_string(z, ((hiredis_t*)task->privdata)->decode_hint, task, str, len)
+            ) {
+                _hiredis_zval_stringl(z, str, len);
+            }
         #else
             ZVAL_STRINGL(z, str, len, 1);
         #endif
     }
+    if (PHP_HIREDIS_PROBE_ENABLED(reply__build)) {
+        PHP_HIREDIS_PROBE3(reply__build, task->type, (long long)len, task->parent == NULL);
+    }
     return (void*)_hiredis_replyobj_nest(task, z);
 }
 
@@ -292,6 +801,14 @@ static void* hiredis_replyobj_create_array(const redisReadTask* task, int len) {
     zval sz;
     zval* z = _hiredis_replyobj_get_zval(task, &sz);
     array_init_size(z, len);
+    #if PHP_MAJOR_VERSION >= 7
+        if (len > 0) {
+            zend_hash_real_init(Z_ARRVAL_P(z), 1);
+        }
+    #endif
+    if (PHP_HIREDIS_PROBE_ENABLED(reply__build)) {
+        PHP_HIREDIS_PROBE3(reply__build, task->type, (long long)len, task->parent == NULL);
+    }
     return (void*)_hiredis_replyobj_nest(task, z);
 }
 
@@ -300,6 +817,9 @@ static void* hiredis_replyobj_create_integer(const redisReadTask* task, long lon
     zval sz;
     zval* z = _hiredis_replyobj_get_zval(task, &sz);
     ZVAL_LONG(z, i);
+    if (PHP_HIREDIS_PROBE_ENABLED(reply__build)) {
+        PHP_HIREDIS_PROBE3(reply__build, task->type, i, task->parent == NULL);
+    }
     return (void*)_hiredis_replyobj_nest(task, z);
 }
 
@@ -308,6 +828,9 @@ static void* hiredis_replyobj_create_nil(const redisReadTask* task) {
     zval sz;
     zval* z = _hiredis_replyobj_get_zval(task, &sz);
     ZVAL_NULL(z);
+    if (PHP_HIREDIS_PROBE_ENABLED(reply__build)) {
+        PHP_HIREDIS_PROBE3(reply__build, task->type, -1LL, task->parent == NULL);
+    }
     return (void*)_hiredis_replyobj_nest(task, z);
 }
 
@@ -326,532 +849,6496 @@ static redisReplyObjectFunctions hiredis_replyobj_funcs = {
     hiredis_replyobj_free
 };
 
-/* Convert zval of type array to a C array of zvals. Call must free ret_zvals. */
-static void _hiredis_convert_zval_to_array_of_zvals(zval* arr, zval** ret_zvals, int* ret_num_zvals) {
-    zval* zvals;
-    zval* zv;
-    int argc;
-    int i;
-    if (Z_TYPE_P(arr) != IS_ARRAY) {
-        convert_to_array(arr);
+/* Set a connection error on ctx the way hiredis does */
+static void _hiredis_io_set_ctx_error(redisContext* c, int type, const char* str) {
+    c->err = type;
+    snprintf(c->errstr, sizeof(c->errstr), "%s", str);
+}
+
+/* Switch the socket between blocking and non-blocking mode, keeping
+   REDIS_BLOCK in sync so hiredis treats EAGAIN as "try again later" */
+static int _hiredis_io_set_blocking(hiredis_t* client, int blocking) {
+    redisContext* c = client->ctx;
+    int flags;
+    if ((flags = fcntl(c->fd, F_GETFL)) < 0
+        || fcntl(c->fd, F_SETFL, blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK)) < 0
+    ) {
+        _hiredis_io_set_ctx_error(c, REDIS_ERR_IO, strerror(errno));
+        return REDIS_ERR;
     }
-    argc = zend_hash_num_elements(Z_ARRVAL_P(arr));
-    zvals = (zval*)safe_emalloc(argc, sizeof(zval), 0);
-    i = 0;
+    if (blocking) {
+        c->flags |= REDIS_BLOCK;
+    } else {
+        c->flags &= ~REDIS_BLOCK;
+    }
+    return REDIS_OK;
+}
 
-    #if PHP_MAJOR_VERSION >= 7
-        ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(arr), zv) {
-            ZVAL_COPY_VALUE(&zvals[i], zv);
-            i++;
-        } ZEND_HASH_FOREACH_END();
-    #else
-        HashPosition hash_pos = NULL;
-        zval** hash_entry = NULL;
-        zend_hash_internal_pointer_reset_ex(Z_ARRVAL_P(arr), &hash_pos);
-        while (zend_hash_get_current_data_ex(Z_ARRVAL_P(arr), (void**)&hash_entry, &hash_pos) == SUCCESS) {
-            ZVAL_COPY_VALUE(&zvals[i], *hash_entry);
-            i++;
-            zend_hash_move_forward_ex(Z_ARRVAL_P(arr), &hash_pos);
+#if PHP_VERSION_ID >= 80100
+/* Get a stream resource for the socket that event loops can watch. It wraps
+   a dup of the fd so closing it never affects the connection. */
+static int _hiredis_fiber_stream(hiredis_t* client) {
+    php_stream* stream;
+    int fd;
+    if (Z_TYPE(client->fiber_stream) != IS_UNDEF && client->fiber_stream_fd == client->ctx->fd) {
+        return REDIS_OK;
+    }
+    zval_ptr_dtor(&client->fiber_stream);
+    ZVAL_UNDEF(&client->fiber_stream);
+    if ((fd = dup(client->ctx->fd)) < 0) {
+        _hiredis_io_set_ctx_error(client->ctx, REDIS_ERR_IO, strerror(errno));
+        return REDIS_ERR;
+    }
+    if (!(stream = php_stream_sock_open_from_socket(fd, NULL))) {
+        close(fd);
+        _hiredis_io_set_ctx_error(client->ctx, REDIS_ERR_IO, "Could not create stream for socket");
+        return REDIS_ERR;
+    }
+    php_stream_to_zval(stream, &client->fiber_stream);
+    client->fiber_stream_fd = client->ctx->fd;
+    return REDIS_OK;
+}
+
+/* Tell whether another Fiber owns the client, setting the error if so */
+static int _hiredis_fiber_busy(hiredis_t* client) {
+    if (!client->fiber_owner || client->fiber_owner == EG(active_fiber)) {
+        return 0;
+    }
+    PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "Client is in use by another Fiber");
+    return 1;
+}
+
+/* Hand the socket to the scheduler callback and suspend the current Fiber
+   until the scheduler resumes it. The Fiber owns the client meanwhile, as
+   the scheduler may run other Fibers from the callback or while we are
+   suspended. */
+static int _hiredis_fiber_wait(hiredis_t* client, int writable) {
+    zval args[3];
+    zval retval;
+    zend_fiber* prev_owner;
+    if (REDIS_OK != _hiredis_fiber_stream(client)) {
+        return REDIS_ERR;
+    }
+    ZVAL_COPY_VALUE(&args[0], &client->fiber_stream);
+    ZVAL_BOOL(&args[1], writable);
+    ZVAL_OBJ(&args[2], &EG(active_fiber)->std);
+    ZVAL_UNDEF(&retval);
+    prev_owner = client->fiber_owner;
+    client->fiber_owner = EG(active_fiber);
+    if (SUCCESS != call_user_function(NULL, NULL, &client->fiber_scheduler, &retval, 3, args) || EG(exception)) {
+        client->fiber_owner = prev_owner;
+        zval_ptr_dtor(&retval);
+        _hiredis_io_set_ctx_error(client->ctx, REDIS_ERR_OTHER, "Fiber scheduler callback failed");
+        return REDIS_ERR;
+    }
+    zval_ptr_dtor(&retval);
+    ZVAL_UNDEF(&retval);
+    zend_call_method_with_0_params(NULL, zend_ce_fiber, NULL, "suspend", &retval);
+    client->fiber_owner = prev_owner;
+    zval_ptr_dtor(&retval);
+    if (EG(exception)) {
+        // The reply is still in flight, so the connection cannot be reused
+        _hiredis_io_set_ctx_error(client->ctx, REDIS_ERR_OTHER, "Fiber resumed with an exception");
+        return REDIS_ERR;
+    }
+    return REDIS_OK;
+}
+#endif
+
+/* Wait until the socket is readable (or writable). Inside a Fiber with a
+   scheduler set this suspends the Fiber, otherwise it polls for up to
+   timeout_us. */
+static int _hiredis_io_wait(hiredis_t* client, int writable) {
+    struct pollfd pfd;
+    int rv, timeout_ms;
+    #ifdef PHP_HIREDIS_TLS
+        // Decrypted bytes already held by OpenSSL never show up in poll
+        if (!writable && client->tls_ssl && SSL_pending(client->tls_ssl) > 0) {
+            return REDIS_OK;
+        }
+    #endif
+    pfd.fd = client->ctx->fd;
+    pfd.events = writable ? POLLOUT : POLLIN;
+    pfd.revents = 0;
+    client->io_syscalls++;
+    if (poll(&pfd, 1, 0) > 0) {
+        return REDIS_OK;
+    }
+    #if PHP_VERSION_ID >= 80100
+        if (Z_TYPE(client->fiber_scheduler) != IS_UNDEF && EG(active_fiber)) {
+            return _hiredis_fiber_wait(client, writable);
         }
     #endif
+    timeout_ms = client->timeout_us > 0 ? (int)((client->timeout_us + 999) / 1000) : -1;
+    do {
+        client->io_syscalls++;
+        rv = poll(&pfd, 1, timeout_ms);
+    } while (rv < 0 && errno == EINTR);
+    if (rv == 0) {
+        _hiredis_io_set_ctx_error(client->ctx, REDIS_ERR_IO, strerror(EAGAIN));
+        return REDIS_ERR;
+    } else if (rv < 0) {
+        _hiredis_io_set_ctx_error(client->ctx, REDIS_ERR_IO, strerror(errno));
+        return REDIS_ERR;
+    }
+    return REDIS_OK;
+}
 
-    *ret_zvals = zvals;
-    *ret_num_zvals = argc;
+#ifdef PHP_HIREDIS_TLS
+/* Handle a failed SSL_read/SSL_write. In non-blocking mode this waits for
+   what OpenSSL asked for and returns REDIS_OK to retry; otherwise it sets
+   the error on the context. */
+static int _hiredis_tls_io_error(hiredis_t* client, int rv) {
+    redisContext* c = client->ctx;
+    unsigned long e;
+    const char* reason;
+    int err = SSL_get_error(client->tls_ssl, rv);
+    if ((err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) && !(c->flags & REDIS_BLOCK)) {
+        return _hiredis_io_wait(client, err == SSL_ERROR_WANT_WRITE);
+    } else if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
+        _hiredis_io_set_ctx_error(c, REDIS_ERR_IO, strerror(EAGAIN));
+    } else if (err == SSL_ERROR_ZERO_RETURN) {
+        _hiredis_io_set_ctx_error(c, REDIS_ERR_EOF, "Server closed the connection");
+    } else if (err == SSL_ERROR_SYSCALL && errno != 0) {
+        _hiredis_io_set_ctx_error(c, REDIS_ERR_IO, strerror(errno));
+    } else {
+        e = ERR_get_error();
+        reason = e ? ERR_reason_error_string(e) : NULL;
+        _hiredis_io_set_ctx_error(c, REDIS_ERR_IO, reason ? reason : "TLS error");
+    }
+    return REDIS_ERR;
 }
+#endif
 
-/* Actually send/queue a redis command. If `cmd` is not NULL, it is sent as the
-   first token, followed by `args`. Is `is_append` is set,
-   redisAppendCommandArgv is called instead of redisCommandArgv. */
-static void _hiredis_send_raw_array(INTERNAL_FUNCTION_PARAMETERS, hiredis_t* client, char* cmd, zval* args, int argc, int is_append) {
-    char** string_args;
-    size_t* string_lens;
-    zend_string** string_zstrs;
-    int i, j;
-    zval* zv;
-    int num_strings;
-
-    // Convert array of zvals to string + stringlen params. If cmd is not NULL
-    // make it the first arg.
-    num_strings = cmd ? argc + 1 : argc;
-    string_args = (char**)safe_emalloc(num_strings, sizeof(char*), 0);
-    string_lens = (size_t*)safe_emalloc(num_strings, sizeof(size_t), 0);
-    string_zstrs = (zend_string**)safe_emalloc(num_strings, sizeof(zend_string*), 0);
-    j = 0;
-    if (cmd) {
-        string_args[j] = cmd;
-        string_lens[j] = strlen(cmd);
-        string_zstrs[j] = NULL;
-        j++;
+#ifdef HAVE_HIREDIS_URING
+/* Get the shared io_uring, setting it up on first use in this process. The
+   ring is not carried over fork. */
+static struct io_uring* _hiredis_uring_get(void) {
+    struct iovec iov;
+    if (HIREDIS_G(ring_state) != 0 && HIREDIS_G(ring_pid) == getpid()) {
+        return HIREDIS_G(ring_state) > 0 ? &HIREDIS_G(ring) : NULL;
     }
-    for (i = 0; i < argc; i++, j++) {
-        zval* _zp = &args[i];
-        string_zstrs[j] = NULL;
-        if (
-            #if PHP_MAJOR_VERSION >= 7
-                Z_TYPE_P(_zp) == IS_TRUE || Z_TYPE_P(_zp) == IS_FALSE
-            #else
-                Z_TYPE_P(_zp) == IS_BOOL
+    if (HIREDIS_G(ring_state) > 0) {
+        io_uring_queue_exit(&HIREDIS_G(ring));
+    }
+    HIREDIS_G(ring_pid) = getpid();
+    HIREDIS_G(ring_state) = -1;
+    if (!HIREDIS_G(ring_buf)) {
+        HIREDIS_G(ring_buf) = pemalloc(PHP_HIREDIS_URING_BUF_SIZE, 1);
+    }
+    if (io_uring_queue_init(PHP_HIREDIS_URING_ENTRIES, &HIREDIS_G(ring), 0) < 0) {
+        return NULL;
+    }
+    iov.iov_base = HIREDIS_G(ring_buf);
+    iov.iov_len = PHP_HIREDIS_URING_BUF_SIZE;
+    if (io_uring_register_buffers(&HIREDIS_G(ring), &iov, 1) < 0) {
+        io_uring_queue_exit(&HIREDIS_G(ring));
+        return NULL;
+    }
+    HIREDIS_G(ring_state) = 1;
+    return &HIREDIS_G(ring);
+}
+
+/* Tear down the shared io_uring */
+static void _hiredis_uring_free(zend_hiredis_globals* g) {
+    if (g->ring_state > 0 && g->ring_pid == getpid()) {
+        io_uring_queue_exit(&g->ring);
+    }
+    g->ring_state = 0;
+    if (g->ring_buf) {
+        pefree(g->ring_buf, 1);
+        g->ring_buf = NULL;
+    }
+}
+
+/* Send the output buffer and read into the registered buffer with a single
+   io_uring_enter. The recv is linked behind the send and, if a timeout is
+   set, a link timeout is linked behind the recv. */
+static int _hiredis_uring_roundtrip(hiredis_t* client) {
+    redisContext* c = client->ctx;
+    struct io_uring* ring;
+    struct io_uring_sqe* sqe;
+    struct io_uring_cqe* cqe;
+    struct __kernel_timespec ts;
+    size_t wlen;
+    int nsub, i;
+    int sent = 0, nread = -ECANCELED;
+
+    if (!(ring = _hiredis_uring_get())) {
+        client->io_uring = 0;
+        return REDIS_OK;
+    }
+    nsub = 0;
+    wlen = sdslen(c->obuf);
+    if (wlen > 0) {
+        sqe = io_uring_get_sqe(ring);
+        io_uring_prep_send(sqe, c->fd, c->obuf, wlen, MSG_WAITALL);
+        sqe->flags |= IOSQE_IO_LINK;
+        sqe->user_data = 1;
+        nsub++;
+    }
+    sqe = io_uring_get_sqe(ring);
+    io_uring_prep_read_fixed(sqe, c->fd, HIREDIS_G(ring_buf), PHP_HIREDIS_URING_BUF_SIZE, 0, 0);
+    sqe->user_data = 2;
+    nsub++;
+    if (client->timeout_us > 0) {
+        sqe->flags |= IOSQE_IO_LINK;
+        sqe = io_uring_get_sqe(ring);
+        ts.tv_sec = client->timeout_us / 1000000;
+        ts.tv_nsec = (client->timeout_us % 1000000) * 1000;
+        io_uring_prep_link_timeout(sqe, &ts, 0);
+        sqe->user_data = 3;
+        nsub++;
+    }
+
+    client->io_syscalls++;
+    if (io_uring_submit_and_wait(ring, nsub) < 0) {
+        _hiredis_io_set_ctx_error(c, REDIS_ERR_IO, "io_uring_submit_and_wait failed");
+        return REDIS_ERR;
+    }
+    for (i = 0; i < nsub; i++) {
+        if (io_uring_wait_cqe(ring, &cqe) < 0) {
+            _hiredis_io_set_ctx_error(c, REDIS_ERR_IO, "io_uring_wait_cqe failed");
+            return REDIS_ERR;
+        }
+        if (cqe->user_data == 1) {
+            sent = cqe->res;
+        } else if (cqe->user_data == 2) {
+            nread = cqe->res;
+        }
+        io_uring_cqe_seen(ring, cqe);
+    }
+
+    if (sent < 0 && sent != -ECANCELED) {
+        if (sent == -EINVAL) {
+            // Kernel lacks IORING_OP_SEND; fall back to blocking I/O
+            client->io_uring = 0;
+            return REDIS_OK;
+        }
+        _hiredis_io_set_ctx_error(c, REDIS_ERR_IO, strerror(-sent));
+        return REDIS_ERR;
+    } else if (sent > 0) {
+        sdsrange(c->obuf, sent, -1);
+    }
+    if (nread > 0) {
+        if (REDIS_OK != redisReaderFeed(c->reader, HIREDIS_G(ring_buf), nread)) {
+            _hiredis_io_set_ctx_error(c, REDIS_ERR_PROTOCOL, c->reader->errstr);
+            return REDIS_ERR;
+        }
+    } else if (nread == 0) {
+        _hiredis_io_set_ctx_error(c, REDIS_ERR_EOF, "Server closed the connection");
+        return REDIS_ERR;
+    } else if (nread == -ECANCELED) {
+        // Either the link timeout fired or a short send broke the link, in
+        // which case the rest of the output buffer goes out next time.
+        if (client->timeout_us > 0 && sdslen(c->obuf) == 0) {
+            _hiredis_io_set_ctx_error(c, REDIS_ERR_IO, strerror(EAGAIN));
+            return REDIS_ERR;
+        }
+    } else if (nread == -EINVAL) {
+        client->io_uring = 0;
+    } else {
+        _hiredis_io_set_ctx_error(c, REDIS_ERR_IO, strerror(-nread));
+        return REDIS_ERR;
+    }
+    return REDIS_OK;
+}
+#endif
+
+/* Write the whole output buffer */
+static int _hiredis_io_flush(hiredis_t* client) {
+    redisContext* c = client->ctx;
+    int wdone = 0;
+    while (!wdone) {
+        if (sdslen(c->obuf) > 0) client->io_syscalls++;
+        if (REDIS_OK != redisBufferWrite(c, &wdone)) {
+            return REDIS_ERR;
+        }
+        if (!wdone && REDIS_OK != _hiredis_io_wait(client, 1)) {
+            return REDIS_ERR;
+        }
+    }
+    return REDIS_OK;
+}
+
+/* Read raw bytes from the socket, bypassing the reply reader */
+static ssize_t _hiredis_io_recv(hiredis_t* client, char* buf, size_t len) {
+    redisContext* c = client->ctx;
+    ssize_t n;
+    #ifdef PHP_HIREDIS_TLS
+        if (client->tls_ssl) {
+            for (;;) {
+                client->io_syscalls++;
+                ERR_clear_error();
+                if ((n = SSL_read(client->tls_ssl, buf, len > INT_MAX ? INT_MAX : (int)len)) > 0) {
+                    return n;
+                } else if (REDIS_OK != _hiredis_tls_io_error(client, (int)n)) {
+                    return -1;
+                }
+            }
+        }
+    #endif
+    for (;;) {
+        if (!(c->flags & REDIS_BLOCK) && REDIS_OK != _hiredis_io_wait(client, 0)) {
+            return -1;
+        }
+        client->io_syscalls++;
+        if ((n = read(c->fd, buf, len)) > 0) {
+            return n;
+        } else if (n == 0) {
+            _hiredis_io_set_ctx_error(c, REDIS_ERR_EOF, "Server closed the connection");
+            return -1;
+        } else if (errno == EINTR || (errno == EAGAIN && !(c->flags & REDIS_BLOCK))) {
+            continue;
+        }
+        _hiredis_io_set_ctx_error(c, REDIS_ERR_IO, strerror(errno));
+        return -1;
+    }
+}
+
+/* Write raw bytes to the socket, bypassing the output buffer */
+static int _hiredis_io_send(hiredis_t* client, const char* buf, size_t len) {
+    redisContext* c = client->ctx;
+    ssize_t n;
+    #ifdef PHP_HIREDIS_TLS
+        while (client->tls_ssl && len > 0) {
+            client->io_syscalls++;
+            ERR_clear_error();
+            if ((n = SSL_write(client->tls_ssl, buf, len > INT_MAX ? INT_MAX : (int)len)) > 0) {
+                buf += n;
+                len -= n;
+            } else if (REDIS_OK != _hiredis_tls_io_error(client, (int)n)) {
+                return REDIS_ERR;
+            }
+        }
+    #endif
+    while (len > 0) {
+        client->io_syscalls++;
+        if ((n = write(c->fd, buf, len)) > 0) {
+            buf += n;
+            len -= n;
+            continue;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && errno == EAGAIN && !(c->flags & REDIS_BLOCK)) {
+            if (REDIS_OK != _hiredis_io_wait(client, 1)) {
+                return REDIS_ERR;
+            }
+            continue;
+        }
+        _hiredis_io_set_ctx_error(c, REDIS_ERR_IO, n < 0 ? strerror(errno) : "write returned 0");
+        return REDIS_ERR;
+    }
+    return REDIS_OK;
+}
+
+#if PHP_MAJOR_VERSION >= 7
+/* Fetch hiredis_stream_arg_t inside zval */
+static inline hiredis_stream_arg_t* hiredis_stream_arg_obj_fetch(zend_object* obj) {
+    return (hiredis_stream_arg_t*)((char*)(obj) - XtOffsetOf(hiredis_stream_arg_t, std));
+}
+
+#ifdef __linux__
+/* sendfile(2) to the connection. Over TLS this only works when the kernel
+   does the encryption (kTLS); otherwise it fails with ENOSYS. */
+static ssize_t _hiredis_io_sendfile(hiredis_t* client, int fd, off_t* off, size_t len) {
+    #ifdef PHP_HIREDIS_TLS
+        if (client->tls_ssl) {
+            #ifdef SSL_OP_ENABLE_KTLS
+                ssize_t n;
+                if (BIO_get_ktls_send(SSL_get_wbio(client->tls_ssl))) {
+                    ERR_clear_error();
+                    if ((n = SSL_sendfile(client->tls_ssl, fd, *off, len, 0)) > 0) {
+                        *off += n;
+                    }
+                    return n;
+                }
             #endif
+            errno = ENOSYS;
+            return -1;
+        }
+    #endif
+    return sendfile(client->ctx->fd, fd, off, len);
+}
+#endif
+
+/* Copy len bytes of stream to the socket. Plain files with no buffered
+   data go through sendfile(2); anything else is read in chunks. */
+static int _hiredis_io_send_stream(hiredis_t* client, php_stream* stream, zend_off_t len) {
+    redisContext* c = client->ctx;
+    char* buf;
+    ssize_t got;
+    #ifdef __linux__
+        int fd;
+        off_t off;
+        if (php_stream_is(stream, PHP_STREAM_IS_STDIO)
+            && stream->readpos == stream->writepos
+            && SUCCESS == php_stream_cast(stream, PHP_STREAM_AS_FD | PHP_STREAM_CAST_INTERNAL, (void**)&fd, 0)
         ) {
-            string_args[j] = zend_is_true(_zp) ? "1" : "0";
-            string_lens[j] = 1;
-        } else {
-            if (Z_TYPE_P(_zp) != IS_STRING) {
-                #if PHP_MAJOR_VERSION >= 7
-                    convert_to_string_ex(_zp);
-                    string_zstrs[j] = Z_STR_P(_zp);
-                #else
-                    convert_to_string(_zp);
-                    string_zstrs[j] = Z_STRVAL_P(_zp);
-                #endif
+            off = php_stream_tell(stream);
+            while (len > 0) {
+                client->io_syscalls++;
+                got = _hiredis_io_sendfile(client, fd, &off, len > (1 << 30) ? (1 << 30) : (size_t)len);
+                if (got > 0) {
+                    len -= got;
+                } else if (got < 0 && errno == EINTR) {
+                    continue;
+                } else if (got < 0 && errno == EAGAIN && !(c->flags & REDIS_BLOCK)) {
+                    if (REDIS_OK != _hiredis_io_wait(client, 1)) {
+                        return REDIS_ERR;
+                    }
+                } else {
+                    break;
+                }
+            }
+            php_stream_seek(stream, off, SEEK_SET);
+            if (len == 0) {
+                return REDIS_OK;
+            } else if (got < 0 && errno != EINVAL && errno != ENOSYS) {
+                _hiredis_io_set_ctx_error(c, REDIS_ERR_IO, strerror(errno));
+                return REDIS_ERR;
+            } else if (got == 0) {
+                _hiredis_io_set_ctx_error(c, REDIS_ERR_IO, "Stream argument ended early");
+                return REDIS_ERR;
             }
-            string_args[j] = Z_STRVAL_P(_zp);
-            string_lens[j] = Z_STRLEN_P(_zp);
+            // sendfile not supported here; copy the rest below
         }
+    #endif
+    buf = emalloc(PHP_HIREDIS_STREAM_CHUNK);
+    while (len > 0) {
+        got = (ssize_t)php_stream_read(stream, buf, len > PHP_HIREDIS_STREAM_CHUNK ? PHP_HIREDIS_STREAM_CHUNK : (size_t)len);
+        if (got <= 0) {
+            efree(buf);
+            _hiredis_io_set_ctx_error(c, REDIS_ERR_IO, "Stream argument ended early");
+            return REDIS_ERR;
+        }
+        if (REDIS_OK != _hiredis_io_send(client, buf, got)) {
+            efree(buf);
+            return REDIS_ERR;
+        }
+        len -= got;
     }
+    efree(buf);
+    return REDIS_OK;
+}
 
-    // Send/queue command
-    if (is_append) {
-        if (REDIS_OK != redisAppendCommandArgv(client->ctx, num_strings, (const char**)string_args, string_lens)) {
-            PHP_HIREDIS_SET_ERROR(client);
-            RETVAL_FALSE;
-        } else {
-            RETVAL_TRUE;
+/* Resolve a stream arg to its stream and the number of bytes to send */
+static int _hiredis_stream_arg_resolve(zval* zv, php_stream** stream, zend_off_t* len) {
+    php_stream_statbuf ssb;
+    zval* zstream = zv;
+    *len = -1;
+    if (Z_TYPE_P(zv) == IS_OBJECT) {
+        hiredis_stream_arg_t* arg = Z_HIREDIS_STREAM_ARG_P(zv);
+        zstream = &arg->stream;
+        *len = arg->length;
+    }
+    php_stream_from_zval_no_verify(*stream, zstream);
+    if (!*stream) {
+        return REDIS_ERR;
+    }
+    if (*len < 0) {
+        if (0 != php_stream_stat(*stream, &ssb) || !S_ISREG(ssb.sb.st_mode)) {
+            return REDIS_ERR;
         }
-    } else {
-        redisReplyReaderSetPrivdata(client->ctx->reader, (void*)return_value);
-        if (zv = (zval*)redisCommandArgv(client->ctx, num_strings, (const char**)string_args, string_lens)) {
-            assert(zv == return_value);
-            PHP_HIREDIS_RETURN_OR_THROW(client, return_value);
-        } else {
-            PHP_HIREDIS_SET_ERROR(client);
-            RETVAL_FALSE;
+        *len = ssb.sb.st_size - php_stream_tell(*stream);
+    }
+    return *len >= 0 ? REDIS_OK : REDIS_ERR;
+}
+
+/* Write a command with stream args. The RESP framing and string args go
+   through the output buffer; each stream is copied to the socket right
+   after its length header, so it is never loaded into memory. Fails before
+   writing anything if a stream or its length cannot be resolved. */
+static int _hiredis_io_send_streamed(hiredis_t* client, hiredis_argv_t* a, const char** errstr) {
+    redisContext* c = client->ctx;
+    php_stream** streams;
+    zend_off_t* lens;
+    int i, rc = REDIS_OK;
+
+    streams = (php_stream**)safe_emalloc(a->argc, sizeof(php_stream*), 0);
+    lens = (zend_off_t*)safe_emalloc(a->argc, sizeof(zend_off_t), 0);
+    for (i = 0; i < a->argc; i++) {
+        if (a->streams[i] && REDIS_OK != _hiredis_stream_arg_resolve(a->streams[i], &streams[i], &lens[i])) {
+            *errstr = "Stream argument length unknown; wrap it in HiredisStreamArg with a length";
+            efree(streams);
+            efree(lens);
+            return REDIS_ERR;
         }
     }
 
-    // Cleanup
-    for (i = 0; i < num_strings; i++) {
-        if (string_zstrs[i]) {
-            #if PHP_MAJOR_VERSION >= 7
-                zend_string_release(string_zstrs[i]);
-            #else
-                STR_FREE(string_zstrs[i]);
-            #endif
+    *errstr = NULL;
+    c->obuf = sdscatprintf(c->obuf, "*%d\r\n", a->argc);
+    for (i = 0; i < a->argc && rc == REDIS_OK; i++) {
+        if (!a->streams[i]) {
+            c->obuf = sdscatprintf(c->obuf, "$%zu\r\n", a->argvlen[i]);
+            c->obuf = sdscatlen(c->obuf, a->argv[i], a->argvlen[i]);
+            c->obuf = sdscatlen(c->obuf, "\r\n", 2);
+            continue;
+        }
+        c->obuf = sdscatprintf(c->obuf, "$%lld\r\n", (long long)lens[i]);
+        if (REDIS_OK != _hiredis_io_flush(client)
+            || REDIS_OK != _hiredis_io_send_stream(client, streams[i], lens[i])
+        ) {
+            rc = REDIS_ERR;
         }
+        c->obuf = sdscatlen(c->obuf, "\r\n", 2);
     }
-    efree(string_zstrs);
-    efree(string_args);
-    efree(string_lens);
+    efree(streams);
+    efree(lens);
+    return rc;
 }
+#endif
+
+/* Read a bulk string reply straight from the socket into `stream` using a
+   buffer of chunk_size bytes, so the payload is never held in memory. `ret`
+   gets the payload length, NULL for a nil reply, or the message of an error
+   reply (with reply_is_error set). Any other reply (status, integer,
+   RESP3 null, aggregates) is handed to the reader with the bytes read so
+   far and decoded into `ret` as usual. *stream_ok is cleared if the stream
+   refused a write; the rest of the payload is still drained. */
+static int _hiredis_io_reply_to_stream(hiredis_t* client, php_stream* stream, size_t chunk_size, zval* ret, int* stream_ok) {
+    redisContext* c = client->ctx;
+    char* buf;
+    char* eol;
+    size_t have, off, n;
+    long long len, payload_left, crlf_left;
+    ssize_t got;
 
-/* Prepare args for _hiredis_send_raw_array */
-static void _hiredis_send_raw(INTERNAL_FUNCTION_PARAMETERS, int is_array, int is_append) {
-    hiredis_t* client;
-    zval* zobj;
-    int argc;
-    zval* args;
     #if PHP_MAJOR_VERSION >= 7
-        zval* varargs;
-    #else
-        zval*** varargs;
+        if (REDIS_OK != PHP_HIREDIS_HEDGE_SETTLE(client)) {
+            return REDIS_ERR;
+        }
     #endif
+    client->reply_is_error = 0;
+    if (REDIS_OK != _hiredis_io_flush(client)) {
+        return REDIS_ERR;
+    }
+    buf = emalloc(chunk_size);
 
-    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "O+", &zobj, hiredis_ce, &varargs, &argc) == FAILURE) {
-        RETURN_FALSE;
+    // Read the type and length line
+    have = 0;
+    while (have == 0 || !(eol = memchr(buf, '\n', have))) {
+        if (have > 0 && buf[0] != '$' && buf[0] != '-') {
+            break;
+        } else if (have == chunk_size) {
+            _hiredis_io_set_ctx_error(c, REDIS_ERR_PROTOCOL, "Reply header too long");
+            goto fail;
+        }
+        if ((got = _hiredis_io_recv(client, buf + have, chunk_size - have)) < 0) {
+            goto fail;
+        }
+        have += got;
     }
-    if ((is_array && argc != 1) || (!is_array && argc < 1)) {
-        WRONG_PARAM_COUNT;
+    if (buf[0] != '$' && buf[0] != '-') {
+        if (REDIS_OK != redisReaderFeed(c->reader, buf, have)) {
+            _hiredis_io_set_ctx_error(c, REDIS_ERR_OOM, "Out of memory");
+            goto fail;
+        }
+        efree(buf);
+        return _hiredis_io_get_reply(client, ret);
+    }
+    off = eol - buf + 1;
+    if (off < 3 || buf[off - 2] != '\r') {
+        _hiredis_io_set_ctx_error(c, REDIS_ERR_PROTOCOL, "Malformed reply header");
+        goto fail;
+    }
+    if (buf[0] == '-') {
+        client->reply_is_error = 1;
+        #if PHP_MAJOR_VERSION >= 7
+            ZVAL_STRINGL(ret, buf + 1, off - 3);
+        #else
+            ZVAL_STRINGL(ret, buf + 1, off - 3, 1);
+        #endif
+        payload_left = crlf_left = 0;
+    } else if ((len = strtoll(buf + 1, NULL, 10)) < 0) {
+        ZVAL_NULL(ret);
+        payload_left = crlf_left = 0;
+    } else {
+        ZVAL_LONG(ret, (long)len);
+        payload_left = len;
+        crlf_left = 2;
     }
 
-    client = Z_HIREDIS_P(zobj);
-    PHP_HIREDIS_ENSURE_CTX(client);
-
-    #if PHP_MAJOR_VERSION >= 7
-        if (is_array) {
-            _hiredis_convert_zval_to_array_of_zvals(varargs, &args, &argc);
-        } else {
-            args = varargs;
+    // Copy the payload in chunk_size pieces, then drop the trailing CRLF
+    while (payload_left > 0 || crlf_left > 0) {
+        if (off == have) {
+            n = payload_left + crlf_left > (long long)chunk_size ? chunk_size : (size_t)(payload_left + crlf_left);
+            if ((got = _hiredis_io_recv(client, buf, n)) < 0) {
+                zval_dtor(ret);
+                goto fail;
+            }
+            off = 0;
+            have = got;
         }
-    #else
-        if (is_array) {
-            _hiredis_convert_zval_to_array_of_zvals(**varargs, &args, &argc);
+        if (payload_left > 0) {
+            n = have - off > (size_t)payload_left ? (size_t)payload_left : have - off;
+            if (*stream_ok && php_stream_write(stream, buf + off, n) != n) {
+                *stream_ok = 0;
+            }
+            payload_left -= n;
         } else {
-            int i;
-            args = (zval*)safe_emalloc(argc, sizeof(zval), 0);
-            for (i = 0; i < argc; i++) memcpy(&args[i], *(varargs[i]), sizeof(zval));
+            n = have - off > (size_t)crlf_left ? (size_t)crlf_left : have - off;
+            crlf_left -= n;
         }
-    #endif
+        off += n;
+    }
 
-    _hiredis_send_raw_array(INTERNAL_FUNCTION_PARAM_PASSTHRU, client, NULL, args, argc, is_append);
+    // Bytes past this reply belong to the reader
+    if (off < have) {
+        redisReaderFeed(c->reader, buf + off, have - off);
+    }
+    efree(buf);
+    client->io_replies++;
+    return REDIS_OK;
+
+fail:
+    efree(buf);
+    return REDIS_ERR;
+}
+
+/* Write out pending commands and feed the next read into the reader */
+static int _hiredis_io_fill(hiredis_t* client) {
+    redisContext* c = client->ctx;
+    #ifdef HAVE_HIREDIS_URING
+    if (client->io_uring) {
+        return _hiredis_uring_roundtrip(client);
+    }
+    #endif
+    if (REDIS_OK != _hiredis_io_flush(client)) {
+        return REDIS_ERR;
+    }
+    if (!(c->flags & REDIS_BLOCK) && REDIS_OK != _hiredis_io_wait(client, 0)) {
+        return REDIS_ERR;
+    }
+    client->io_syscalls++;
+    return redisBufferRead(c);
+}
 
+/* Read a reply into `dest`. This mirrors redisGetReply but goes through the
+   configured I/O backend and keeps syscall counters for getIoStats. */
+static int _hiredis_io_get_reply(hiredis_t* client, zval* dest) {
+    redisContext* c = client->ctx;
+    void* reply = NULL;
     #if PHP_MAJOR_VERSION >= 7
-        if (is_array) efree(args);
-    #else
-        efree(args);
-        efree(varargs);
+        if (REDIS_OK != PHP_HIREDIS_HEDGE_SETTLE(client)) {
+            return REDIS_ERR;
+        }
     #endif
+    client->reply_root = dest;
+    client->reply_is_error = 0;
+    redisReplyReaderSetPrivdata(c->reader, (void*)client);
+    if (REDIS_OK != redisGetReplyFromReader(c, &reply)) {
+        return REDIS_ERR;
+    }
+    while (!reply) {
+        if (REDIS_OK != _hiredis_io_fill(client)) {
+            return REDIS_ERR;
+        }
+        if (REDIS_OK != redisGetReplyFromReader(c, &reply)) {
+            return REDIS_ERR;
+        }
+    }
+    assert(reply == dest);
+    client->reply_root = NULL;
+    client->io_replies++;
+    return REDIS_OK;
 }
 
-/* Invoked after connecting */
-static int _hiredis_conn_init(hiredis_t* client) {
+#if PHP_MAJOR_VERSION >= 7
+/* Fetch hiredis_lazy_reply_t inside zval */
+static inline hiredis_lazy_reply_t* hiredis_lazy_reply_obj_fetch(zend_object* obj) {
+    return (hiredis_lazy_reply_t*)((char*)(obj) - XtOffsetOf(hiredis_lazy_reply_t, std));
+}
+
+/* Parse the integer of a RESP header line ending at eol */
+static int _hiredis_resp_int(const char* p, const char* eol, long long* out) {
+    long long v = 0;
+    int neg = 0;
+    if (p < eol && *p == '-') {
+        neg = 1;
+        p++;
+    }
+    if (p == eol || eol - p > 18) {
+        return 0;
+    }
+    for (; p < eol; p++) {
+        if (*p < '0' || *p > '9') {
+            return 0;
+        }
+        v = v * 10 + (*p - '0');
+    }
+    *out = neg ? -v : v;
+    return 1;
+}
+
+/* Return the end of the RESP value at p, or NULL if it is not complete
+   before end. Only header lines are searched for CR (memchr, which libc
+   vectorizes); bulk payloads are skipped by length. Nested arrays are
+   walked with a count of values still to skip rather than recursion. */
+static const char* _hiredis_resp_skip(const char* p, const char* end, int* err) {
+    const char* eol;
+    long long pending = 1;
+    long long n;
+    *err = 0;
+    while (pending > 0) {
+        if (p >= end || !(eol = memchr(p, '\r', end - p)) || eol + 1 >= end) {
+            return NULL;
+        }
+        switch (*p) {
+            case '+':
+            case '-':
+                break;
+            case ':':
+                if (!_hiredis_resp_int(p + 1, eol, &n)) {
+                    goto fail;
+                }
+                break;
+            case '$':
+                if (!_hiredis_resp_int(p + 1, eol, &n) || n < -1) {
+                    goto fail;
+                }
+                if (n >= 0) {
+                    if (end - (eol + 2) < n + 2) {
+                        return NULL;
+                    }
+                    eol += n + 2;
+                }
+                break;
+            case '*':
+                if (!_hiredis_resp_int(p + 1, eol, &n) || n < -1) {
+                    goto fail;
+                }
+                if (n > 0) {
+                    pending += n;
+                }
+                break;
+            default:
+                goto fail;
+        }
+        p = eol + 2;
+        pending--;
+    }
+    return p;
+
+fail:
+    *err = 1;
+    return NULL;
+}
+
+/* Decode the complete RESP value at p into z the way hiredis_replyobj_funcs
+   would for a nested value. Returns the end of the value. */
+static const char* _hiredis_resp_decode(const char* p, const char* end, zval* z) {
+    const char* eol = memchr(p, '\r', end - p);
+    long long n;
+    zval elem;
+    long long i;
+    switch (*p) {
+        case '+':
+            _hiredis_zval_stringl(z, p + 1, eol - p - 1);
+            break;
+        case '-':
+            _hiredis_replyobj_error(z, (char*)p + 1, eol - p - 1);
+            break;
+        case ':':
+            _hiredis_resp_int(p + 1, eol, &n);
+            ZVAL_LONG(z, n);
+            break;
+        case '$':
+            _hiredis_resp_int(p + 1, eol, &n);
+            if (n < 0) {
+                ZVAL_NULL(z);
+            } else {
+                _hiredis_zval_stringl(z, eol + 2, n);
+                eol += n + 2;
+            }
+            break;
+        default:
+            _hiredis_resp_int(p + 1, eol, &n);
+            if (n < 0) {
+                ZVAL_NULL(z);
+                break;
+            }
+            array_init_size(z, n);
+            if (n > 0) {
+                zend_hash_real_init(Z_ARRVAL_P(z), 1);
+            }
+            p = eol + 2;
+            for (i = 0; i < n; i++) {
+                p = _hiredis_resp_decode(p, end, &elem);
+                _hiredis_array_append(Z_ARRVAL_P(z), i, &elem);
+            }
+            return p;
+    }
+    return eol + 2;
+}
+
+/* Drop a partially built lazy reply index */
+static void _hiredis_lazy_scan_reset(hiredis_t* client) {
+    if (client->lazy_offsets) {
+        efree(client->lazy_offsets);
+    }
+    client->lazy_offsets = NULL;
+    client->lazy_count = 0;
+    client->lazy_done = 0;
+    client->lazy_off = 0;
+}
+
+/* Index the top-level elements of the reply at base, picking up where the
+   previous call stopped. Returns 1 once every element is indexed, 0 if
+   more input is needed and -1 if the reply should be decoded eagerly (not
+   an array, smaller than lazy_min, too large, or malformed). */
+static int _hiredis_lazy_scan(hiredis_t* client, const char* base, const char* end) {
+    const char* eol;
+    const char* p;
+    long long n;
+    int err;
+
+    if (!client->lazy_offsets) {
+        if (!(eol = memchr(base, '\r', end - base)) || eol + 1 >= end) {
+            return *base == '*' ? 0 : -1;
+        }
+        if (*base != '*' || !_hiredis_resp_int(base + 1, eol, &n)
+            || n < client->lazy_min || n >= UINT32_MAX
+        ) {
+            return -1;
+        }
+        client->lazy_offsets = safe_emalloc((size_t)n + 1, sizeof(uint32_t), 0);
+        client->lazy_count = (long)n;
+        client->lazy_done = 0;
+        client->lazy_off = eol + 2 - base;
+    }
+    while (client->lazy_done < client->lazy_count) {
+        p = _hiredis_resp_skip(base + client->lazy_off, end, &err);
+        if (err || (p && (size_t)(p - base) > UINT32_MAX)) {
+            _hiredis_lazy_scan_reset(client);
+            return -1;
+        }
+        if (!p) {
+            return 0;
+        }
+        client->lazy_offsets[client->lazy_done++] = (uint32_t)client->lazy_off;
+        client->lazy_off = p - base;
+    }
+    client->lazy_offsets[client->lazy_count] = (uint32_t)client->lazy_off;
+    return 1;
+}
+
+/* Read a reply into `dest`, returning an array of at least lazy_min
+   elements as a HiredisLazyReply. The reply bytes are indexed in place in
+   the reader buffer, then copied out once and consumed; anything else is
+   handed to _hiredis_io_get_reply. */
+static int _hiredis_io_get_reply_lazy(hiredis_t* client, zval* dest) {
+    redisReader* r = client->ctx->reader;
+    hiredis_lazy_reply_t* lr;
     int rc;
-    rc = REDIS_OK;
-    if (client->keep_alive_int_s >= 0) {
-        if (REDIS_OK != _hiredis_set_keep_alive_int(client, client->keep_alive_int_s)) {
-            rc = REDIS_ERR;
+
+    if (REDIS_OK != PHP_HIREDIS_HEDGE_SETTLE(client)) {
+        return REDIS_ERR;
+    }
+    if (client->lazy_min <= 0 || r->ridx != -1) {
+        return _hiredis_io_get_reply(client, dest);
+    }
+    for (;;) {
+        if (r->pos < r->len) {
+            rc = _hiredis_lazy_scan(client, r->buf + r->pos, r->buf + r->len);
+            if (rc < 0) {
+                break;
+            }
+            if (rc > 0) {
+                object_init_ex(dest, hiredis_lazy_reply_ce);
+                lr = Z_HIREDIS_LAZY_REPLY_P(dest);
+                lr->raw = zend_string_init(r->buf + r->pos, client->lazy_off, 0);
+                lr->offsets = client->lazy_offsets;
+                lr->count = (uint32_t)client->lazy_count;
+                client->lazy_offsets = NULL;
+                _hiredis_lazy_scan_reset(client);
+
+                // Consume the reply, compacting the buffer like hiredis does
+                r->pos += ZSTR_LEN(lr->raw);
+                if (r->pos >= 1024) {
+                    sdsrange(r->buf, r->pos, -1);
+                    r->pos = 0;
+                    r->len = sdslen(r->buf);
+                }
+                client->reply_is_error = 0;
+                client->io_replies++;
+                return REDIS_OK;
+            }
+        }
+        if (REDIS_OK != _hiredis_io_fill(client)) {
+            _hiredis_lazy_scan_reset(client);
+            return REDIS_ERR;
         }
     }
-    if (client->timeout_us >= 0) {
-        if (REDIS_OK != _hiredis_set_timeout(client, client->timeout_us)) {
-            rc = REDIS_ERR;
+    _hiredis_lazy_scan_reset(client);
+    return _hiredis_io_get_reply(client, dest);
+}
+
+/* Return element idx of a lazy reply, decoding it on first access */
+static zval* _hiredis_lazy_reply_get(hiredis_lazy_reply_t* lr, zend_long idx) {
+    uint32_t i;
+    if (idx < 0 || idx >= (zend_long)lr->count) {
+        return NULL;
+    }
+    if (!lr->values) {
+        lr->values = safe_emalloc(lr->count, sizeof(zval), 0);
+        for (i = 0; i < lr->count; i++) {
+            ZVAL_UNDEF(&lr->values[i]);
         }
     }
-    client->ctx->reader->maxbuf = client->max_read_buf;
-    client->ctx->reader->fn = &hiredis_replyobj_funcs;
-    return rc;
+    if (Z_ISUNDEF(lr->values[idx])) {
+        _hiredis_resp_decode(ZSTR_VAL(lr->raw) + lr->offsets[idx], ZSTR_VAL(lr->raw) + lr->offsets[idx + 1], &lr->values[idx]);
+    }
+    return &lr->values[idx];
+}
+
+/* Convert an ArrayAccess offset to an element index */
+static int _hiredis_lazy_reply_index(zval* offset, zend_long* idx) {
+    double d;
+    ZVAL_DEREF(offset);
+    switch (Z_TYPE_P(offset)) {
+        case IS_LONG:
+            *idx = Z_LVAL_P(offset);
+            return 1;
+        case IS_STRING:
+            return is_numeric_string(Z_STRVAL_P(offset), Z_STRLEN_P(offset), idx, &d, 0) == IS_LONG;
+        case IS_DOUBLE:
+        case IS_FALSE:
+        case IS_TRUE:
+            *idx = zval_get_long(offset);
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/* Allocate/deallocate hiredis_lazy_reply_t object */
+static void hiredis_lazy_reply_obj_free(zend_object *object) {
+    hiredis_lazy_reply_t* lr;
+    uint32_t i;
+    lr = hiredis_lazy_reply_obj_fetch(object);
+    if (lr->values) {
+        for (i = 0; i < lr->count; i++) {
+            zval_ptr_dtor(&lr->values[i]);
+        }
+        efree(lr->values);
+    }
+    if (lr->offsets) {
+        efree(lr->offsets);
+    }
+    if (lr->raw) {
+        zend_string_release(lr->raw);
+    }
+    zend_object_std_dtor(&lr->std);
+}
+static inline zend_object* hiredis_lazy_reply_obj_new(zend_class_entry *ce) {
+    hiredis_lazy_reply_t* lr;
+    lr = ecalloc(1, sizeof(hiredis_lazy_reply_t) + zend_object_properties_size(ce));
+    zend_object_std_init(&lr->std, ce);
+    object_properties_init(&lr->std, ce);
+    lr->std.handlers = &hiredis_lazy_reply_obj_handlers;
+    return &lr->std;
+}
+
+/* Object handlers so $reply[i], isset() and count() skip the ArrayAccess
+   method calls */
+#if PHP_MAJOR_VERSION >= 8
+static zval* hiredis_lazy_reply_read_dimension(zend_object* object, zval* offset, int type, zval* rv) {
+    hiredis_lazy_reply_t* lr = hiredis_lazy_reply_obj_fetch(object);
+#else
+static zval* hiredis_lazy_reply_read_dimension(zval* object, zval* offset, int type, zval* rv) {
+    hiredis_lazy_reply_t* lr = Z_HIREDIS_LAZY_REPLY_P(object);
+#endif
+    zend_long idx;
+    zval* zv;
+    if (type != BP_VAR_R && type != BP_VAR_IS) {
+        zend_throw_exception(hiredis_exception_ce, "HiredisLazyReply is read-only", 0);
+        return &EG(uninitialized_zval);
+    }
+    if (!offset || !_hiredis_lazy_reply_index(offset, &idx) || !(zv = _hiredis_lazy_reply_get(lr, idx))) {
+        return &EG(uninitialized_zval);
+    }
+    return zv;
+}
+
+#if PHP_MAJOR_VERSION >= 8
+static int hiredis_lazy_reply_has_dimension(zend_object* object, zval* offset, int check_empty) {
+    hiredis_lazy_reply_t* lr = hiredis_lazy_reply_obj_fetch(object);
+#else
+static int hiredis_lazy_reply_has_dimension(zval* object, zval* offset, int check_empty) {
+    hiredis_lazy_reply_t* lr = Z_HIREDIS_LAZY_REPLY_P(object);
+#endif
+    zend_long idx;
+    zval* zv;
+    if (!_hiredis_lazy_reply_index(offset, &idx) || !(zv = _hiredis_lazy_reply_get(lr, idx))) {
+        return 0;
+    }
+    return check_empty ? i_zend_is_true(zv) : Z_TYPE_P(zv) != IS_NULL;
+}
+
+#if PHP_MAJOR_VERSION >= 8
+static int hiredis_lazy_reply_count_elements(zend_object* object, zend_long* count) {
+    *count = hiredis_lazy_reply_obj_fetch(object)->count;
+#else
+static int hiredis_lazy_reply_count_elements(zval* object, zend_long* count) {
+    *count = Z_HIREDIS_LAZY_REPLY_P(object)->count;
+#endif
+    return SUCCESS;
+}
+
+/* foreach over a lazy reply decodes one element per step */
+typedef struct {
+    zend_object_iterator it;
+    uint32_t pos;
+} hiredis_lazy_reply_iter_t;
+
+static void hiredis_lazy_reply_iter_dtor(zend_object_iterator* it) {
+    zval_ptr_dtor(&it->data);
+}
+
+static int hiredis_lazy_reply_iter_valid(zend_object_iterator* it) {
+    hiredis_lazy_reply_t* lr = Z_HIREDIS_LAZY_REPLY_P(&it->data);
+    return ((hiredis_lazy_reply_iter_t*)it)->pos < lr->count ? SUCCESS : FAILURE;
+}
+
+static zval* hiredis_lazy_reply_iter_get_current_data(zend_object_iterator* it) {
+    return _hiredis_lazy_reply_get(Z_HIREDIS_LAZY_REPLY_P(&it->data), ((hiredis_lazy_reply_iter_t*)it)->pos);
+}
+
+static void hiredis_lazy_reply_iter_get_current_key(zend_object_iterator* it, zval* key) {
+    ZVAL_LONG(key, ((hiredis_lazy_reply_iter_t*)it)->pos);
+}
+
+static void hiredis_lazy_reply_iter_move_forward(zend_object_iterator* it) {
+    ((hiredis_lazy_reply_iter_t*)it)->pos++;
+}
+
+static void hiredis_lazy_reply_iter_rewind(zend_object_iterator* it) {
+    ((hiredis_lazy_reply_iter_t*)it)->pos = 0;
+}
+
+static const zend_object_iterator_funcs hiredis_lazy_reply_iter_funcs = {
+    hiredis_lazy_reply_iter_dtor,
+    hiredis_lazy_reply_iter_valid,
+    hiredis_lazy_reply_iter_get_current_data,
+    hiredis_lazy_reply_iter_get_current_key,
+    hiredis_lazy_reply_iter_move_forward,
+    hiredis_lazy_reply_iter_rewind,
+    NULL,
+#if PHP_MAJOR_VERSION >= 8
+    NULL,
+#endif
+};
+
+static zend_object_iterator* hiredis_lazy_reply_get_iterator(zend_class_entry* ce, zval* object, int by_ref) {
+    hiredis_lazy_reply_iter_t* iter;
+    if (by_ref) {
+        zend_throw_exception(hiredis_exception_ce, "HiredisLazyReply is read-only", 0);
+        return NULL;
+    }
+    iter = ecalloc(1, sizeof(hiredis_lazy_reply_iter_t));
+    zend_iterator_init(&iter->it);
+    ZVAL_COPY(&iter->it.data, object);
+    iter->it.funcs = &hiredis_lazy_reply_iter_funcs;
+    iter->pos = 0;
+    return &iter->it;
+}
+#endif
+
+#ifdef PHP_HIREDIS_BG_READER
+/* Background reply reader. With it enabled, appendRaw writes each command
+   at once and a helper thread reads and parses the replies with its own
+   hiredis reader (plain redisReply objects, so no engine memory is
+   touched off the PHP thread). Parsed replies go into a single-producer
+   single-consumer ring; getReply pops them and builds zvals on the PHP
+   thread. The helper only reads while it has outstanding replies, so
+   once they are all parsed (see _hiredis_bg_drain) the connection can be
+   used directly again. */
+#define PHP_HIREDIS_BG_RING 1024
+#define PHP_HIREDIS_BG_BUF  (16*1024)
+
+struct _hiredis_bg_t {
+    pthread_t thread;
+    pthread_mutex_t mu;
+    pthread_cond_t cond;
+    int fd;
+    long timeout_ms;
+    redisReader* reader;
+    redisReply* ring[PHP_HIREDIS_BG_RING];
+    size_t head;       // next slot to pop; written by the PHP thread
+    size_t tail;       // next slot to push; written by the reader thread
+    long outstanding;  // replies sent for but not parsed yet
+    int stop;
+    int err;
+    char errstr[128];
+};
+
+/* Wake the other side */
+static void _hiredis_bg_signal(hiredis_bg_t* bg) {
+    pthread_mutex_lock(&bg->mu);
+    pthread_cond_broadcast(&bg->cond);
+    pthread_mutex_unlock(&bg->mu);
+}
+
+/* Sleep until signalled or 10ms pass. Callers re-check their condition. */
+static void _hiredis_bg_sleep(hiredis_bg_t* bg) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += 10 * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    pthread_mutex_lock(&bg->mu);
+    pthread_cond_timedwait(&bg->cond, &bg->mu, &ts);
+    pthread_mutex_unlock(&bg->mu);
+}
+
+/* Record a reader thread error and stop */
+static void _hiredis_bg_fail(hiredis_bg_t* bg, const char* errstr) {
+    snprintf(bg->errstr, sizeof(bg->errstr), "%s", errstr);
+    __atomic_store_n(&bg->err, 1, __ATOMIC_RELEASE);
+    _hiredis_bg_signal(bg);
+}
+
+/* Reader thread */
+static void* _hiredis_bg_main(void* arg) {
+    hiredis_bg_t* bg = (hiredis_bg_t*)arg;
+    char buf[PHP_HIREDIS_BG_BUF];
+    struct pollfd pfd;
+    void* reply;
+    ssize_t n;
+    long idle_ms = 0;
+    int rc;
+
+    while (!__atomic_load_n(&bg->stop, __ATOMIC_ACQUIRE)) {
+        // Ring full: wait for the PHP thread to pop
+        if (bg->tail - __atomic_load_n(&bg->head, __ATOMIC_ACQUIRE) >= PHP_HIREDIS_BG_RING) {
+            _hiredis_bg_sleep(bg);
+            continue;
+        }
+        // Hand over any reply already buffered
+        if (REDIS_OK != redisReaderGetReply(bg->reader, &reply)) {
+            _hiredis_bg_fail(bg, bg->reader->errstr);
+            break;
+        } else if (reply) {
+            bg->ring[bg->tail % PHP_HIREDIS_BG_RING] = (redisReply*)reply;
+            __atomic_store_n(&bg->tail, bg->tail + 1, __ATOMIC_RELEASE);
+            __atomic_sub_fetch(&bg->outstanding, 1, __ATOMIC_ACQ_REL);
+            _hiredis_bg_signal(bg);
+            continue;
+        }
+        // Nothing in flight: leave the socket alone
+        if (__atomic_load_n(&bg->outstanding, __ATOMIC_ACQUIRE) <= 0) {
+            _hiredis_bg_sleep(bg);
+            idle_ms = 0;
+            continue;
+        }
+        pfd.fd = bg->fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        rc = poll(&pfd, 1, 50);
+        if (rc == 0) {
+            idle_ms += 50;
+            if (bg->timeout_ms > 0 && idle_ms >= bg->timeout_ms) {
+                _hiredis_bg_fail(bg, "Timed out waiting for reply");
+                break;
+            }
+            continue;
+        } else if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            _hiredis_bg_fail(bg, strerror(errno));
+            break;
+        }
+        n = recv(bg->fd, buf, sizeof(buf), 0);
+        if (n > 0) {
+            redisReaderFeed(bg->reader, buf, n);
+            idle_ms = 0;
+        } else if (n == 0) {
+            _hiredis_bg_fail(bg, "Server closed the connection");
+            break;
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            _hiredis_bg_fail(bg, strerror(errno));
+            break;
+        }
+    }
+    return NULL;
+}
+
+/* Start the reader thread for client's connection */
+static int _hiredis_bg_start(hiredis_t* client) {
+    hiredis_bg_t* bg;
+    if (PHP_HIREDIS_IS_TLS(client)) {
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "Background reader cannot be used over TLS");
+        return REDIS_ERR;
+    }
+    bg = (hiredis_bg_t*)calloc(1, sizeof(hiredis_bg_t));
+    if (!bg || !(bg->reader = redisReaderCreate())) {
+        free(bg);
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR_OOM, "Out of memory");
+        return REDIS_ERR;
+    }
+    bg->reader->maxbuf = client->max_read_buf;
+    bg->fd = client->ctx->fd;
+    bg->timeout_ms = client->timeout_us > 0 ? client->timeout_us / 1000 : 0;
+    pthread_mutex_init(&bg->mu, NULL);
+    pthread_cond_init(&bg->cond, NULL);
+    if (0 != pthread_create(&bg->thread, NULL, _hiredis_bg_main, bg)) {
+        pthread_mutex_destroy(&bg->mu);
+        pthread_cond_destroy(&bg->cond);
+        redisReaderFree(bg->reader);
+        free(bg);
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "Failed to start background reader");
+        return REDIS_ERR;
+    }
+    client->bg = bg;
+    return REDIS_OK;
+}
+
+/* Stop the reader thread. Replies still in the ring are dropped. */
+static void _hiredis_bg_free(hiredis_t* client) {
+    hiredis_bg_t* bg = client->bg;
+    if (!bg) {
+        return;
+    }
+    __atomic_store_n(&bg->stop, 1, __ATOMIC_RELEASE);
+    _hiredis_bg_signal(bg);
+    pthread_join(bg->thread, NULL);
+    while (bg->head != bg->tail) {
+        freeReplyObject(bg->ring[bg->head++ % PHP_HIREDIS_BG_RING]);
+    }
+    redisReaderFree(bg->reader);
+    pthread_mutex_destroy(&bg->mu);
+    pthread_cond_destroy(&bg->cond);
+    free(bg);
+    client->bg = NULL;
+}
+
+/* Write the command just appended and hand its reply to the reader */
+static int _hiredis_bg_send(hiredis_t* client) {
+    if (!client->bg && REDIS_OK != _hiredis_bg_start(client)) {
+        return REDIS_ERR;
+    }
+    if (REDIS_OK != _hiredis_io_flush(client)) {
+        PHP_HIREDIS_SET_ERROR(client);
+        return REDIS_ERR;
+    }
+    __atomic_add_fetch(&client->bg->outstanding, 1, __ATOMIC_ACQ_REL);
+    _hiredis_bg_signal(client->bg);
+    return REDIS_OK;
+}
+
+/* Wait until the reader has parsed every outstanding reply, after which
+   the connection can be read directly */
+static int _hiredis_bg_drain(hiredis_t* client) {
+    hiredis_bg_t* bg = client->bg;
+    if (!bg) {
+        return REDIS_OK;
+    }
+    while (__atomic_load_n(&bg->outstanding, __ATOMIC_ACQUIRE) > 0) {
+        if (__atomic_load_n(&bg->err, __ATOMIC_ACQUIRE)) {
+            _hiredis_io_set_ctx_error(client->ctx, REDIS_ERR_IO, bg->errstr);
+            PHP_HIREDIS_SET_ERROR(client);
+            return REDIS_ERR;
+        }
+        _hiredis_bg_sleep(bg);
+    }
+    return REDIS_OK;
+}
+
+/* Convert a redisReply from the reader thread to a zval */
+static void _hiredis_bg_reply_to_zval(hiredis_t* client, redisReply* r, zval* z, int nested) {
+    zval elem;
+    size_t i;
+    switch (r->type) {
+        case REDIS_REPLY_ERROR:
+            if (nested) {
+                _hiredis_replyobj_error(z, r->str, r->len);
+                break;
+            }
+            client->reply_is_error = 1;
+            // Fall through
+        case REDIS_REPLY_STRING:
+        case REDIS_REPLY_STATUS:
+            _hiredis_zval_stringl(z, r->str, r->len);
+            break;
+        case REDIS_REPLY_INTEGER:
+            ZVAL_LONG(z, r->integer);
+            break;
+        case REDIS_REPLY_ARRAY:
+            array_init_size(z, r->elements);
+            if (r->elements > 0) {
+                zend_hash_real_init(Z_ARRVAL_P(z), 1);
+            }
+            for (i = 0; i < r->elements; i++) {
+                _hiredis_bg_reply_to_zval(client, r->element[i], &elem, 1);
+                _hiredis_array_append(Z_ARRVAL_P(z), i, &elem);
+            }
+            break;
+        default:
+            ZVAL_NULL(z);
+            break;
+    }
+}
+
+/* Pop the next reply parsed by the reader thread into dest */
+static int _hiredis_bg_pop(hiredis_t* client, zval* dest) {
+    hiredis_bg_t* bg = client->bg;
+    redisReply* reply;
+    while (bg->head == __atomic_load_n(&bg->tail, __ATOMIC_ACQUIRE)) {
+        if (__atomic_load_n(&bg->err, __ATOMIC_ACQUIRE)) {
+            _hiredis_io_set_ctx_error(client->ctx, REDIS_ERR_IO, bg->errstr);
+            return REDIS_ERR;
+        }
+        _hiredis_bg_sleep(bg);
+    }
+    reply = bg->ring[bg->head % PHP_HIREDIS_BG_RING];
+    __atomic_store_n(&bg->head, bg->head + 1, __ATOMIC_RELEASE);
+    _hiredis_bg_signal(bg);
+    client->reply_is_error = 0;
+    _hiredis_bg_reply_to_zval(client, reply, dest, 0);
+    freeReplyObject(reply);
+    client->io_replies++;
+    return REDIS_OK;
+}
+
+/* Whether getReply should be served from the ring */
+static inline int _hiredis_bg_has_reply(hiredis_t* client) {
+    return client->bg
+        && (client->bg->head != __atomic_load_n(&client->bg->tail, __ATOMIC_ACQUIRE)
+            || __atomic_load_n(&client->bg->outstanding, __ATOMIC_ACQUIRE) > 0);
+}
+#endif
+
+#if PHP_MAJOR_VERSION >= 7
+/* Fetch hiredis_future_t inside zval */
+static inline hiredis_future_t* hiredis_future_obj_fetch(zend_object* obj) {
+    return (hiredis_future_t*)((char*)(obj) - XtOffsetOf(hiredis_future_t, std));
+}
+
+/* Allocate/deallocate hiredis_future_t object. A queued future that goes
+   away before it is resolved leaves a NULL slot so its reply is discarded. */
+static void hiredis_future_obj_free(zend_object *object) {
+    hiredis_future_t* future;
+    future = hiredis_future_obj_fetch(object);
+    if (future->slot >= 0 && Z_TYPE(future->client) == IS_OBJECT) {
+        Z_HIREDIS_P(&future->client)->pending[future->slot] = NULL;
+    }
+    if (future->fanout) {
+        efree(future->fanout);
+    }
+    zval_ptr_dtor(&future->value);
+    zval_ptr_dtor(&future->client);
+    zend_object_std_dtor(&future->std);
+}
+static inline zend_object* hiredis_future_obj_new(zend_class_entry *ce) {
+    hiredis_future_t* future;
+    future = ecalloc(1, sizeof(hiredis_future_t) + zend_object_properties_size(ce));
+    ZVAL_UNDEF(&future->client);
+    ZVAL_UNDEF(&future->value);
+    future->state = PHP_HIREDIS_FUTURE_PENDING;
+    future->slot = -1;
+    zend_object_std_init(&future->std, ce);
+    object_properties_init(&future->std, ce);
+    future->std.handlers = &hiredis_future_obj_handlers;
+    return &future->std;
+}
+
+/* Allocate/deallocate hiredis_stream_arg_t object */
+static void hiredis_stream_arg_obj_free(zend_object *object) {
+    hiredis_stream_arg_t* arg;
+    arg = hiredis_stream_arg_obj_fetch(object);
+    zval_ptr_dtor(&arg->stream);
+    zend_object_std_dtor(&arg->std);
+}
+static inline zend_object* hiredis_stream_arg_obj_new(zend_class_entry *ce) {
+    hiredis_stream_arg_t* arg;
+    arg = ecalloc(1, sizeof(hiredis_stream_arg_t) + zend_object_properties_size(ce));
+    ZVAL_UNDEF(&arg->stream);
+    arg->length = -1;
+    zend_object_std_init(&arg->std, ce);
+    object_properties_init(&arg->std, ce);
+    arg->std.handlers = &hiredis_stream_arg_obj_handlers;
+    return &arg->std;
+}
+
+/* Create a future in `ret` for the command just appended to the output
+   buffer and queue it */
+static void _hiredis_pipeline_push(hiredis_t* client, zval* ret) {
+    hiredis_future_t* future;
+    if (client->pending_len >= client->pending_cap) {
+        client->pending_cap = client->pending_cap ? client->pending_cap * 2 : 16;
+        client->pending = (hiredis_future_t**)safe_erealloc(client->pending, client->pending_cap, sizeof(hiredis_future_t*), 0);
+    }
+    object_init_ex(ret, hiredis_future_ce);
+    future = Z_HIREDIS_FUTURE_P(ret);
+    ZVAL_OBJ(&future->client, &client->std);
+    Z_ADDREF(future->client);
+    future->slot = client->pending_len;
+    client->pending[client->pending_len++] = future;
+}
+
+/* Mark future as failed with errstr */
+static void _hiredis_future_fail(hiredis_future_t* future, const char* errstr) {
+    zval_ptr_dtor(&future->value);
+    ZVAL_STRING(&future->value, errstr);
+    future->state = PHP_HIREDIS_FUTURE_FAILED;
+    future->slot = -1;
+}
+#endif
+
+#if PHP_MAJOR_VERSION >= 7
+/* Expand the reply to a de-duplicated MGET/HMGET back to one element per
+   original arg. Duplicates share the same refcounted zval. */
+static void _hiredis_reply_fanout(zval* reply, uint32_t* fanout, int fanout_len) {
+    zval out;
+    zval* zv;
+    int i;
+    if (Z_TYPE_P(reply) != IS_ARRAY) {
+        return;
+    }
+    array_init_size(&out, fanout_len);
+    zend_hash_real_init(Z_ARRVAL(out), 1);
+    for (i = 0; i < fanout_len; i++) {
+        if ((zv = zend_hash_index_find(Z_ARRVAL_P(reply), fanout[i]))) {
+            Z_TRY_ADDREF_P(zv);
+            add_next_index_zval(&out, zv);
+        } else {
+            add_next_index_null(&out);
+        }
+    }
+    zval_ptr_dtor(reply);
+    ZVAL_COPY_VALUE(reply, &out);
+}
+#endif
+
+/* Read replies for all queued futures. Replies for futures that have since
+   been destroyed are read and discarded. */
+static int _hiredis_pipeline_flush(hiredis_t* client) {
+    int rc = REDIS_OK;
+    #if PHP_MAJOR_VERSION >= 7
+        int i;
+        zval discard;
+        hiredis_future_t* future;
+        const char* errstr = NULL;
+        if (!client->pending_len) {
+            return REDIS_OK;
+        }
+        for (i = 0; i < client->pending_len; i++) {
+            future = client->pending[i];
+            if (rc != REDIS_OK) {
+                if (future) _hiredis_future_fail(future, errstr);
+                continue;
+            }
+            ZVAL_UNDEF(&discard);
+            if (REDIS_OK != _hiredis_io_get_reply(client, future ? &future->value : &discard)) {
+                rc = REDIS_ERR;
+                errstr = client->ctx->errstr;
+                if (future) _hiredis_future_fail(future, errstr);
+            } else if (future) {
+                future->state = client->reply_is_error ? PHP_HIREDIS_FUTURE_FAILED : PHP_HIREDIS_FUTURE_READY;
+                future->slot = -1;
+                if (future->fanout && !client->reply_is_error) {
+                    _hiredis_reply_fanout(&future->value, future->fanout, future->fanout_len);
+                }
+            }
+            zval_ptr_dtor(&discard);
+        }
+        client->pending_len = 0;
+        if (client->sf_map) {
+            zend_hash_clean(client->sf_map);
+        }
+        if (rc != REDIS_OK) {
+            PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, errstr);
+        }
+    #endif
+    return rc;
+}
+
+/* Convert zval of type array to a C array of zvals. Call must free ret_zvals. */
+static void _hiredis_convert_zval_to_array_of_zvals(zval* arr, zval** ret_zvals, int* ret_num_zvals) {
+    zval* zvals;
+    zval* zv;
+    int argc;
+    int i;
+    if (Z_TYPE_P(arr) != IS_ARRAY) {
+        convert_to_array(arr);
+    }
+    argc = zend_hash_num_elements(Z_ARRVAL_P(arr));
+    zvals = (zval*)safe_emalloc(argc, sizeof(zval), 0);
+    i = 0;
+
+    #if PHP_MAJOR_VERSION >= 7
+        ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(arr), zv) {
+            ZVAL_COPY_VALUE(&zvals[i], zv);
+            i++;
+        } ZEND_HASH_FOREACH_END();
+    #else
+        HashPosition hash_pos = NULL;
+        zval** hash_entry = NULL;
+        zend_hash_internal_pointer_reset_ex(Z_ARRVAL_P(arr), &hash_pos);
+        while (zend_hash_get_current_data_ex(Z_ARRVAL_P(arr), (void**)&hash_entry, &hash_pos) == SUCCESS) {
+            ZVAL_COPY_VALUE(&zvals[i], *hash_entry);
+            i++;
+            zend_hash_move_forward_ex(Z_ARRVAL_P(arr), &hash_pos);
+        }
+    #endif
+
+    *ret_zvals = zvals;
+    *ret_num_zvals = argc;
+}
+
+/* COMMAND flag names mapped to hiredis_cmd_info_t flags */
+static const struct {
+    const char* name;
+    unsigned short flag;
+} hiredis_cmd_flag_names[] = {
+    { "write",       PHP_HIREDIS_CMD_WRITE },
+    { "readonly",    PHP_HIREDIS_CMD_READONLY },
+    { "denyoom",     PHP_HIREDIS_CMD_DENYOOM },
+    { "admin",       PHP_HIREDIS_CMD_ADMIN },
+    { "pubsub",      PHP_HIREDIS_CMD_PUBSUB },
+    { "noscript",    PHP_HIREDIS_CMD_NOSCRIPT },
+    { "fast",        PHP_HIREDIS_CMD_FAST },
+    { "movablekeys", PHP_HIREDIS_CMD_MOVABLEKEYS },
+    { "blocking",    PHP_HIREDIS_CMD_BLOCKING },
+    { "random",      PHP_HIREDIS_CMD_RANDOM },
+    { NULL, 0 }
+};
+
+/* Look up metadata for an upper case command name. The table loaded from
+   the server takes precedence over the builtin one. */
+static const hiredis_cmd_info_t* _hiredis_cmd_info_find(const char* cmd, size_t cmd_len) {
+    hiredis_cmd_info_t* info = NULL;
+    #if PHP_MAJOR_VERSION >= 7
+        if (HIREDIS_G(cmd_table)) {
+            info = zend_hash_str_find_ptr(HIREDIS_G(cmd_table), cmd, cmd_len);
+        }
+        if (!info) {
+            info = zend_hash_str_find_ptr(&hiredis_cmd_map, cmd, cmd_len);
+        }
+    #else
+        if (SUCCESS != zend_hash_find(&hiredis_cmd_map, cmd, cmd_len, (void**)&info)) {
+            info = NULL;
+        }
+    #endif
+    return info;
+}
+
+#if PHP_MAJOR_VERSION >= 7
+/* Free a hiredis_cmd_info_t stored in a persistent table */
+static void _hiredis_cmd_info_dtor(zval* zv) {
+    pefree(Z_PTR_P(zv), 1);
+}
+
+/* Add one entry of a COMMAND reply: [name, arity, flags, first, last, step,
+   acl categories, tips, ...] */
+static void _hiredis_cmd_table_add(HashTable* table, zval* entry) {
+    hiredis_cmd_info_t info;
+    hiredis_cmd_info_t* builtin;
+    zval* zv;
+    zval* zflag;
+    char* name;
+    size_t name_len;
+    int i;
+    if (Z_TYPE_P(entry) != IS_ARRAY || zend_hash_num_elements(Z_ARRVAL_P(entry)) < 6) {
+        return;
+    }
+    zv = zend_hash_index_find(Z_ARRVAL_P(entry), 0);
+    if (!zv || Z_TYPE_P(zv) != IS_STRING) {
+        return;
+    }
+    name_len = Z_STRLEN_P(zv);
+    name = estrndup(Z_STRVAL_P(zv), name_len);
+    php_strtoupper(name, name_len);
+    info.flags = PHP_HIREDIS_CMD_LOADED;
+    info.arity = (zv = zend_hash_index_find(Z_ARRVAL_P(entry), 1)) ? (short)zval_get_long(zv) : 0;
+    info.first_key = (zv = zend_hash_index_find(Z_ARRVAL_P(entry), 3)) ? (short)zval_get_long(zv) : 0;
+    info.last_key = (zv = zend_hash_index_find(Z_ARRVAL_P(entry), 4)) ? (short)zval_get_long(zv) : 0;
+    info.key_step = (zv = zend_hash_index_find(Z_ARRVAL_P(entry), 5)) ? (short)zval_get_long(zv) : 0;
+    zv = zend_hash_index_find(Z_ARRVAL_P(entry), 2);
+    if (zv && Z_TYPE_P(zv) == IS_ARRAY) {
+        ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(zv), zflag) {
+            if (Z_TYPE_P(zflag) != IS_STRING) {
+                continue;
+            }
+            for (i = 0; hiredis_cmd_flag_names[i].name; i++) {
+                if (0 == strcmp(Z_STRVAL_P(zflag), hiredis_cmd_flag_names[i].name)) {
+                    info.flags |= hiredis_cmd_flag_names[i].flag;
+                    break;
+                }
+            }
+        } ZEND_HASH_FOREACH_END();
+    }
+    // Redis 7 dropped the "random" flag for the nondeterministic_output tip
+    zv = zend_hash_index_find(Z_ARRVAL_P(entry), 7);
+    if (zv && Z_TYPE_P(zv) == IS_ARRAY) {
+        ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(zv), zflag) {
+            if (Z_TYPE_P(zflag) == IS_STRING && zend_string_equals_literal(Z_STR_P(zflag), "nondeterministic_output")) {
+                info.flags |= PHP_HIREDIS_CMD_RANDOM;
+            }
+        } ZEND_HASH_FOREACH_END();
+    }
+    // Never let a loaded entry make a command we know to be random or
+    // blocking look safe to merge
+    if ((builtin = zend_hash_str_find_ptr(&hiredis_cmd_map, name, name_len))) {
+        info.flags |= builtin->flags & (PHP_HIREDIS_CMD_RANDOM | PHP_HIREDIS_CMD_BLOCKING);
+    }
+    zend_hash_str_update_mem(table, name, name_len, &info, sizeof(info));
+    efree(name);
+}
+
+/* cmd_table_state values */
+#define PHP_HIREDIS_CMD_TABLE_LOADED  1
+#define PHP_HIREDIS_CMD_TABLE_REFUSED 2
+
+/* Load the command table from the server's COMMAND reply, once per
+   worker. Nothing here fails the caller since the table is optional. If
+   COMMAND gets NOAUTH the load is tried again on the next connection;
+   other error replies (old server, ACL denies COMMAND) keep the builtin
+   table until an AUTH succeeds (after_auth). An I/O error surfaces on the
+   next command. */
+static void _hiredis_cmd_table_load(hiredis_t* client, int after_auth) {
+    HashTable* table;
+    zval reply;
+    zval* entry;
+    if (!HIREDIS_G(load_command_table)
+        || HIREDIS_G(cmd_table_state) == PHP_HIREDIS_CMD_TABLE_LOADED
+        || (HIREDIS_G(cmd_table_state) == PHP_HIREDIS_CMD_TABLE_REFUSED && !after_auth)
+        || client->raw_pending > 0 || client->ctx->reader->pos < client->ctx->reader->len
+    ) {
+        return;
+    }
+    if (REDIS_OK != redisAppendCommand(client->ctx, "COMMAND")
+        || REDIS_OK != _hiredis_io_get_reply(client, &reply)
+    ) {
+        return;
+    }
+    if (!client->reply_is_error && Z_TYPE(reply) == IS_ARRAY) {
+        table = pemalloc(sizeof(HashTable), 1);
+        zend_hash_init(table, zend_hash_num_elements(Z_ARRVAL(reply)), NULL, _hiredis_cmd_info_dtor, 1);
+        ZEND_HASH_FOREACH_VAL(Z_ARRVAL(reply), entry) {
+            _hiredis_cmd_table_add(table, entry);
+        } ZEND_HASH_FOREACH_END();
+        HIREDIS_G(cmd_table) = table;
+        HIREDIS_G(cmd_table_state) = PHP_HIREDIS_CMD_TABLE_LOADED;
+    } else if (client->reply_is_error && Z_TYPE(reply) == IS_STRING && 0 != strncmp(Z_STRVAL(reply), "NOAUTH", 6)) {
+        HIREDIS_G(cmd_table_state) = PHP_HIREDIS_CMD_TABLE_REFUSED;
+    }
+    // The caller may still be looking at the reply of its own command
+    client->reply_is_error = 0;
+    zval_dtor(&reply);
+}
+#endif
+
+/* Hot-key detector. One in hiredis.hotkeys_sample_rate commands feeds its
+   key args into a per-worker count-min sketch, weighted by the rate. A key
+   whose estimate beats the smallest entry of the top-K list replaces it.
+   Counts are halved every PHP_HIREDIS_HOTKEYS_DECAY samples so the list
+   follows current traffic rather than the worker's whole lifetime. */
+#define PHP_HIREDIS_HOTKEYS_DECAY   (1 << 16)
+#define PHP_HIREDIS_HOTKEYS_MAX_KEY 256
+#define PHP_HIREDIS_HOTKEYS_MAX_ARG 16
+
+/* Halve every counter in the sketch and the top-K list */
+static void _hiredis_hotkeys_decay(void) {
+    uint32_t* sketch = HIREDIS_G(hotkeys_sketch);
+    int i;
+    for (i = 0; i < PHP_HIREDIS_HOTKEYS_DEPTH * PHP_HIREDIS_HOTKEYS_WIDTH; i++) {
+        sketch[i] >>= 1;
+    }
+    for (i = 0; i < HIREDIS_G(hotkeys_top_len); i++) {
+        HIREDIS_G(hotkeys_top)[i].count >>= 1;
+    }
+}
+
+/* Count one sampled occurrence of key */
+static void _hiredis_hotkeys_add(const char* key, size_t key_len, uint32_t weight) {
+    hiredis_hotkey_t* top = HIREDIS_G(hotkeys_top);
+    uint32_t* sketch;
+    uint32_t* cell;
+    uint64_t h;
+    uint32_t h1, h2, est = UINT32_MAX;
+    int i, min_i;
+
+    if (!(sketch = HIREDIS_G(hotkeys_sketch))) {
+        sketch = pecalloc(PHP_HIREDIS_HOTKEYS_DEPTH * PHP_HIREDIS_HOTKEYS_WIDTH, sizeof(uint32_t), 1);
+        HIREDIS_G(hotkeys_sketch) = sketch;
+    }
+
+    // One hash, split into two for the rows (Kirsch-Mitzenmacher)
+    h = (uint64_t)zend_inline_hash_func(key, key_len) * 0x9E3779B97F4A7C15ULL;
+    h1 = (uint32_t)h;
+    h2 = (uint32_t)(h >> 32) | 1;
+    for (i = 0; i < PHP_HIREDIS_HOTKEYS_DEPTH; i++) {
+        cell = &sketch[i * PHP_HIREDIS_HOTKEYS_WIDTH + (h1 + i * h2) % PHP_HIREDIS_HOTKEYS_WIDTH];
+        *cell = *cell > UINT32_MAX - weight ? UINT32_MAX : *cell + weight;
+        est = MIN(est, *cell);
+    }
+    if (++HIREDIS_G(hotkeys_samples) % PHP_HIREDIS_HOTKEYS_DECAY == 0) {
+        _hiredis_hotkeys_decay();
+        est >>= 1;
+    }
+
+    min_i = 0;
+    for (i = 0; i < HIREDIS_G(hotkeys_top_len); i++) {
+        if (top[i].hash == h && top[i].key_len == key_len && 0 == memcmp(top[i].key, key, key_len)) {
+            top[i].count = est;
+            return;
+        }
+        if (top[i].count < top[min_i].count) {
+            min_i = i;
+        }
+    }
+    if (HIREDIS_G(hotkeys_top_len) < PHP_HIREDIS_HOTKEYS_TOPK) {
+        i = HIREDIS_G(hotkeys_top_len)++;
+    } else if (est > top[min_i].count) {
+        i = min_i;
+        pefree(top[i].key, 1);
+    } else {
+        return;
+    }
+    top[i].key = pemalloc(key_len + 1, 1);
+    memcpy(top[i].key, key, key_len);
+    top[i].key[key_len] = '\0';
+    top[i].key_len = key_len;
+    top[i].hash = h;
+    top[i].count = est;
+}
+
+/* Feed the key args of a command into the detector */
+static void _hiredis_hotkeys_sample(hiredis_argv_t* a) {
+    char cmd[32];
+    const hiredis_cmd_info_t* info;
+    int j, last, n;
+    if (a->argc < 2 || !a->argv[0] || a->argvlen[0] >= sizeof(cmd)) {
+        return;
+    }
+    memcpy(cmd, a->argv[0], a->argvlen[0]);
+    php_strtoupper(cmd, a->argvlen[0]);
+    info = _hiredis_cmd_info_find(cmd, a->argvlen[0]);
+    if (!info || info->first_key <= 0 || info->key_step <= 0) {
+        return;
+    }
+    last = info->last_key < 0 ? a->argc + info->last_key : info->last_key;
+    for (j = info->first_key, n = 0; j <= last && j < a->argc && n < PHP_HIREDIS_HOTKEYS_MAX_ARG; j += info->key_step, n++) {
+        if (a->argv[j] && a->argvlen[j] <= PHP_HIREDIS_HOTKEYS_MAX_KEY) {
+            _hiredis_hotkeys_add(a->argv[j], a->argvlen[j], (uint32_t)HIREDIS_G(hotkeys_sample_rate));
+        }
+    }
+}
+
+/* Sort top-K entries by count, highest first. Returns the entry count. */
+static int _hiredis_hotkeys_sorted(hiredis_hotkey_t** out) {
+    hiredis_hotkey_t* tmp;
+    int i, j, n = HIREDIS_G(hotkeys_top_len);
+    for (i = 0; i < n; i++) {
+        out[i] = &HIREDIS_G(hotkeys_top)[i];
+        for (j = i; j > 0 && out[j]->count > out[j - 1]->count; j--) {
+            tmp = out[j];
+            out[j] = out[j - 1];
+            out[j - 1] = tmp;
+        }
+    }
+    return n;
+}
+
+/* Convert array of zvals to string + stringlen params for hiredis. If cmd is
+   not NULL make it the first arg. Caller must call _hiredis_argv_free. */
+static void _hiredis_argv_build(hiredis_argv_t* a, char* cmd, zval* args, int argc) {
+    int i, j;
+    a->argc = cmd ? argc + 1 : argc;
+    a->argv = (char**)safe_emalloc(a->argc, sizeof(char*), 0);
+    a->argvlen = (size_t*)safe_emalloc(a->argc, sizeof(size_t), 0);
+    a->zstrs = (zend_string**)safe_emalloc(a->argc, sizeof(zend_string*), 0);
+    a->streams = NULL;
+    j = 0;
+    if (cmd) {
+        a->argv[j] = cmd;
+        a->argvlen[j] = strlen(cmd);
+        a->zstrs[j] = NULL;
+        j++;
+    }
+    for (i = 0; i < argc; i++, j++) {
+        zval* _zp = &args[i];
+        a->zstrs[j] = NULL;
+        #if PHP_MAJOR_VERSION >= 7
+            // Other resources (contexts, ...) keep converting to a string
+            if ((Z_TYPE_P(_zp) == IS_RESOURCE
+                    && zend_fetch_resource2_ex(_zp, NULL, php_file_le_stream(), php_file_le_pstream()))
+                || (Z_TYPE_P(_zp) == IS_OBJECT && Z_OBJCE_P(_zp) == hiredis_stream_arg_ce)
+            ) {
+                if (!a->streams) {
+                    a->streams = (zval**)ecalloc(a->argc, sizeof(zval*));
+                }
+                a->streams[j] = _zp;
+                a->argv[j] = NULL;
+                a->argvlen[j] = 0;
+                continue;
+            }
+        #endif
+        if (
+            #if PHP_MAJOR_VERSION >= 7
+                Z_TYPE_P(_zp) == IS_TRUE || Z_TYPE_P(_zp) == IS_FALSE
+            #else
+                Z_TYPE_P(_zp) == IS_BOOL
+            #endif
+        ) {
+            a->argv[j] = zend_is_true(_zp) ? "1" : "0";
+            a->argvlen[j] = 1;
+        } else {
+            #if PHP_MAJOR_VERSION >= 7
+                // Convert into a temporary; args may be the caller's frame
+                if (Z_TYPE_P(_zp) != IS_STRING) {
+                    a->zstrs[j] = zval_get_string(_zp);
+                    a->argv[j] = ZSTR_VAL(a->zstrs[j]);
+                    a->argvlen[j] = ZSTR_LEN(a->zstrs[j]);
+                    continue;
+                }
+            #else
+                if (Z_TYPE_P(_zp) != IS_STRING) {
+                    convert_to_string(_zp);
+                    a->zstrs[j] = Z_STRVAL_P(_zp);
+                }
+            #endif
+            a->argv[j] = Z_STRVAL_P(_zp);
+            a->argvlen[j] = Z_STRLEN_P(_zp);
+        }
+    }
+}
+
+/* Free params built by _hiredis_argv_build */
+static void _hiredis_argv_free(hiredis_argv_t* a) {
+    int i;
+    for (i = 0; i < a->argc; i++) {
+        if (a->zstrs[i]) {
+            #if PHP_MAJOR_VERSION >= 7
+                zend_string_release(a->zstrs[i]);
+            #else
+                STR_FREE(a->zstrs[i]);
+            #endif
+        }
+    }
+    efree(a->zstrs);
+    efree(a->argv);
+    efree(a->argvlen);
+    if (a->streams) {
+        efree(a->streams);
+    }
+}
+
+/* Actually send/queue a redis command. If `cmd` is not NULL, it is sent as the
+   first token, followed by `args`. Is `is_append` is set,
+   redisAppendCommandArgv is called instead of redisCommandArgv. */
+#if PHP_MAJOR_VERSION >= 7
+/* Collapse duplicate keys of MGET or fields of HMGET in place. Returns a
+   map from each original key/field to its position in the reply to the
+   shortened command (see _hiredis_reply_fanout), or NULL if there are no
+   duplicates. *send_argc is set to the shortened arg count. */
+static uint32_t* _hiredis_argv_dedup(hiredis_argv_t* a, int* send_argc, int* fanout_len) {
+    HashTable seen;
+    uint32_t* fanout;
+    zval* zv;
+    zval tmp;
+    int first, i, n;
+
+    *send_argc = a->argc;
+    if (!a->argv[0] || a->streams) {
+        return NULL;
+    } else if (a->argvlen[0] == 4 && 0 == strncasecmp(a->argv[0], "MGET", 4)) {
+        first = 1;
+    } else if (a->argvlen[0] == 5 && 0 == strncasecmp(a->argv[0], "HMGET", 5)) {
+        first = 2;
+    } else {
+        return NULL;
+    }
+    if (a->argc - first < 2) {
+        return NULL;
+    }
+
+    fanout = (uint32_t*)safe_emalloc(a->argc - first, sizeof(uint32_t), 0);
+    zend_hash_init(&seen, a->argc - first, NULL, NULL, 0);
+    for (i = first, n = 0; i < a->argc; i++) {
+        if ((zv = zend_hash_str_find(&seen, a->argv[i], a->argvlen[i]))) {
+            fanout[i - first] = (uint32_t)Z_LVAL_P(zv);
+            continue;
+        }
+        ZVAL_LONG(&tmp, n);
+        zend_hash_str_add_new(&seen, a->argv[i], a->argvlen[i], &tmp);
+        fanout[i - first] = n;
+        a->argv[first + n] = a->argv[i];
+        a->argvlen[first + n] = a->argvlen[i];
+        n++;
+    }
+    zend_hash_destroy(&seen);
+    if (first + n == a->argc) {
+        efree(fanout);
+        return NULL;
+    }
+    *send_argc = first + n;
+    *fanout_len = a->argc - first;
+    return fanout;
+}
+
+/* Singleflight for auto_pipeline. If an identical read-only command is
+   already queued, drop the copy just appended at obuf_off and return the
+   queued future in ret. Otherwise remember this command for the future
+   about to be pushed. Any other command ends the de-duplication window,
+   since later reads must observe it. */
+static int _hiredis_singleflight(hiredis_t* client, hiredis_argv_t* a, size_t obuf_off, zval* ret) {
+    const hiredis_cmd_info_t* info = NULL;
+    hiredis_future_t* future;
+    char cmd[32];
+    const char* sig;
+    size_t sig_len;
+    zval* zv;
+    zval tmp;
+
+    if (a->argv[0] && a->argvlen[0] < sizeof(cmd)) {
+        memcpy(cmd, a->argv[0], a->argvlen[0]);
+        php_strtoupper(cmd, a->argvlen[0]);
+        info = _hiredis_cmd_info_find(cmd, a->argvlen[0]);
+    }
+    if (!info
+        || !(info->flags & PHP_HIREDIS_CMD_READONLY)
+        || (info->flags & (PHP_HIREDIS_CMD_RANDOM | PHP_HIREDIS_CMD_BLOCKING))
+    ) {
+        if (client->sf_map) {
+            zend_hash_clean(client->sf_map);
+        }
+        return 0;
+    }
+
+    sig = client->ctx->obuf + obuf_off;
+    sig_len = sdslen(client->ctx->obuf) - obuf_off;
+    if (!client->sf_map) {
+        ALLOC_HASHTABLE(client->sf_map);
+        zend_hash_init(client->sf_map, 16, NULL, NULL, 0);
+    } else if ((zv = zend_hash_str_find(client->sf_map, sig, sig_len))
+        && (future = client->pending[Z_LVAL_P(zv)])
+    ) {
+        if (obuf_off == 0) {
+            sdsclear(client->ctx->obuf);
+        } else {
+            sdsrange(client->ctx->obuf, 0, obuf_off - 1);
+        }
+        ZVAL_OBJ(ret, &future->std);
+        Z_ADDREF_P(ret);
+        return 1;
+    }
+    ZVAL_LONG(&tmp, client->pending_len);
+    zend_hash_str_update(client->sf_map, sig, sig_len, &tmp);
+    return 0;
+}
+#endif
+
+#if PHP_MAJOR_VERSION >= 7
+/* Hedged reads. With replicas configured, a read-only command that has no
+   reply from the primary after the hedge delay is also sent to a replica
+   and the first reply wins. The delay is fixed or, by default, a
+   percentile of that command's recent latency, kept in a log2 histogram
+   of microseconds. A token bucket refilled by `budget` per eligible read
+   caps the extra load. Each connection reads its reply into its own root
+   in the hedge state, so the loser can keep parsing later: the primary's
+   leftover reply is drained before its next read (hedge_discard) and the
+   replica's before it is used again. The replica is connected without
+   blocking and first gets the primary's connection state commands; a
+   replica that fails or answers with an error is dropped and left alone
+   for a backoff that doubles on each failure in a row. */
+#define PHP_HIREDIS_HEDGE_BUCKETS 32
+#define PHP_HIREDIS_HEDGE_BURST   10.0
+#define PHP_HIREDIS_HEDGE_CONNECT_US     1000000
+#define PHP_HIREDIS_HEDGE_BACKOFF_MIN_US 100000
+#define PHP_HIREDIS_HEDGE_BACKOFF_MAX_US 10000000
+
+typedef struct {
+    uint32_t buckets[PHP_HIREDIS_HEDGE_BUCKETS];
+    uint32_t n;
+} hiredis_hedge_hist_t;
+
+struct _hiredis_hedge_t {
+    char** addrs;
+    int naddrs;
+    int next;
+    redisContext* ctx;
+    int ctx_discard;
+    int connected;
+    int setup;
+    uint64_t connect_deadline;
+    uint64_t retry_at;
+    uint64_t backoff_us;
+    zval root[2];
+    int multi;
+    zend_long delay_us;
+    zend_long min_delay_us;
+    zend_long percentile;
+    zend_long min_samples;
+    double budget;
+    double tokens;
+    HashTable hists;
+    zend_long hedged;
+    zend_long won;
+    zend_long over_budget;
+};
+
+/* Split "host:port" into host (NUL terminated in buf) and port */
+static int _hiredis_parse_addr(const char* addr, size_t len, char* buf, size_t buf_len, int* port, int default_port) {
+    const char* colon = zend_memrchr(addr, ':', len);
+    size_t host_len = colon ? (size_t)(colon - addr) : len;
+    if (host_len == 0 || host_len >= buf_len) {
+        return REDIS_ERR;
+    }
+    memcpy(buf, addr, host_len);
+    buf[host_len] = '\0';
+    *port = colon ? atoi(colon + 1) : default_port;
+    return *port > 0 && *port < 65536 ? REDIS_OK : REDIS_ERR;
+}
+
+/* Monotonic clock in us */
+static uint64_t _hiredis_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void _hiredis_hedge_hist_dtor(zval* zv) {
+    efree(Z_PTR_P(zv));
+}
+
+/* Latency histogram of a command, created on first use */
+static hiredis_hedge_hist_t* _hiredis_hedge_hist(hiredis_hedge_t* h, const char* cmd, size_t cmd_len) {
+    hiredis_hedge_hist_t* hist;
+    if (!(hist = zend_hash_str_find_ptr(&h->hists, cmd, cmd_len))) {
+        hist = ecalloc(1, sizeof(*hist));
+        zend_hash_str_add_ptr(&h->hists, cmd, cmd_len, hist);
+    }
+    return hist;
+}
+
+/* Add a sample. Counts are halved now and then so the percentile follows
+   recent behavior. */
+static void _hiredis_hedge_record(hiredis_hedge_hist_t* hist, uint64_t us) {
+    int i = 0;
+    while (us > 1 && i < PHP_HIREDIS_HEDGE_BUCKETS - 1) {
+        us >>= 1;
+        i++;
+    }
+    hist->buckets[i]++;
+    if (++hist->n >= 4096) {
+        hist->n = 0;
+        for (i = 0; i < PHP_HIREDIS_HEDGE_BUCKETS; i++) {
+            hist->buckets[i] >>= 1;
+            hist->n += hist->buckets[i];
+        }
+    }
+}
+
+/* Hedge delay in us for a command, or 0 if there are too few samples */
+static uint64_t _hiredis_hedge_delay(hiredis_hedge_t* h, hiredis_hedge_hist_t* hist) {
+    uint64_t target, cum = 0;
+    int i;
+    if (h->delay_us > 0) {
+        return h->delay_us;
+    }
+    if (hist->n < (uint32_t)h->min_samples) {
+        return 0;
+    }
+    target = ((uint64_t)hist->n * h->percentile + 99) / 100;
+    for (i = 0; i < PHP_HIREDIS_HEDGE_BUCKETS; i++) {
+        cum += hist->buckets[i];
+        if (cum >= target) {
+            break;
+        }
+    }
+    return MAX((uint64_t)2 << i, (uint64_t)h->min_delay_us);
+}
+
+/* Drop the replica connection and whatever it still owed us */
+static void _hiredis_hedge_disconnect(hiredis_hedge_t* h) {
+    if (h->ctx) {
+        redisFree(h->ctx);
+        h->ctx = NULL;
+    }
+    h->ctx_discard = 0;
+    h->connected = 0;
+    h->setup = 0;
+    zval_ptr_dtor(&h->root[1]);
+    ZVAL_UNDEF(&h->root[1]);
+}
+
+/* Drop a replica that failed and leave the replicas alone for a while,
+   doubling the pause on each failure in a row */
+static void _hiredis_hedge_fail(hiredis_hedge_t* h) {
+    _hiredis_hedge_disconnect(h);
+    h->backoff_us = h->backoff_us
+        ? MIN(h->backoff_us * 2, PHP_HIREDIS_HEDGE_BACKOFF_MAX_US)
+        : PHP_HIREDIS_HEDGE_BACKOFF_MIN_US;
+    h->retry_at = _hiredis_now_us() + h->backoff_us;
+}
+
+/* Start a non-blocking connect to the next replica and queue the
+   connection state commands that succeeded on the primary, so reads run
+   as the same user, on the same database and protocol */
+static void _hiredis_hedge_connect(hiredis_t* client) {
+    hiredis_hedge_t* h = client->hedge;
+    char host[256];
+    int port, argc;
+    const char* addr;
+    const char** argv;
+    size_t* argvlen;
+    zval* cmd;
+    zval* arg;
+    uint64_t now = _hiredis_now_us();
+    if (h->naddrs == 0 || now < h->retry_at) {
+        return;
+    }
+    addr = h->addrs[h->next++ % h->naddrs];
+    if (REDIS_OK != _hiredis_parse_addr(addr, strlen(addr), host, sizeof(host), &port, 6379)) {
+        _hiredis_hedge_fail(h);
+        return;
+    }
+    h->ctx = redisConnectNonBlock(host, port);
+    if (!h->ctx || h->ctx->err) {
+        _hiredis_hedge_fail(h);
+        return;
+    }
+    h->ctx->reader->maxbuf = client->max_read_buf;
+    h->ctx->reader->fn = &hiredis_replyobj_funcs;
+    redisReplyReaderSetPrivdata(h->ctx->reader, (void*)client);
+    h->connect_deadline = now + (client->timeout_us > 0 ? (uint64_t)client->timeout_us : PHP_HIREDIS_HEDGE_CONNECT_US);
+    if (!client->session_cmds) {
+        return;
+    }
+    ZEND_HASH_FOREACH_VAL(client->session_cmds, cmd) {
+        argc = 0;
+        argv = safe_emalloc(zend_hash_num_elements(Z_ARRVAL_P(cmd)), sizeof(char*), 0);
+        argvlen = safe_emalloc(zend_hash_num_elements(Z_ARRVAL_P(cmd)), sizeof(size_t), 0);
+        ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(cmd), arg) {
+            argv[argc] = Z_STRVAL_P(arg);
+            argvlen[argc++] = Z_STRLEN_P(arg);
+        } ZEND_HASH_FOREACH_END();
+        if (REDIS_OK == redisAppendCommandArgv(h->ctx, argc, argv, argvlen)) {
+            h->setup++;
+            h->ctx_discard++;
+        }
+        efree(argv);
+        efree(argvlen);
+    } ZEND_HASH_FOREACH_END();
+}
+
+/* Forget the primary's leftover reply, e.g. when its connection goes away */
+static void _hiredis_hedge_reset_primary(hiredis_t* client) {
+    client->hedge_discard = 0;
+    if (client->hedge) {
+        zval_ptr_dtor(&client->hedge->root[0]);
+        ZVAL_UNDEF(&client->hedge->root[0]);
+    }
+}
+
+static void _hiredis_hedge_free(hiredis_t* client) {
+    hiredis_hedge_t* h = client->hedge;
+    int i;
+    if (!h) {
+        return;
+    }
+    _hiredis_hedge_reset_primary(client);
+    _hiredis_hedge_disconnect(h);
+    for (i = 0; i < h->naddrs; i++) {
+        efree(h->addrs[i]);
+    }
+    if (h->addrs) {
+        efree(h->addrs);
+    }
+    zend_hash_destroy(&h->hists);
+    efree(h);
+    client->hedge = NULL;
+}
+
+/* Parse whatever the replica has sent towards the replies it still owes
+   (state commands and lost hedges) without blocking. Returns REDIS_OK
+   once it owes nothing. */
+static int _hiredis_hedge_drain_replica(hiredis_t* client) {
+    hiredis_hedge_t* h = client->hedge;
+    struct pollfd pfd;
+    void* reply;
+    while (h->ctx_discard > 0) {
+        client->reply_root = &h->root[1];
+        client->reply_is_error = 0;
+        reply = NULL;
+        if (REDIS_OK != redisGetReplyFromReader(h->ctx, &reply)) {
+            _hiredis_hedge_fail(h);
+            return REDIS_ERR;
+        }
+        if (reply) {
+            zval_ptr_dtor(&h->root[1]);
+            ZVAL_UNDEF(&h->root[1]);
+            h->ctx_discard--;
+            if (h->setup > 0) {
+                h->setup--;
+                if (client->reply_is_error) {
+                    // e.g. NOAUTH or a database the replica does not have
+                    client->reply_is_error = 0;
+                    _hiredis_hedge_fail(h);
+                    return REDIS_ERR;
+                }
+            }
+            continue;
+        }
+        pfd.fd = h->ctx->fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        client->io_syscalls++;
+        if (poll(&pfd, 1, 0) <= 0) {
+            return REDIS_ERR;
+        }
+        client->io_syscalls++;
+        if (REDIS_OK != redisBufferRead(h->ctx)) {
+            _hiredis_hedge_fail(h);
+            return REDIS_ERR;
+        }
+    }
+    return REDIS_OK;
+}
+
+/* Whether the replica can take a hedge right now. Starts the connection
+   if needed, then finishes the connect, the state commands and any
+   leftover reply without blocking. */
+static int _hiredis_hedge_ready(hiredis_t* client) {
+    hiredis_hedge_t* h = client->hedge;
+    struct pollfd pfd;
+    socklen_t len = sizeof(int);
+    int err = 0, done = 0;
+    if (!h->ctx) {
+        _hiredis_hedge_connect(client);
+        if (!h->ctx) {
+            return 0;
+        }
+    }
+    if (!h->connected) {
+        pfd.fd = h->ctx->fd;
+        pfd.events = POLLOUT;
+        pfd.revents = 0;
+        client->io_syscalls++;
+        if (poll(&pfd, 1, 0) <= 0) {
+            if (_hiredis_now_us() >= h->connect_deadline) {
+                _hiredis_hedge_fail(h);
+            }
+            return 0;
+        } else if (0 != getsockopt(h->ctx->fd, SOL_SOCKET, SO_ERROR, &err, &len) || err != 0) {
+            _hiredis_hedge_fail(h);
+            return 0;
+        }
+        h->connected = 1;
+    }
+    if (sdslen(h->ctx->obuf) > 0) {
+        client->io_syscalls++;
+        if (REDIS_OK != redisBufferWrite(h->ctx, &done)) {
+            _hiredis_hedge_fail(h);
+            return 0;
+        } else if (!done) {
+            return 0;
+        }
+    }
+    if (REDIS_OK != _hiredis_hedge_drain_replica(client)) {
+        return 0;
+    }
+    h->backoff_us = 0;
+    return 1;
+}
+
+/* Read and drop the primary's reply to a hedged command the replica
+   answered first. Must run before the primary's next reply is read. */
+static int _hiredis_hedge_settle(hiredis_t* client) {
+    hiredis_hedge_t* h = client->hedge;
+    void* reply;
+    while (client->hedge_discard > 0) {
+        client->reply_root = &h->root[0];
+        reply = NULL;
+        if (REDIS_OK != redisGetReplyFromReader(client->ctx, &reply)) {
+            return REDIS_ERR;
+        }
+        if (reply) {
+            zval_ptr_dtor(&h->root[0]);
+            ZVAL_UNDEF(&h->root[0]);
+            client->hedge_discard--;
+        } else if (REDIS_OK != _hiredis_io_fill(client)) {
+            return REDIS_ERR;
+        }
+    }
+    return REDIS_OK;
+}
+
+/* Whether the command in a may be hedged. Also tracks MULTI, since reads
+   queued in a transaction must stay on the primary. */
+static int _hiredis_hedge_eligible(hiredis_t* client, hiredis_argv_t* a) {
+    hiredis_hedge_t* h = client->hedge;
+    const hiredis_cmd_info_t* info;
+    char cmd[32];
+    if (!a->argv[0] || a->argvlen[0] >= sizeof(cmd)) {
+        return 0;
+    }
+    memcpy(cmd, a->argv[0], a->argvlen[0]);
+    php_strtoupper(cmd, a->argvlen[0]);
+    if (a->argvlen[0] == 5 && 0 == memcmp(cmd, "MULTI", 5)) {
+        h->multi = 1;
+    } else if ((a->argvlen[0] == 4 && 0 == memcmp(cmd, "EXEC", 4))
+        || (a->argvlen[0] == 7 && 0 == memcmp(cmd, "DISCARD", 7))
+    ) {
+        h->multi = 0;
+    }
+    if (h->multi || client->auto_pipeline || client->bg_enabled || a->streams
+        || !(client->ctx->flags & REDIS_BLOCK) || PHP_HIREDIS_IS_TLS(client)
+    ) {
+        return 0;
+    }
+    info = _hiredis_cmd_info_find(cmd, a->argvlen[0]);
+    return info && (info->flags & PHP_HIREDIS_CMD_READONLY)
+        && !(info->flags & (PHP_HIREDIS_CMD_BLOCKING | PHP_HIREDIS_CMD_PUBSUB));
+}
+
+/* Read the reply to the command appended at obuf_off, hedging it to a
+   replica if the primary is slow */
+static int _hiredis_hedge_get_reply(hiredis_t* client, hiredis_argv_t* a, size_t obuf_off, zval* dest) {
+    hiredis_hedge_t* h = client->hedge;
+    redisContext* c = client->ctx;
+    redisContext* rc;
+    hiredis_hedge_hist_t* hist;
+    struct pollfd pfd[2];
+    uint64_t start, delay, deadline, now;
+    int nfds, rv, i, done, winner = -1;
+    void* reply;
+    sds req = NULL;
+    char cmd[32];
+
+    if (REDIS_OK != PHP_HIREDIS_HEDGE_SETTLE(client)) {
+        return REDIS_ERR;
+    }
+    memcpy(cmd, a->argv[0], a->argvlen[0]);
+    php_strtoupper(cmd, a->argvlen[0]);
+    hist = _hiredis_hedge_hist(h, cmd, a->argvlen[0]);
+    delay = _hiredis_hedge_delay(h, hist);
+    h->tokens = MIN(h->tokens + h->budget, PHP_HIREDIS_HEDGE_BURST);
+    start = _hiredis_now_us();
+
+    // Give the primary until the hedge delay, keeping a copy of the
+    // command for the replica
+    if (delay > 0 && c->reader->pos == c->reader->len) {
+        req = sdsnewlen(c->obuf + obuf_off, sdslen(c->obuf) - obuf_off);
+    }
+    if (REDIS_OK != _hiredis_io_flush(client)) {
+        goto fail;
+    }
+    if (req) {
+        pfd[0].fd = c->fd;
+        pfd[0].events = POLLIN;
+        pfd[0].revents = 0;
+        client->io_syscalls++;
+        rv = poll(pfd, 1, (int)((delay + 999) / 1000));
+        if (rv == 0 && h->tokens < 1) {
+            h->over_budget++;
+        } else if (rv == 0 && _hiredis_hedge_ready(client)) {
+            goto hedge;
+        }
+    }
+    if (req) {
+        sdsfree(req);
+    }
+    if (REDIS_OK != _hiredis_io_get_reply(client, dest)) {
+        return REDIS_ERR;
+    }
+    _hiredis_hedge_record(hist, _hiredis_now_us() - start);
+    return REDIS_OK;
+
+hedge:
+    // Send the same bytes to the replica
+    h->tokens -= 1;
+    h->hedged++;
+    h->ctx->obuf = sdscatlen(h->ctx->obuf, req, sdslen(req));
+    sdsfree(req);
+    req = NULL;
+    done = 0;
+    client->io_syscalls++;
+    if (REDIS_OK != redisBufferWrite(h->ctx, &done) || !done) {
+        // The replica only carries the odd hedge, so a send buffer that
+        // cannot take one command means it is stuck
+        _hiredis_hedge_fail(h);
+    } else {
+        h->ctx_discard++;
+    }
+
+    // First complete reply wins, except that a replica error (LOADING,
+    // READONLY, MOVED...) never beats the primary's answer
+    deadline = client->timeout_us > 0 ? start + client->timeout_us : 0;
+    while (winner < 0) {
+        pfd[0].fd = c->fd;
+        pfd[0].events = POLLIN;
+        pfd[0].revents = 0;
+        nfds = 1;
+        if (h->ctx) {
+            pfd[1].fd = h->ctx->fd;
+            pfd[1].events = POLLIN;
+            pfd[1].revents = 0;
+            nfds = 2;
+        }
+        now = _hiredis_now_us();
+        if (deadline && now >= deadline) {
+            _hiredis_io_set_ctx_error(c, REDIS_ERR_IO, strerror(EAGAIN));
+            return REDIS_ERR;
+        }
+        client->io_syscalls++;
+        rv = poll(pfd, nfds, deadline ? (int)((deadline - now + 999) / 1000) : -1);
+        if (rv < 0 && errno == EINTR) {
+            continue;
+        } else if (rv < 0) {
+            _hiredis_io_set_ctx_error(c, REDIS_ERR_IO, strerror(errno));
+            return REDIS_ERR;
+        }
+        for (i = 0; i < nfds && winner < 0; i++) {
+            if (!pfd[i].revents) {
+                continue;
+            }
+            rc = i == 0 ? c : h->ctx;
+            client->io_syscalls++;
+            client->reply_root = &h->root[i];
+            client->reply_is_error = 0;
+            reply = NULL;
+            if (REDIS_OK != redisBufferRead(rc) || REDIS_OK != redisGetReplyFromReader(rc, &reply)) {
+                if (i == 0) {
+                    return REDIS_ERR;
+                }
+                _hiredis_hedge_fail(h);
+                nfds = 1;
+            } else if (reply && i == 1 && client->reply_is_error) {
+                _hiredis_hedge_fail(h);
+                nfds = 1;
+            } else if (reply) {
+                winner = i;
+            }
+        }
+    }
+    client->reply_root = NULL;
+    client->io_replies++;
+    ZVAL_COPY_VALUE(dest, &h->root[winner]);
+    ZVAL_UNDEF(&h->root[winner]);
+    if (winner == 0) {
+        _hiredis_hedge_record(hist, _hiredis_now_us() - start);
+    } else {
+        h->ctx_discard--;
+        h->won++;
+        client->hedge_discard++;
+    }
+    return REDIS_OK;
+
+fail:
+    if (req) {
+        sdsfree(req);
+    }
+    return REDIS_ERR;
+}
+#endif
+
+#ifdef HAVE_HIREDIS_USDT
+/* Monotonic clock in ns, for probe arguments */
+static uint64_t _hiredis_probe_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* RESP type char and size (bytes or elements) of a reply for probes; 0 if
+   there is no reply (a failure or a queued future) */
+static int _hiredis_probe_reply_type(hiredis_t* client, zval* z, long long* size) {
+    *size = 0;
+    switch (Z_TYPE_P(z)) {
+        case IS_STRING:
+            *size = Z_STRLEN_P(z);
+            return client->reply_is_error ? '-' : '$';
+        case IS_ARRAY:
+            *size = zend_hash_num_elements(Z_ARRVAL_P(z));
+            return '*';
+        case IS_LONG:
+            *size = Z_LVAL_P(z);
+            return ':';
+        case IS_NULL:
+            return '_';
+        #if PHP_MAJOR_VERSION >= 7
+        case IS_OBJECT:
+            if (Z_OBJCE_P(z) == hiredis_lazy_reply_ce) {
+                *size = Z_HIREDIS_LAZY_REPLY_P(z)->count;
+                return '*';
+            }
+            return 0;
+        #endif
+        default:
+            return 0;
+    }
+}
+
+/* Fire reply__done for a reply read in `start` ns ago */
+static void _hiredis_probe_reply_done(hiredis_t* client, zval* z, uint64_t start) {
+    long long size;
+    int type = _hiredis_probe_reply_type(client, z, &size);
+    PHP_HIREDIS_PROBE4(reply__done, type, size, _hiredis_probe_now_ns() - start, client->ctx ? client->ctx->fd : -1);
+}
+#endif
+
+#if PHP_MAJOR_VERSION >= 7
+/* Names accepted by setDecodeHint/decodeNext */
+static long _hiredis_decode_hint_parse(const char* name, size_t len) {
+    static const struct {
+        const char* name;
+        long hint;
+    } hints[] = {
+        { "none",        0 },
+        { "numeric",     PHP_HIREDIS_DECODE_NUMERIC },
+        { "double",      PHP_HIREDIS_DECODE_DOUBLE },
+        { "map",         PHP_HIREDIS_DECODE_MAP },
+        { "map_numeric", PHP_HIREDIS_DECODE_MAP | PHP_HIREDIS_DECODE_NUMERIC },
+        { "scores",      PHP_HIREDIS_DECODE_MAP | PHP_HIREDIS_DECODE_DOUBLE },
+        { "info",        PHP_HIREDIS_DECODE_INFO },
+    };
+    size_t i;
+    for (i = 0; i < sizeof(hints) / sizeof(hints[0]); i++) {
+        if (strlen(hints[i].name) == len && strncasecmp(hints[i].name, name, len) == 0) {
+            return hints[i].hint;
+        }
+    }
+    return -1;
+}
+
+/* Decode hint for the command in a: the one-shot decodeNext hint, which
+   any command consumes, else the one set for the command name */
+static long _hiredis_decode_hint(hiredis_t* client, hiredis_argv_t* a) {
+    char cmd[32];
+    zval* zv;
+    long hint = client->decode_next;
+    client->decode_next = 0;
+    if (hint || !client->decode_hints || !a->argv[0] || a->argvlen[0] >= sizeof(cmd)) {
+        return hint;
+    }
+    memcpy(cmd, a->argv[0], a->argvlen[0]);
+    php_strtoupper(cmd, a->argvlen[0]);
+    return (zv = zend_hash_str_find(client->decode_hints, cmd, a->argvlen[0])) ? (long)Z_LVAL_P(zv) : 0;
+}
+
+/* Turn a flat [k1, v1, k2, v2, ...] reply into [k1 => v1, k2 => v2, ...] */
+static void _hiredis_decode_map(zval* z) {
+    zval map;
+    zval* k;
+    zval* v;
+    uint32_t i, n;
+    if (Z_TYPE_P(z) != IS_ARRAY || ((n = zend_hash_num_elements(Z_ARRVAL_P(z))) & 1)) {
+        return;
+    }
+    array_init_size(&map, n / 2);
+    for (i = 0; i < n; i += 2) {
+        k = zend_hash_index_find(Z_ARRVAL_P(z), i);
+        v = zend_hash_index_find(Z_ARRVAL_P(z), i + 1);
+        if (!k || !v) {
+            continue;
+        }
+        Z_TRY_ADDREF_P(v);
+        if (Z_TYPE_P(k) == IS_STRING) {
+            zend_symtable_update(Z_ARRVAL(map), Z_STR_P(k), v);
+        } else if (Z_TYPE_P(k) == IS_LONG) {
+            zend_hash_index_update(Z_ARRVAL(map), Z_LVAL_P(k), v);
+        } else {
+            zval_ptr_dtor(v);
+        }
+    }
+    zval_ptr_dtor(z);
+    ZVAL_COPY_VALUE(z, &map);
+}
+
+/* Init z from an INFO value: a number if it looks like one, an array for
+   "k1=v1,k2=v2" lists (keyspace, commandstats), else a string */
+static void _hiredis_decode_info_value(zval* z, const char* s, size_t len) {
+    const char* end = s + len;
+    const char* comma;
+    const char* eq;
+    zend_long lval;
+    double dval;
+    zval tmp;
+    if (memchr(s, '=', len)) {
+        array_init(z);
+        while (s < end) {
+            if (!(comma = memchr(s, ',', end - s))) {
+                comma = end;
+            }
+            if ((eq = memchr(s, '=', comma - s))) {
+                _hiredis_decode_info_value(&tmp, eq + 1, comma - eq - 1);
+                zend_symtable_str_update(Z_ARRVAL_P(z), s, eq - s, &tmp);
+            }
+            s = comma + 1;
+        }
+        return;
+    }
+    switch (is_numeric_string(s, len, &lval, &dval, 0)) {
+        case IS_LONG:
+            ZVAL_LONG(z, lval);
+            break;
+        case IS_DOUBLE:
+            ZVAL_DOUBLE(z, dval);
+            break;
+        default:
+            _hiredis_zval_stringl(z, s, len);
+    }
+}
+
+/* Parse an INFO reply into [section => [field => value]], with section
+   names lowercased */
+static void _hiredis_decode_info(zval* z) {
+    zval info, tmp;
+    zval* section;
+    zend_string* name;
+    const char* p;
+    const char* end;
+    const char* eol;
+    const char* line_end;
+    const char* colon;
+    if (Z_TYPE_P(z) != IS_STRING) {
+        return;
+    }
+    array_init(&info);
+    section = &info;
+    p = Z_STRVAL_P(z);
+    end = p + Z_STRLEN_P(z);
+    while (p < end) {
+        if (!(eol = memchr(p, '\n', end - p))) {
+            eol = end;
+        }
+        line_end = eol > p && eol[-1] == '\r' ? eol - 1 : eol;
+        if (line_end > p && *p == '#') {
+            for (p++; p < line_end && *p == ' '; p++);
+            name = zend_string_init(p, line_end - p, 0);
+            zend_str_tolower(ZSTR_VAL(name), ZSTR_LEN(name));
+            array_init(&tmp);
+            section = zend_symtable_update(Z_ARRVAL(info), name, &tmp);
+            zend_string_release(name);
+        } else if ((colon = memchr(p, ':', line_end - p))) {
+            _hiredis_decode_info_value(&tmp, colon + 1, line_end - colon - 1);
+            zend_symtable_str_update(Z_ARRVAL_P(section), p, colon - p, &tmp);
+        }
+        p = eol + 1;
+    }
+    zval_ptr_dtor(z);
+    ZVAL_COPY_VALUE(z, &info);
+}
+#endif
+
+#if PHP_MAJOR_VERSION >= 7
+/* Record a connection state command (AUTH, SELECT, HELLO, READONLY,
+   CLIENT SETNAME) by name once its reply has been read and was not an
+   error, so a new connection can be put in the same state. Appended and
+   pipelined commands are never recorded since nobody checks their reply. */
+static void _hiredis_session_track(hiredis_t* client, hiredis_argv_t* a) {
+    char cmd[16];
+    size_t len = a->argvlen[0];
+    zval tmp;
+    int i;
+    if (a->argc < 1 || !a->argv[0] || a->streams || len < 4 || len > 8) {
+        return;
+    }
+    memcpy(cmd, a->argv[0], len);
+    php_strtoupper(cmd, len);
+    if (!(len == 4 && 0 == memcmp(cmd, "AUTH", 4))
+        && !(len == 6 && 0 == memcmp(cmd, "SELECT", 6))
+        && !(len == 5 && 0 == memcmp(cmd, "HELLO", 5))
+        && !(len == 8 && 0 == memcmp(cmd, "READONLY", 8))
+        && !(len == 6 && 0 == memcmp(cmd, "CLIENT", 6) && a->argc > 1 && a->argv[1]
+            && a->argvlen[1] == 7 && 0 == strncasecmp(a->argv[1], "SETNAME", 7))
+    ) {
+        return;
+    }
+    array_init_size(&tmp, a->argc);
+    for (i = 0; i < a->argc; i++) {
+        add_next_index_stringl(&tmp, a->argv[i], a->argvlen[i]);
+    }
+    if (!client->session_cmds) {
+        ALLOC_HASHTABLE(client->session_cmds);
+        zend_hash_init(client->session_cmds, 4, NULL, ZVAL_PTR_DTOR, 0);
+    }
+    zend_hash_str_update(client->session_cmds, cmd, len, &tmp);
+    if (client->hedge) {
+        // Reconnect the replica so it picks up the new state
+        _hiredis_hedge_disconnect(client->hedge);
+    }
+    if ((len == 4 && 0 == memcmp(cmd, "AUTH", 4)) || (len == 5 && 0 == memcmp(cmd, "HELLO", 5))) {
+        // COMMAND may have been refused before authenticating
+        _hiredis_cmd_table_load(client, 1);
+    }
+}
+#endif
+
+static void _hiredis_send_raw_array(INTERNAL_FUNCTION_PARAMETERS, hiredis_t* client, char* cmd, zval* args, int argc, int is_append) {
+    hiredis_argv_t a;
+    #if PHP_MAJOR_VERSION >= 7
+        uint32_t* fanout = NULL;
+        int fanout_len = 0;
+        int send_argc;
+        size_t obuf_off;
+        int hedge = 0;
+        long decode;
+    #endif
+    #ifdef HAVE_HIREDIS_USDT
+        uint64_t probe_start = 0;
+        long long probe_size;
+        int probe_i;
+    #endif
+
+    #ifdef PHP_HIREDIS_BG_READER
+        if (!is_append && REDIS_OK != _hiredis_bg_drain(client)) {
+            RETURN_FALSE;
+        }
+    #endif
+    _hiredis_argv_build(&a, cmd, args, argc);
+    if (REDIS_OK != _hiredis_io_before_send(client)) {
+        _hiredis_argv_free(&a);
+        RETURN_FALSE;
+    }
+    #ifdef PHP_HIREDIS_HEALTH
+        if (a.argc > 0) {
+            _hiredis_health_track_tx(client, &a);
+        }
+    #endif
+    #ifdef HAVE_HIREDIS_USDT
+        if (PHP_HIREDIS_PROBE_ENABLED(command__start) && a.argc > 0) {
+            for (probe_size = 0, probe_i = 1; probe_i < a.argc; probe_i++) {
+                probe_size += a.argvlen[probe_i];
+            }
+            PHP_HIREDIS_PROBE5(command__start, a.argv[0], a.argvlen[0], a.argc, probe_size, client->ctx->fd);
+        }
+        if (PHP_HIREDIS_PROBE_ENABLED(command__done)) {
+            probe_start = _hiredis_probe_now_ns();
+        }
+    #endif
+    if (HIREDIS_G(hotkeys_sample_rate) > 0 && ++HIREDIS_G(hotkeys_tick) >= HIREDIS_G(hotkeys_sample_rate)) {
+        HIREDIS_G(hotkeys_tick) = 0;
+        _hiredis_hotkeys_sample(&a);
+    }
+    #if PHP_MAJOR_VERSION >= 7
+        if (client->hedge) {
+            hedge = _hiredis_hedge_eligible(client, &a);
+        }
+        decode = client->decode_next || client->decode_hints ? _hiredis_decode_hint(client, &a) : 0;
+    #endif
+
+    // Send/queue command
+    #if PHP_MAJOR_VERSION >= 7
+    if (a.streams) {
+        // Stream args are written out immediately, even in auto_pipeline mode
+        const char* errstr = NULL;
+        if (REDIS_OK != _hiredis_pipeline_flush(client)) {
+            RETVAL_FALSE;
+        } else if (REDIS_OK != _hiredis_io_send_streamed(client, &a, &errstr)) {
+            if (errstr) {
+                PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, errstr);
+            } else {
+                PHP_HIREDIS_SET_ERROR(client);
+            }
+            RETVAL_FALSE;
+        } else if (is_append) {
+            client->raw_pending++;
+            RETVAL_TRUE;
+            #ifdef PHP_HIREDIS_BG_READER
+                if (client->bg_enabled && REDIS_OK != _hiredis_bg_send(client)) {
+                    RETVAL_FALSE;
+                }
+            #endif
+        } else if (REDIS_OK == _hiredis_io_get_reply(client, return_value)) {
+            PHP_HIREDIS_RETURN_OR_THROW(client, return_value);
+        } else {
+            PHP_HIREDIS_SET_ERROR(client);
+            RETVAL_FALSE;
+        }
+    } else
+    #endif
+    if (is_append) {
+        if (REDIS_OK != _hiredis_pipeline_flush(client)) {
+            RETVAL_FALSE;
+        } else if (REDIS_OK != redisAppendCommandArgv(client->ctx, a.argc, (const char**)a.argv, a.argvlen)) {
+            PHP_HIREDIS_SET_ERROR(client);
+            RETVAL_FALSE;
+        } else {
+            client->raw_pending++;
+            RETVAL_TRUE;
+            #ifdef PHP_HIREDIS_BG_READER
+                if (client->bg_enabled && REDIS_OK != _hiredis_bg_send(client)) {
+                    RETVAL_FALSE;
+                }
+            #endif
+        }
+    #if PHP_MAJOR_VERSION >= 7
+    } else if (client->auto_pipeline) {
+        fanout = _hiredis_argv_dedup(&a, &send_argc, &fanout_len);
+        obuf_off = sdslen(client->ctx->obuf);
+        if (client->raw_pending > 0) {
+            PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "Cannot queue command with appendRaw replies pending");
+            RETVAL_FALSE;
+        } else if (REDIS_OK != redisAppendCommandArgv(client->ctx, send_argc, (const char**)a.argv, a.argvlen)) {
+            PHP_HIREDIS_SET_ERROR(client);
+            RETVAL_FALSE;
+        } else if (fanout || !_hiredis_singleflight(client, &a, obuf_off, return_value)) {
+            _hiredis_pipeline_push(client, return_value);
+            if (fanout) {
+                Z_HIREDIS_FUTURE_P(return_value)->fanout = fanout;
+                Z_HIREDIS_FUTURE_P(return_value)->fanout_len = fanout_len;
+                fanout = NULL;
+            }
+        }
+    } else if (REDIS_OK != _hiredis_pipeline_flush(client)) {
+        RETVAL_FALSE;
+    } else {
+        fanout = _hiredis_argv_dedup(&a, &send_argc, &fanout_len);
+        obuf_off = sdslen(client->ctx->obuf);
+        // Hinted replies are decoded eagerly, never as HiredisLazyReply
+        client->decode_hint = decode;
+        if (REDIS_OK == redisAppendCommandArgv(client->ctx, send_argc, (const char**)a.argv, a.argvlen)
+            && REDIS_OK == (fanout ? _hiredis_io_get_reply(client, return_value)
+                : hedge ? _hiredis_hedge_get_reply(client, &a, obuf_off, return_value)
+                : decode ? _hiredis_io_get_reply(client, return_value)
+                : _hiredis_io_get_reply_lazy(client, return_value))
+        ) {
+            client->decode_hint = 0;
+            if (fanout && !client->reply_is_error) {
+                _hiredis_reply_fanout(return_value, fanout, fanout_len);
+            }
+            if ((decode & PHP_HIREDIS_DECODE_MAP) && !client->reply_is_error) {
+                _hiredis_decode_map(return_value);
+            } else if ((decode & PHP_HIREDIS_DECODE_INFO) && !client->reply_is_error) {
+                _hiredis_decode_info(return_value);
+            }
+            if (!client->reply_is_error) {
+                _hiredis_session_track(client, &a);
+            }
+            PHP_HIREDIS_RETURN_OR_THROW(client, return_value);
+        } else {
+            client->decode_hint = 0;
+            PHP_HIREDIS_SET_ERROR(client);
+            RETVAL_FALSE;
+        }
+    }
+    if (fanout) {
+        efree(fanout);
+    }
+    #else
+    } else if (REDIS_OK != _hiredis_pipeline_flush(client)) {
+        RETVAL_FALSE;
+    } else {
+        if (REDIS_OK == redisAppendCommandArgv(client->ctx, a.argc, (const char**)a.argv, a.argvlen)
+            && REDIS_OK == _hiredis_io_get_reply(client, return_value)
+        ) {
+            PHP_HIREDIS_RETURN_OR_THROW(client, return_value);
+        } else {
+            PHP_HIREDIS_SET_ERROR(client);
+            RETVAL_FALSE;
+        }
+    }
+    #endif
+
+    #ifdef HAVE_HIREDIS_USDT
+        if (probe_start && a.argc > 0) {
+            probe_i = _hiredis_probe_reply_type(client, return_value, &probe_size);
+            PHP_HIREDIS_PROBE6(command__done, a.argv[0], a.argvlen[0], probe_i, probe_size,
+                _hiredis_probe_now_ns() - probe_start, client->ctx ? client->ctx->fd : -1);
+        }
+    #endif
+    _hiredis_argv_free(&a);
+}
+
+/* Send a command and copy its bulk string reply into a stream */
+static void _hiredis_send_to_stream(INTERNAL_FUNCTION_PARAMETERS, hiredis_t* client, zval* args, int argc, zval* zstream, long chunk_size) {
+    php_stream* stream;
+    hiredis_argv_t a;
+    int stream_ok = 1;
+
+    #if PHP_MAJOR_VERSION >= 7
+        php_stream_from_zval(stream, zstream);
+    #else
+        php_stream_from_zval(stream, &zstream);
+    #endif
+    if (chunk_size <= 0) {
+        chunk_size = PHP_HIREDIS_STREAM_CHUNK;
+    }
+    #ifdef PHP_HIREDIS_BG_READER
+        if (REDIS_OK != _hiredis_bg_drain(client)) {
+            RETURN_FALSE;
+        }
+    #endif
+    if (REDIS_OK != _hiredis_pipeline_flush(client)) {
+        RETURN_FALSE;
+    }
+    if (client->raw_pending > 0 || client->ctx->reader->pos < client->ctx->reader->len) {
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "Cannot stream reply with replies pending");
+        RETURN_FALSE;
+    } else if (REDIS_OK != _hiredis_io_before_send(client)) {
+        RETURN_FALSE;
+    }
+
+    _hiredis_argv_build(&a, NULL, args, argc);
+    #if PHP_MAJOR_VERSION >= 7
+    if (a.streams) {
+        const char* errstr = NULL;
+        if (REDIS_OK != _hiredis_io_send_streamed(client, &a, &errstr)) {
+            if (errstr) {
+                PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, errstr);
+            } else {
+                PHP_HIREDIS_SET_ERROR(client);
+            }
+            _hiredis_argv_free(&a);
+            RETURN_FALSE;
+        }
+    } else
+    #endif
+    if (REDIS_OK != redisAppendCommandArgv(client->ctx, a.argc, (const char**)a.argv, a.argvlen)) {
+        PHP_HIREDIS_SET_ERROR(client);
+        _hiredis_argv_free(&a);
+        RETURN_FALSE;
+    }
+    if (REDIS_OK != _hiredis_io_reply_to_stream(client, stream, (size_t)chunk_size, return_value, &stream_ok)
+    ) {
+        PHP_HIREDIS_SET_ERROR(client);
+        RETVAL_FALSE;
+    } else if (!stream_ok) {
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "Failed writing reply to stream");
+        RETVAL_FALSE;
+    } else {
+        PHP_HIREDIS_RETURN_OR_THROW(client, return_value);
+    }
+    _hiredis_argv_free(&a);
+}
+
+/* Prepare args for _hiredis_send_raw_array */
+static void _hiredis_send_raw(INTERNAL_FUNCTION_PARAMETERS, int is_array, int is_append) {
+    hiredis_t* client;
+    zval* zobj;
+    int argc;
+    zval* args;
+    #if PHP_MAJOR_VERSION >= 7
+        zval* varargs;
+    #else
+        zval*** varargs;
+    #endif
+
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "O+", &zobj, hiredis_ce, &varargs, &argc) == FAILURE) {
+        RETURN_FALSE;
+    }
+    if ((is_array && argc != 1) || (!is_array && argc < 1)) {
+        WRONG_PARAM_COUNT;
+    }
+
+    client = Z_HIREDIS_P(zobj);
+    PHP_HIREDIS_ENSURE_CTX(client);
+
+    #if PHP_MAJOR_VERSION >= 7
+        if (is_array) {
+            _hiredis_convert_zval_to_array_of_zvals(varargs, &args, &argc);
+        } else {
+            args = varargs;
+        }
+    #else
+        if (is_array) {
+            _hiredis_convert_zval_to_array_of_zvals(**varargs, &args, &argc);
+        } else {
+            int i;
+            args = (zval*)safe_emalloc(argc, sizeof(zval), 0);
+            for (i = 0; i < argc; i++) memcpy(&args[i], *(varargs[i]), sizeof(zval));
+        }
+    #endif
+
+    _hiredis_send_raw_array(INTERNAL_FUNCTION_PARAM_PASSTHRU, client, NULL, args, argc, is_append);
+
+    #if PHP_MAJOR_VERSION >= 7
+        if (is_array) efree(args);
+    #else
+        efree(args);
+        efree(varargs);
+    #endif
+}
+
+#if PHP_MAJOR_VERSION >= 7
+/* Shared-memory reply cache. The segment is mapped at MINIT, before
+   workers fork, and split into shards that each have a spinlock and a
+   table of fixed-size slots. A key hashes to a set of
+   PHP_HIREDIS_SHM_WAYS slots in one shard. A slot holds either a value
+   (expires_ms in the future) or a lease: a worker that misses takes the
+   lease and fetches from Redis while others wait for it, so a miss hits
+   Redis once instead of once per worker. */
+#define PHP_HIREDIS_SHM_SHARDS 64
+#define PHP_HIREDIS_SHM_WAYS   4
+#define PHP_HIREDIS_SHM_NIL    1
+#define PHP_HIREDIS_SHM_STR    2
+#define PHP_HIREDIS_SHM_LIST   3
+#define PHP_HIREDIS_SHM_HIT    0
+#define PHP_HIREDIS_SHM_LEASED 1
+#define PHP_HIREDIS_SHM_WAIT   2
+
+typedef struct {
+    zend_ulong hash;
+    uint64_t expires_ms;
+    uint64_t lease_ms;
+    uint32_t key_len;
+    uint32_t val_len;
+    uint32_t type;
+    char data[1];
+} hiredis_shm_slot_t;
+
+typedef struct {
+    volatile uint32_t lock;
+    char pad[60];
+} hiredis_shm_shard_t;
+
+typedef struct {
+    size_t size;
+    size_t slot_size;
+    size_t nsets;
+    volatile uint64_t hits;
+    volatile uint64_t misses;
+    volatile uint64_t stores;
+    hiredis_shm_shard_t shards[PHP_HIREDIS_SHM_SHARDS];
+} hiredis_shm_t;
+
+static hiredis_shm_t* hiredis_shm = NULL;
+
+/* Monotonic clock in ms; shared by all processes on the host */
+static uint64_t _hiredis_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Map the cache segment. Called at MINIT. */
+static void _hiredis_shm_init(size_t size, size_t slot_size) {
+    void* mem;
+    size_t nsets;
+    if (slot_size < sizeof(hiredis_shm_slot_t) + 64) {
+        slot_size = sizeof(hiredis_shm_slot_t) + 64;
+    }
+    slot_size = ZEND_MM_ALIGNED_SIZE(slot_size);
+    if (size <= sizeof(hiredis_shm_t)) {
+        return;
+    }
+    nsets = (size - sizeof(hiredis_shm_t)) / (slot_size * PHP_HIREDIS_SHM_WAYS * PHP_HIREDIS_SHM_SHARDS);
+    if (nsets < 1) {
+        return;
+    }
+    mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        php_error_docref(NULL, E_WARNING, "Failed to map hiredis.shm_cache_size bytes: %s", strerror(errno));
+        return;
+    }
+    hiredis_shm = (hiredis_shm_t*)mem;
+    hiredis_shm->size = size;
+    hiredis_shm->slot_size = slot_size;
+    hiredis_shm->nsets = nsets;
+}
+
+/* Unmap the cache segment. Called at MSHUTDOWN. */
+static void _hiredis_shm_free(void) {
+    if (hiredis_shm) {
+        munmap(hiredis_shm, hiredis_shm->size);
+        hiredis_shm = NULL;
+    }
+}
+
+/* Lock a shard. The lock word holds the owner's pid so a lock left behind
+   by a killed worker can be taken over. */
+static void _hiredis_shm_lock(hiredis_shm_shard_t* shard) {
+    uint32_t self = (uint32_t)getpid();
+    uint32_t owner;
+    unsigned int spins = 0;
+    while (!__sync_bool_compare_and_swap(&shard->lock, 0, self)) {
+        if (++spins % 1024 == 0) {
+            owner = shard->lock;
+            if (owner && owner != self && kill((pid_t)owner, 0) != 0 && errno == ESRCH
+                && __sync_bool_compare_and_swap(&shard->lock, owner, self)
+            ) {
+                return;
+            }
+            sched_yield();
+        }
+    }
+}
+
+static inline void _hiredis_shm_unlock(hiredis_shm_shard_t* shard) {
+    __sync_lock_release(&shard->lock);
+}
+
+/* Find the slot for ckey in its set, or NULL. If victim is not NULL it is
+   set to the slot to reuse when ckey is absent. Caller holds the lock. */
+static hiredis_shm_slot_t* _hiredis_shm_find(const char* ckey, size_t ckey_len, zend_ulong h, hiredis_shm_shard_t** shard, hiredis_shm_slot_t** victim) {
+    hiredis_shm_slot_t* slot;
+    size_t shard_idx, set_idx, i;
+    char* base;
+    shard_idx = h % PHP_HIREDIS_SHM_SHARDS;
+    set_idx = (h / PHP_HIREDIS_SHM_SHARDS) % hiredis_shm->nsets;
+    base = (char*)hiredis_shm + sizeof(hiredis_shm_t)
+        + ((shard_idx * hiredis_shm->nsets + set_idx) * PHP_HIREDIS_SHM_WAYS) * hiredis_shm->slot_size;
+    *shard = &hiredis_shm->shards[shard_idx];
+    if (victim) {
+        *victim = (hiredis_shm_slot_t*)base;
+    }
+    for (i = 0; i < PHP_HIREDIS_SHM_WAYS; i++) {
+        slot = (hiredis_shm_slot_t*)(base + i * hiredis_shm->slot_size);
+        if (slot->hash == h && slot->key_len == ckey_len && 0 == memcmp(slot->data, ckey, ckey_len)) {
+            return slot;
+        }
+        if (victim && MAX(slot->expires_ms, slot->lease_ms) < MAX((*victim)->expires_ms, (*victim)->lease_ms)) {
+            *victim = slot;
+        }
+    }
+    return NULL;
+}
+
+/* Shard that owns hash h */
+static inline hiredis_shm_shard_t* _hiredis_shm_shard_for(zend_ulong h) {
+    return &hiredis_shm->shards[h % PHP_HIREDIS_SHM_SHARDS];
+}
+
+/* Decode a cached value into dest. Caller holds the lock. */
+static void _hiredis_shm_decode(hiredis_shm_slot_t* slot, zval* dest) {
+    const char* p = slot->data + slot->key_len;
+    uint32_t n, len;
+    if (slot->type == PHP_HIREDIS_SHM_STR) {
+        ZVAL_STRINGL(dest, p, slot->val_len);
+    } else if (slot->type == PHP_HIREDIS_SHM_LIST) {
+        memcpy(&n, p, sizeof(n));
+        p += sizeof(n);
+        array_init_size(dest, n);
+        zend_hash_real_init(Z_ARRVAL_P(dest), 1);
+        while (n-- > 0) {
+            memcpy(&len, p, sizeof(len));
+            p += sizeof(len);
+            add_next_index_stringl(dest, p, len);
+            p += len;
+        }
+    } else {
+        ZVAL_NULL(dest);
+    }
+}
+
+/* Size of the encoded form of value, or 0 if it cannot be cached */
+static size_t _hiredis_shm_encoded_len(zval* value, uint32_t* type) {
+    zval* zv;
+    size_t len;
+    if (Z_TYPE_P(value) == IS_NULL) {
+        *type = PHP_HIREDIS_SHM_NIL;
+        return 1;
+    } else if (Z_TYPE_P(value) == IS_STRING) {
+        *type = PHP_HIREDIS_SHM_STR;
+        return Z_STRLEN_P(value) + 1;
+    } else if (Z_TYPE_P(value) == IS_ARRAY) {
+        *type = PHP_HIREDIS_SHM_LIST;
+        len = sizeof(uint32_t);
+        ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(value), zv) {
+            if (Z_TYPE_P(zv) != IS_STRING) {
+                return 0;
+            }
+            len += sizeof(uint32_t) + Z_STRLEN_P(zv);
+        } ZEND_HASH_FOREACH_END();
+        return len + 1;
+    }
+    return 0;
+}
+
+/* Encode value after the key in slot. Caller holds the lock. */
+static void _hiredis_shm_encode(hiredis_shm_slot_t* slot, zval* value, uint32_t type) {
+    char* p = slot->data + slot->key_len;
+    uint32_t n, len;
+    zval* zv;
+    slot->type = type;
+    slot->val_len = 0;
+    if (type == PHP_HIREDIS_SHM_STR) {
+        memcpy(p, Z_STRVAL_P(value), Z_STRLEN_P(value));
+        slot->val_len = Z_STRLEN_P(value);
+    } else if (type == PHP_HIREDIS_SHM_LIST) {
+        n = zend_hash_num_elements(Z_ARRVAL_P(value));
+        memcpy(p, &n, sizeof(n));
+        p += sizeof(n);
+        ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(value), zv) {
+            len = Z_STRLEN_P(zv);
+            memcpy(p, &len, sizeof(len));
+            memcpy(p + sizeof(len), Z_STRVAL_P(zv), len);
+            p += sizeof(len) + len;
+        } ZEND_HASH_FOREACH_END();
+        slot->val_len = p - (slot->data + slot->key_len);
+    }
+}
+
+/* Look up ckey. Returns PHP_HIREDIS_SHM_HIT with dest set,
+   PHP_HIREDIS_SHM_LEASED if the caller now holds the lease and must fetch
+   the value, or PHP_HIREDIS_SHM_WAIT if another worker is fetching it. */
+static int _hiredis_shm_get(const char* ckey, size_t ckey_len, zval* dest) {
+    hiredis_shm_shard_t* shard;
+    hiredis_shm_slot_t* slot;
+    hiredis_shm_slot_t* victim;
+    zend_ulong h = zend_inline_hash_func(ckey, ckey_len);
+    uint64_t now = _hiredis_now_ms();
+    int rc;
+
+    if (ckey_len + sizeof(hiredis_shm_slot_t) > hiredis_shm->slot_size) {
+        return PHP_HIREDIS_SHM_LEASED;
+    }
+    _hiredis_shm_lock(_hiredis_shm_shard_for(h));
+    slot = _hiredis_shm_find(ckey, ckey_len, h, &shard, &victim);
+    if (slot && slot->expires_ms > now) {
+        _hiredis_shm_decode(slot, dest);
+        rc = PHP_HIREDIS_SHM_HIT;
+    } else if (slot && slot->lease_ms > now) {
+        rc = PHP_HIREDIS_SHM_WAIT;
+    } else {
+        if (!slot) {
+            slot = victim;
+            slot->hash = h;
+            slot->key_len = ckey_len;
+            memcpy(slot->data, ckey, ckey_len);
+        }
+        slot->expires_ms = 0;
+        slot->lease_ms = now + HIREDIS_G(shm_cache_lease_ms);
+        rc = PHP_HIREDIS_SHM_LEASED;
+    }
+    _hiredis_shm_unlock(shard);
+    if (rc == PHP_HIREDIS_SHM_HIT) {
+        __sync_fetch_and_add(&hiredis_shm->hits, 1);
+    } else if (rc == PHP_HIREDIS_SHM_LEASED) {
+        __sync_fetch_and_add(&hiredis_shm->misses, 1);
+    }
+    return rc;
+}
+
+/* Store value for ckey and release the lease. Values that are not a
+   string, nil or flat list of strings, or do not fit a slot, are not
+   cached. */
+static void _hiredis_shm_put(const char* ckey, size_t ckey_len, zval* value, zend_long ttl_ms) {
+    hiredis_shm_shard_t* shard;
+    hiredis_shm_slot_t* slot;
+    hiredis_shm_slot_t* victim;
+    zend_ulong h = zend_inline_hash_func(ckey, ckey_len);
+    uint32_t type;
+    size_t len;
+
+    len = _hiredis_shm_encoded_len(value, &type);
+    _hiredis_shm_lock(_hiredis_shm_shard_for(h));
+    slot = _hiredis_shm_find(ckey, ckey_len, h, &shard, &victim);
+    if (len > 0 && sizeof(hiredis_shm_slot_t) + ckey_len + len <= hiredis_shm->slot_size) {
+        if (!slot) {
+            slot = victim;
+            slot->hash = h;
+            slot->key_len = ckey_len;
+            memcpy(slot->data, ckey, ckey_len);
+        }
+        _hiredis_shm_encode(slot, value, type);
+        slot->expires_ms = _hiredis_now_ms() + ttl_ms;
+        slot->lease_ms = 0;
+        __sync_fetch_and_add(&hiredis_shm->stores, 1);
+    } else if (slot) {
+        slot->lease_ms = 0;
+    }
+    _hiredis_shm_unlock(shard);
+}
+
+/* Drop a cached value (and any lease) for ckey */
+static void _hiredis_shm_del(const char* ckey, size_t ckey_len) {
+    hiredis_shm_shard_t* shard;
+    hiredis_shm_slot_t* slot;
+    zend_ulong h = zend_inline_hash_func(ckey, ckey_len);
+    _hiredis_shm_lock(_hiredis_shm_shard_for(h));
+    slot = _hiredis_shm_find(ckey, ckey_len, h, &shard, NULL);
+    if (slot) {
+        slot->hash = 0;
+        slot->key_len = 0;
+        slot->expires_ms = 0;
+        slot->lease_ms = 0;
+    }
+    _hiredis_shm_unlock(shard);
+}
+
+/* Build the cache key: command letter, server address and the Redis key */
+static char* _hiredis_shm_key(hiredis_t* client, char type, const char* key, size_t key_len, size_t* ckey_len) {
+    redisContext* c = client->ctx;
+    char* ckey;
+    char addr[128];
+    size_t addr_len;
+    if (c->connection_type == REDIS_CONN_UNIX) {
+        addr_len = snprintf(addr, sizeof(addr), "%s", c->unix_sock.path ? c->unix_sock.path : "");
+    } else {
+        addr_len = snprintf(addr, sizeof(addr), "%s:%d", c->tcp.host ? c->tcp.host : "", c->tcp.port);
+    }
+    addr_len = MIN(addr_len, sizeof(addr) - 1);
+    *ckey_len = 1 + addr_len + 1 + key_len;
+    ckey = emalloc(*ckey_len);
+    ckey[0] = type;
+    memcpy(ckey + 1, addr, addr_len);
+    ckey[1 + addr_len] = '\0';
+    memcpy(ckey + 2 + addr_len, key, key_len);
+    return ckey;
+}
+#endif
+
+#if PHP_MAJOR_VERSION >= 7
+/* Sentinel topology cache. The master and replica addresses of a master
+   name are kept as one "host:port\nhost:port..." string for
+   hiredis.sentinel_ttl_ms: in the shared segment when hiredis.shm_cache_size
+   is set, otherwise per process. The entry is dropped on a READONLY reply
+   or connection error, and by the watcher thread on +switch-master. */
+typedef struct {
+    uint64_t expires_ms;
+    uint32_t epoch;
+    size_t len;
+    char data[1];
+} hiredis_sentinel_entry_t;
+
+static volatile uint32_t hiredis_sentinel_epoch = 0;
+
+/* Build the shared cache key for a master name */
+static char* _hiredis_sentinel_key(const char* name, size_t name_len, size_t* ckey_len, int persistent) {
+    char* ckey;
+    *ckey_len = 2 + name_len;
+    ckey = pemalloc(*ckey_len, persistent);
+    ckey[0] = 'S';
+    ckey[1] = '\0';
+    memcpy(ckey + 2, name, name_len);
+    return ckey;
+}
+
+static void _hiredis_sentinel_entry_dtor(zval* zv) {
+    pefree(Z_PTR_P(zv), 1);
+}
+
+/* Look up the topology of name. Returns 1 with topo set on a hit. */
+static int _hiredis_sentinel_cache_get(const char* name, size_t name_len, zval* topo) {
+    hiredis_sentinel_entry_t* entry;
+    char* ckey;
+    size_t ckey_len;
+    int rc = 0;
+    if (hiredis_shm) {
+        ckey = _hiredis_sentinel_key(name, name_len, &ckey_len, 0);
+        if (PHP_HIREDIS_SHM_HIT == _hiredis_shm_get(ckey, ckey_len, topo)) {
+            if (Z_TYPE_P(topo) == IS_STRING) {
+                rc = 1;
+            } else {
+                zval_ptr_dtor(topo);
+            }
+        }
+        efree(ckey);
+        return rc;
+    }
+    if (HIREDIS_G(sentinel_cache)
+        && (entry = zend_hash_str_find_ptr(HIREDIS_G(sentinel_cache), name, name_len))
+        && entry->expires_ms > _hiredis_now_ms()
+        && entry->epoch == hiredis_sentinel_epoch
+    ) {
+        ZVAL_STRINGL(topo, entry->data, entry->len);
+        rc = 1;
+    }
+    return rc;
+}
+
+/* Store the topology of name */
+static void _hiredis_sentinel_cache_put(const char* name, size_t name_len, zval* topo) {
+    hiredis_sentinel_entry_t* entry;
+    char* ckey;
+    size_t ckey_len;
+    if (hiredis_shm) {
+        ckey = _hiredis_sentinel_key(name, name_len, &ckey_len, 0);
+        _hiredis_shm_put(ckey, ckey_len, topo, HIREDIS_G(sentinel_ttl_ms));
+        efree(ckey);
+        return;
+    }
+    if (!HIREDIS_G(sentinel_cache)) {
+        HIREDIS_G(sentinel_cache) = pemalloc(sizeof(HashTable), 1);
+        zend_hash_init(HIREDIS_G(sentinel_cache), 8, NULL, _hiredis_sentinel_entry_dtor, 1);
+    }
+    entry = pemalloc(sizeof(hiredis_sentinel_entry_t) + Z_STRLEN_P(topo), 1);
+    entry->expires_ms = _hiredis_now_ms() + HIREDIS_G(sentinel_ttl_ms);
+    entry->epoch = hiredis_sentinel_epoch;
+    entry->len = Z_STRLEN_P(topo);
+    memcpy(entry->data, Z_STRVAL_P(topo), entry->len);
+    zend_hash_str_update_ptr(HIREDIS_G(sentinel_cache), name, name_len, entry);
+}
+
+/* Drop the topology of name, and any lease on it */
+static void _hiredis_sentinel_cache_del(const char* name, size_t name_len) {
+    char* ckey;
+    size_t ckey_len;
+    if (hiredis_shm) {
+        ckey = _hiredis_sentinel_key(name, name_len, &ckey_len, 0);
+        _hiredis_shm_del(ckey, ckey_len);
+        efree(ckey);
+    } else if (HIREDIS_G(sentinel_cache)) {
+        zend_hash_str_del(HIREDIS_G(sentinel_cache), name, name_len);
+    }
+}
+
+/* Called for every client error while connected through Sentinel. A
+   READONLY reply or a broken connection means the cached master may be
+   stale. */
+static void _hiredis_sentinel_on_error(hiredis_t* client) {
+    if (client->err == REDIS_ERR_IO || client->err == REDIS_ERR_EOF
+        || 0 == strncmp(client->errstr, "READONLY", sizeof("READONLY")-1)
+    ) {
+        _hiredis_sentinel_cache_del(client->sentinel_name, client->sentinel_name_len);
+    }
+}
+
+/* Look up a field in a flat [key, value, ...] reply */
+static redisReply* _hiredis_reply_field(redisReply* r, const char* key) {
+    size_t i;
+    for (i = 0; i + 1 < r->elements; i += 2) {
+        if (r->element[i]->type == REDIS_REPLY_STRING && 0 == strcmp(r->element[i]->str, key)) {
+            return r->element[i + 1];
+        }
+    }
+    return NULL;
+}
+
+/* Ask the sentinels in turn for the master and healthy replicas of name.
+   On success topo is the address list, master first. */
+static int _hiredis_sentinel_resolve(HashTable* sentinels, const char* name, size_t name_len, long timeout_us, zval* topo, char* errstr, size_t errstr_len) {
+    redisContext* c;
+    redisReply* r;
+    redisReply* rr;
+    redisReply* flags;
+    redisReply* ip;
+    redisReply* port;
+    struct timeval tv;
+    smart_str buf = {0};
+    char host[256];
+    int sport;
+    size_t i;
+    zval* zv;
+
+    snprintf(errstr, errstr_len, "No sentinel given");
+    tv.tv_sec = timeout_us / 1000000;
+    tv.tv_usec = timeout_us % 1000000;
+    ZEND_HASH_FOREACH_VAL(sentinels, zv) {
+        if (Z_TYPE_P(zv) != IS_STRING
+            || REDIS_OK != _hiredis_parse_addr(Z_STRVAL_P(zv), Z_STRLEN_P(zv), host, sizeof(host), &sport, 26379)
+        ) {
+            snprintf(errstr, errstr_len, "Invalid sentinel address");
+            continue;
+        }
+        c = timeout_us > 0 ? redisConnectWithTimeout(host, sport, tv) : redisConnect(host, sport);
+        if (!c || c->err) {
+            snprintf(errstr, errstr_len, "Sentinel %s:%d: %s", host, sport, c ? c->errstr : "redisConnect returned NULL");
+            if (c) {
+                redisFree(c);
+            }
+            continue;
+        }
+        if (timeout_us > 0) {
+            redisSetTimeout(c, tv);
+        }
+
+        // Master address
+        r = redisCommand(c, "SENTINEL get-master-addr-by-name %b", name, name_len);
+        if (!r || r->type != REDIS_REPLY_ARRAY || r->elements != 2
+            || r->element[0]->type != REDIS_REPLY_STRING || r->element[1]->type != REDIS_REPLY_STRING
+        ) {
+            snprintf(errstr, errstr_len, "Sentinel %s:%d: %s", host, sport,
+                !r ? c->errstr : r->type == REDIS_REPLY_ERROR ? r->str : "Unknown master name");
+            if (r) {
+                freeReplyObject(r);
+            }
+            redisFree(c);
+            continue;
+        }
+        smart_str_free(&buf);
+        smart_str_appendl(&buf, r->element[0]->str, r->element[0]->len);
+        smart_str_appendc(&buf, ':');
+        smart_str_appendl(&buf, r->element[1]->str, r->element[1]->len);
+        freeReplyObject(r);
+
+        // Replicas, skipping those Sentinel considers down (SENTINEL
+        // replicas is SENTINEL slaves before Redis 5)
+        r = redisCommand(c, "SENTINEL replicas %b", name, name_len);
+        if (r && r->type == REDIS_REPLY_ERROR) {
+            freeReplyObject(r);
+            r = redisCommand(c, "SENTINEL slaves %b", name, name_len);
+        }
+        if (r && r->type == REDIS_REPLY_ARRAY) {
+            for (i = 0; i < r->elements; i++) {
+                rr = r->element[i];
+                if (rr->type != REDIS_REPLY_ARRAY
+                    || !(ip = _hiredis_reply_field(rr, "ip")) || ip->type != REDIS_REPLY_STRING
+                    || !(port = _hiredis_reply_field(rr, "port")) || port->type != REDIS_REPLY_STRING
+                    || ((flags = _hiredis_reply_field(rr, "flags")) && flags->type == REDIS_REPLY_STRING
+                        && (strstr(flags->str, "down") || strstr(flags->str, "disconnected")))
+                ) {
+                    continue;
+                }
+                smart_str_appendc(&buf, '\n');
+                smart_str_appendl(&buf, ip->str, ip->len);
+                smart_str_appendc(&buf, ':');
+                smart_str_appendl(&buf, port->str, port->len);
+            }
+        }
+        if (r) {
+            freeReplyObject(r);
+        }
+        redisFree(c);
+        smart_str_0(&buf);
+        ZVAL_STR(topo, buf.s);
+        return REDIS_OK;
+    } ZEND_HASH_FOREACH_END();
+    smart_str_free(&buf);
+    return REDIS_ERR;
+}
+
+/* Connect client to line idx of a topology string */
+static int _hiredis_sentinel_connect(hiredis_t* client, zval* topo, int idx) {
+    const char* p = Z_STRVAL_P(topo);
+    const char* end = p + Z_STRLEN_P(topo);
+    const char* eol;
+    char host[256];
+    int port;
+    struct timeval tv;
+    while (idx-- > 0 && (p = memchr(p, '\n', end - p))) {
+        p++;
+    }
+    if (!p) {
+        return REDIS_ERR;
+    }
+    eol = memchr(p, '\n', end - p);
+    if (REDIS_OK != _hiredis_parse_addr(p, (eol ? eol : end) - p, host, sizeof(host), &port, 6379)) {
+        return REDIS_ERR;
+    }
+    if (client->timeout_us > 0) {
+        tv.tv_sec = client->timeout_us / 1000000;
+        tv.tv_usec = client->timeout_us % 1000000;
+        client->ctx = redisConnectWithTimeout(host, port, tv);
+    } else {
+        client->ctx = redisConnect(host, port);
+    }
+    if (!client->ctx || client->ctx->err) {
+        if (client->ctx) {
+            redisFree(client->ctx);
+            client->ctx = NULL;
+        }
+        return REDIS_ERR;
+    }
+    return REDIS_OK;
+}
+
+#ifdef PHP_HIREDIS_BG_READER
+/* Watcher threads: each stays subscribed to +switch-master on one of the
+   sentinels and drops the cached topology of its master name when that
+   master changes. They use plain hiredis replies and malloc only, never
+   engine memory. One watcher is started per master name and process, and
+   all of them poll a shared stop pipe so MSHUTDOWN can join them before
+   the shared memory and the module go away. */
+typedef struct hiredis_sentinel_watch_t {
+    char* name;
+    size_t name_len;
+    char* ckey;
+    size_t ckey_len;
+    int count;
+    char** hosts;
+    int* ports;
+    pthread_t tid;
+    struct hiredis_sentinel_watch_t* next;
+} hiredis_sentinel_watch_t;
+
+static pthread_mutex_t hiredis_sentinel_watch_lock = PTHREAD_MUTEX_INITIALIZER;
+static hiredis_sentinel_watch_t* hiredis_sentinel_watchers = NULL;
+static int hiredis_sentinel_watch_stop_fds[2] = {-1, -1};
+static int hiredis_sentinel_watch_atfork = 0;
+
+static void _hiredis_sentinel_watch_invalidate(hiredis_sentinel_watch_t* w) {
+    __sync_fetch_and_add(&hiredis_sentinel_epoch, 1);
+    if (hiredis_shm) {
+        _hiredis_shm_del(w->ckey, w->ckey_len);
+    }
+}
+
+/* Wait until fd is readable or the stop pipe fires. Returns 1 when fd is
+   readable, 0 on timeout and -1 when asked to stop. */
+static int _hiredis_sentinel_watch_poll(int fd, int timeout_ms) {
+    struct pollfd pfd[2];
+    int rv, n = 0;
+    pfd[n].fd = hiredis_sentinel_watch_stop_fds[0];
+    pfd[n].events = POLLIN;
+    pfd[n++].revents = 0;
+    if (fd >= 0) {
+        pfd[n].fd = fd;
+        pfd[n].events = POLLIN;
+        pfd[n++].revents = 0;
+    }
+    do {
+        rv = poll(pfd, n, timeout_ms);
+    } while (rv < 0 && errno == EINTR);
+    if (rv < 0 || pfd[0].revents) {
+        return -1;
+    }
+    return rv > 0 ? 1 : 0;
+}
+
+static void* _hiredis_sentinel_watch_main(void* arg) {
+    hiredis_sentinel_watch_t* w = (hiredis_sentinel_watch_t*)arg;
+    struct timeval tv = {1, 0};
+    redisContext* c;
+    redisReply* r;
+    int i = 0, rv = 0;
+    while (rv >= 0) {
+        c = redisConnectWithTimeout(w->hosts[i], w->ports[i], tv);
+        if (c && !c->err && REDIS_OK == redisSetTimeout(c, tv)
+            && (r = redisCommand(c, "SUBSCRIBE +switch-master"))
+        ) {
+            freeReplyObject(r);
+            // Events may have been missed while disconnected
+            _hiredis_sentinel_watch_invalidate(w);
+            while ((rv = _hiredis_sentinel_watch_poll(c->fd, -1)) > 0 && REDIS_OK == redisBufferRead(c)) {
+                r = NULL;
+                while (REDIS_OK == redisGetReplyFromReader(c, (void**)&r) && r) {
+                    // ["message", "+switch-master", "<name> <old ip> <old port> <new ip> <new port>"]
+                    if (r->type == REDIS_REPLY_ARRAY && r->elements == 3
+                        && r->element[2]->type == REDIS_REPLY_STRING
+                        && r->element[2]->len > w->name_len
+                        && r->element[2]->str[w->name_len] == ' '
+                        && 0 == memcmp(r->element[2]->str, w->name, w->name_len)
+                    ) {
+                        _hiredis_sentinel_watch_invalidate(w);
+                    }
+                    freeReplyObject(r);
+                    r = NULL;
+                }
+            }
+        }
+        if (c) {
+            redisFree(c);
+        }
+        i = (i + 1) % w->count;
+        if (rv >= 0) {
+            rv = _hiredis_sentinel_watch_poll(-1, 1000);
+        }
+    }
+    return NULL;
+}
+
+static void _hiredis_sentinel_watch_free(hiredis_sentinel_watch_t* w) {
+    while (w->count-- > 0) {
+        free(w->hosts[w->count]);
+    }
+    free(w->hosts);
+    free(w->ports);
+    pefree(w->ckey, 1);
+    free(w->name);
+    free(w);
+}
+
+/* Drop the watcher list without joining, for list entries whose threads
+   do not exist (fork child) */
+static void _hiredis_sentinel_watch_forget(void) {
+    hiredis_sentinel_watch_t* w;
+    while ((w = hiredis_sentinel_watchers)) {
+        hiredis_sentinel_watchers = w->next;
+        _hiredis_sentinel_watch_free(w);
+    }
+    if (hiredis_sentinel_watch_stop_fds[0] >= 0) {
+        close(hiredis_sentinel_watch_stop_fds[0]);
+        close(hiredis_sentinel_watch_stop_fds[1]);
+        hiredis_sentinel_watch_stop_fds[0] = hiredis_sentinel_watch_stop_fds[1] = -1;
+    }
+}
+
+/* fork() only copies the calling thread, so a child starts with no
+   watchers and watches again on its first Sentinel connect */
+static void _hiredis_sentinel_watch_prefork(void) {
+    pthread_mutex_lock(&hiredis_sentinel_watch_lock);
+}
+static void _hiredis_sentinel_watch_postfork(void) {
+    pthread_mutex_unlock(&hiredis_sentinel_watch_lock);
+}
+static void _hiredis_sentinel_watch_postfork_child(void) {
+    _hiredis_sentinel_watch_forget();
+    pthread_mutex_unlock(&hiredis_sentinel_watch_lock);
+}
+
+/* Start a watcher for name unless this process already has one */
+static void _hiredis_sentinel_watch(const char* name, size_t name_len, HashTable* sentinels) {
+    hiredis_sentinel_watch_t* w;
+    char host[256];
+    int port;
+    zval* zv;
+
+    pthread_mutex_lock(&hiredis_sentinel_watch_lock);
+    for (w = hiredis_sentinel_watchers; w; w = w->next) {
+        if (w->name_len == name_len && 0 == memcmp(w->name, name, name_len)) {
+            pthread_mutex_unlock(&hiredis_sentinel_watch_lock);
+            return;
+        }
+    }
+    if (!hiredis_sentinel_watch_atfork) {
+        hiredis_sentinel_watch_atfork = 1;
+        pthread_atfork(_hiredis_sentinel_watch_prefork, _hiredis_sentinel_watch_postfork, _hiredis_sentinel_watch_postfork_child);
+    }
+    if (hiredis_sentinel_watch_stop_fds[0] < 0) {
+        if (0 != pipe(hiredis_sentinel_watch_stop_fds)) {
+            hiredis_sentinel_watch_stop_fds[0] = hiredis_sentinel_watch_stop_fds[1] = -1;
+            pthread_mutex_unlock(&hiredis_sentinel_watch_lock);
+            return;
+        }
+        fcntl(hiredis_sentinel_watch_stop_fds[0], F_SETFD, FD_CLOEXEC);
+        fcntl(hiredis_sentinel_watch_stop_fds[1], F_SETFD, FD_CLOEXEC);
+    }
+    w = calloc(1, sizeof(*w));
+    w->name = malloc(name_len);
+    memcpy(w->name, name, name_len);
+    w->name_len = name_len;
+    w->ckey = _hiredis_sentinel_key(name, name_len, &w->ckey_len, 1);
+    w->hosts = calloc(zend_hash_num_elements(sentinels), sizeof(char*));
+    w->ports = calloc(zend_hash_num_elements(sentinels), sizeof(int));
+    ZEND_HASH_FOREACH_VAL(sentinels, zv) {
+        if (Z_TYPE_P(zv) == IS_STRING
+            && REDIS_OK == _hiredis_parse_addr(Z_STRVAL_P(zv), Z_STRLEN_P(zv), host, sizeof(host), &port, 26379)
+        ) {
+            w->hosts[w->count] = strdup(host);
+            w->ports[w->count++] = port;
+        }
+    } ZEND_HASH_FOREACH_END();
+
+    if (w->count > 0 && 0 == pthread_create(&w->tid, NULL, _hiredis_sentinel_watch_main, w)) {
+        w->next = hiredis_sentinel_watchers;
+        hiredis_sentinel_watchers = w;
+    } else {
+        _hiredis_sentinel_watch_free(w);
+    }
+    pthread_mutex_unlock(&hiredis_sentinel_watch_lock);
+}
+
+/* Stop and join all watchers. Called from MSHUTDOWN before the shared
+   memory they write to is unmapped. */
+static void _hiredis_sentinel_watch_stop(void) {
+    hiredis_sentinel_watch_t* w;
+    ssize_t n;
+    pthread_mutex_lock(&hiredis_sentinel_watch_lock);
+    if (hiredis_sentinel_watchers) {
+        // The pipe is never read, so it stays readable for every watcher
+        do {
+            n = write(hiredis_sentinel_watch_stop_fds[1], "x", 1);
+        } while (n < 0 && errno == EINTR);
+        for (w = hiredis_sentinel_watchers; w; w = w->next) {
+            pthread_join(w->tid, NULL);
+        }
+    }
+    _hiredis_sentinel_watch_forget();
+    pthread_mutex_unlock(&hiredis_sentinel_watch_lock);
+}
+#endif
+#endif
+
+#ifdef PHP_HIREDIS_TLS
+/* TLS state kept per process: SSL_CTXs, keyed by their settings, so the CA
+   bundle and client certificate are loaded once, and the last session
+   ticket per server, so reconnects resume instead of doing a full
+   handshake. Certificates changed on disk are picked up on restart. */
+static void _hiredis_tls_ctx_dtor(zval* zv) {
+    SSL_CTX_free((SSL_CTX*)Z_PTR_P(zv));
+}
+
+static void _hiredis_tls_session_dtor(zval* zv) {
+    SSL_SESSION_free((SSL_SESSION*)Z_PTR_P(zv));
+}
+
+/* New session callback; keeps the session for the connection's server */
+static int _hiredis_tls_new_session(SSL* ssl, SSL_SESSION* sess) {
+    hiredis_t* client = (hiredis_t*)SSL_get_app_data(ssl);
+    HashTable* ht;
+    if (!client || !client->tls_key || !SSL_SESSION_is_resumable(sess)) {
+        return 0;
+    }
+    if (!(ht = HIREDIS_G(tls_sessions))) {
+        ht = pemalloc(sizeof(HashTable), 1);
+        zend_hash_init(ht, 8, NULL, _hiredis_tls_session_dtor, 1);
+        HIREDIS_G(tls_sessions) = ht;
+    }
+    zend_hash_str_update_ptr(ht, client->tls_key, strlen(client->tls_key), sess);
+    return 1;
+}
+
+/* Get the SSL_CTX for these settings, creating it on first use */
+static SSL_CTX* _hiredis_tls_ctx_get(const char* ca_file, const char* ca_path, const char* cert, const char* key, int verify, const char** errstr) {
+    HashTable* ht;
+    SSL_CTX* ctx;
+    char* ckey;
+    size_t ckey_len;
+    if (!(ht = HIREDIS_G(tls_ctxs))) {
+        ht = pemalloc(sizeof(HashTable), 1);
+        zend_hash_init(ht, 4, NULL, _hiredis_tls_ctx_dtor, 1);
+        HIREDIS_G(tls_ctxs) = ht;
+    }
+    ckey_len = spprintf(&ckey, 0, "%s\n%s\n%s\n%s\n%d", ca_file ? ca_file : "", ca_path ? ca_path : "", cert ? cert : "", key ? key : "", verify);
+    if ((ctx = zend_hash_str_find_ptr(ht, ckey, ckey_len))) {
+        efree(ckey);
+        return ctx;
+    }
+    if (!(ctx = SSL_CTX_new(TLS_client_method()))) {
+        *errstr = "Cannot create TLS context";
+        efree(ckey);
+        return NULL;
+    }
+    SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+    SSL_CTX_set_verify(ctx, verify ? SSL_VERIFY_PEER : SSL_VERIFY_NONE, NULL);
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(ctx, _hiredis_tls_new_session);
+    *errstr = NULL;
+    if (ca_file || ca_path) {
+        if (!SSL_CTX_load_verify_locations(ctx, ca_file, ca_path)) {
+            *errstr = "Cannot load CA certificates";
+        }
+    } else if (verify && !SSL_CTX_set_default_verify_paths(ctx)) {
+        *errstr = "Cannot load default CA certificates";
+    }
+    if (!*errstr && cert && !SSL_CTX_use_certificate_chain_file(ctx, cert)) {
+        *errstr = "Cannot load client certificate";
+    }
+    if (!*errstr && key && !SSL_CTX_use_PrivateKey_file(ctx, key, SSL_FILETYPE_PEM)) {
+        *errstr = "Cannot load client private key";
+    }
+    if (*errstr) {
+        SSL_CTX_free(ctx);
+        efree(ckey);
+        return NULL;
+    }
+    zend_hash_str_add_ptr(ht, ckey, ckey_len, ctx);
+    efree(ckey);
+    return ctx;
+}
+
+/* Run the TLS handshake on the connected socket, resuming the cached
+   session for this server if there is one. kTLS is requested when
+   enabled; OpenSSL falls back to user-space crypto if the kernel or the
+   negotiated cipher does not support it. */
+static int _hiredis_tls_handshake(hiredis_t* client) {
+    redisContext* c = client->ctx;
+    SSL* ssl;
+    SSL_SESSION* sess;
+    unsigned char ip[16];
+    int is_ip;
+    if (!(ssl = SSL_new(client->tls_ctx))) {
+        _hiredis_io_set_ctx_error(c, REDIS_ERR_OTHER, "Cannot create TLS connection");
+        return REDIS_ERR;
+    }
+    SSL_set_app_data(ssl, client);
+    is_ip = inet_pton(AF_INET, client->tls_name, ip) == 1 || inet_pton(AF_INET6, client->tls_name, ip) == 1;
+    if (!is_ip) {
+        SSL_set_tlsext_host_name(ssl, client->tls_name);
+    }
+    if (client->tls_verify) {
+        if (is_ip) {
+            X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(ssl), client->tls_name);
+        } else {
+            SSL_set1_host(ssl, client->tls_name);
+        }
+    }
+    #ifdef SSL_OP_ENABLE_KTLS
+        if (HIREDIS_G(tls_ktls)) {
+            SSL_set_options(ssl, SSL_OP_ENABLE_KTLS);
+        }
+    #endif
+    if (HIREDIS_G(tls_sessions)
+        && (sess = zend_hash_str_find_ptr(HIREDIS_G(tls_sessions), client->tls_key, strlen(client->tls_key)))
+    ) {
+        SSL_set_session(ssl, sess);
+    }
+    ERR_clear_error();
+    if (REDIS_OK != redisInitiateSSL(c, ssl)) {
+        SSL_free(ssl);
+        // Do not offer a session the server just refused to work with
+        if (HIREDIS_G(tls_sessions)) {
+            zend_hash_str_del(HIREDIS_G(tls_sessions), client->tls_key, strlen(client->tls_key));
+        }
+        return REDIS_ERR;
+    }
+    client->tls_ssl = ssl;
+    return REDIS_OK;
+}
+#endif
+
+/* Invoked after connecting */
+static int _hiredis_conn_init(hiredis_t* client) {
+    int rc;
+    rc = REDIS_OK;
+    if (client->keep_alive_int_s >= 0) {
+        if (REDIS_OK != _hiredis_set_keep_alive_int(client, client->keep_alive_int_s)) {
+            rc = REDIS_ERR;
+        }
+    }
+    if (client->timeout_us >= 0) {
+        if (REDIS_OK != _hiredis_set_timeout(client, client->timeout_us)) {
+            rc = REDIS_ERR;
+        }
+    }
+    client->ctx->reader->maxbuf = client->max_read_buf;
+    client->ctx->reader->fn = &hiredis_replyobj_funcs;
+    #ifdef PHP_HIREDIS_HEALTH
+        client->health_last_ms = _hiredis_health_now_ms();
+    #endif
+    #if PHP_MAJOR_VERSION >= 7
+        _hiredis_cmd_table_load(client, 0);
+    #endif
+    #if PHP_VERSION_ID >= 80100
+        if (Z_TYPE(client->fiber_scheduler) != IS_UNDEF) {
+            if (REDIS_OK != _hiredis_io_set_blocking(client, 0)) {
+                PHP_HIREDIS_SET_ERROR(client);
+                rc = REDIS_ERR;
+            }
+            return rc;
+        }
+    #endif
+    #ifdef HAVE_HIREDIS_URING
+        client->io_uring = HIREDIS_G(use_uring) && !PHP_HIREDIS_IS_TLS(client) && _hiredis_uring_get() != NULL;
+    #endif
+    return rc;
+}
+
+/* Invoked before connecting and at __destruct. Queued commands are flushed
+   first so fire-and-forget futures still reach the server. */
+static void _hiredis_conn_deinit(hiredis_t* client) {
+    if (client->ctx) {
+        _hiredis_pipeline_flush(client);
+        #ifdef PHP_HIREDIS_BG_READER
+            _hiredis_bg_free(client);
+        #endif
+        redisFree(client->ctx);
+    }
+    #if PHP_MAJOR_VERSION >= 7
+        _hiredis_lazy_scan_reset(client);
+        _hiredis_hedge_reset_primary(client);
+    #endif
+    if (client->sentinel_name) {
+        efree(client->sentinel_name);
+        client->sentinel_name = NULL;
+    }
+    if (client->session_cmds) {
+        zend_hash_clean(client->session_cmds);
+    }
+    #ifdef PHP_HIREDIS_HEALTH
+        client->health_in_tx = 0;
+    #endif
+    #ifdef PHP_HIREDIS_TLS
+        // The SSL object was freed along with the context
+        client->tls_ssl = NULL;
+        client->tls_ctx = NULL;
+        if (client->tls_key) {
+            efree(client->tls_key);
+            client->tls_key = NULL;
+        }
+        if (client->tls_name) {
+            efree(client->tls_name);
+            client->tls_name = NULL;
+        }
+    #endif
+    client->ctx = NULL;
+    client->raw_pending = 0;
+}
+
+#ifdef HAVE_HIREDIS_RECONNECT
+/* Reconnect to the same address, set TLS up again and replay the commands
+   recorded for idle reconnects. Sets the client error on failure. */
+static int _hiredis_reconnect(hiredis_t* client) {
+    int rc = REDIS_OK;
+    #ifdef HAVE_HIREDIS_USDT
+        uint64_t probe_start = PHP_HIREDIS_PROBE_ENABLED(reconnect) ? _hiredis_probe_now_ns() : 0;
+    #endif
+    #ifdef PHP_HIREDIS_BG_READER
+        _hiredis_bg_free(client);
+    #endif
+    #if PHP_MAJOR_VERSION >= 7
+        _hiredis_lazy_scan_reset(client);
+        _hiredis_hedge_reset_primary(client);
+    #endif
+    #if PHP_VERSION_ID >= 80100
+        // The fd number may be reused for the new socket
+        zval_ptr_dtor(&client->fiber_stream);
+        ZVAL_UNDEF(&client->fiber_stream);
+    #endif
+    client->raw_pending = 0;
+    #ifdef PHP_HIREDIS_HEALTH
+        client->health_in_tx = 0;
+    #endif
+    #ifdef PHP_HIREDIS_TLS
+        // redisReconnect frees the SSL object and comes back as plain TCP
+        client->tls_ssl = NULL;
+    #endif
+    if (REDIS_OK != redisReconnect(client->ctx)) {
+        PHP_HIREDIS_SET_ERROR(client);
+        rc = REDIS_ERR;
+    }
+    #ifdef PHP_HIREDIS_TLS
+        if (rc == REDIS_OK && client->tls_ctx) {
+            if (client->timeout_us >= 0 && REDIS_OK != _hiredis_set_timeout(client, client->timeout_us)) {
+                rc = REDIS_ERR;
+            } else if (REDIS_OK != _hiredis_tls_handshake(client)) {
+                PHP_HIREDIS_SET_ERROR(client);
+                rc = REDIS_ERR;
+            }
+        }
+    #endif
+    if (rc == REDIS_OK) {
+        rc = _hiredis_conn_init(client);
+    }
+    #ifdef PHP_HIREDIS_HEALTH
+        if (rc == REDIS_OK) {
+            rc = _hiredis_health_replay(client);
+        }
+    #endif
+    #ifdef HAVE_HIREDIS_USDT
+        if (probe_start) {
+            PHP_HIREDIS_PROBE3(reconnect, rc == REDIS_OK, _hiredis_probe_now_ns() - probe_start, rc == REDIS_OK ? client->ctx->fd : -1);
+        }
+    #endif
+    return rc;
+}
+#endif
+
+#ifdef PHP_HIREDIS_HEALTH
+/* Idle health checks. Before the first command on a connection idle for
+   health_idle_ms, a non-blocking poll (plus MSG_PEEK on plain sockets)
+   tells whether the server or a NAT/LB in between closed it, in which
+   case we reconnect before sending. A live connection costs one syscall
+   and never a PING. The connection state commands recorded by
+   _hiredis_session_track are replayed on such a reconnect; inside
+   MULTI/WATCH the command fails instead. */
+static int _hiredis_health_replay(hiredis_t* client) {
+    zval* cmd;
+    zval* arg;
+    zval reply;
+    const char** argv;
+    size_t* argvlen;
+    int argc, ok;
+    if (!client->session_cmds) {
+        return REDIS_OK;
+    }
+    ZEND_HASH_FOREACH_VAL(client->session_cmds, cmd) {
+        argc = 0;
+        argv = safe_emalloc(zend_hash_num_elements(Z_ARRVAL_P(cmd)), sizeof(char*), 0);
+        argvlen = safe_emalloc(zend_hash_num_elements(Z_ARRVAL_P(cmd)), sizeof(size_t), 0);
+        ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(cmd), arg) {
+            argv[argc] = Z_STRVAL_P(arg);
+            argvlen[argc++] = Z_STRLEN_P(arg);
+        } ZEND_HASH_FOREACH_END();
+        ok = REDIS_OK == redisAppendCommandArgv(client->ctx, argc, argv, argvlen)
+            && REDIS_OK == _hiredis_io_get_reply(client, &reply);
+        efree(argv);
+        efree(argvlen);
+        if (!ok) {
+            PHP_HIREDIS_SET_ERROR(client);
+            return REDIS_ERR;
+        } else if (client->reply_is_error) {
+            client->reply_is_error = 0;
+            PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, Z_STRVAL(reply));
+            zval_dtor(&reply);
+            return REDIS_ERR;
+        }
+        zval_ptr_dtor(&reply);
+    } ZEND_HASH_FOREACH_END();
+    // The connect-time load may have hit NOAUTH before AUTH was replayed
+    _hiredis_cmd_table_load(client, 0);
+    return REDIS_OK;
+}
+
+/* Track open transactions, during which a dead connection fails the
+   command instead of reconnecting */
+static void _hiredis_health_track_tx(hiredis_t* client, hiredis_argv_t* a) {
+    char cmd[8];
+    size_t len = a->argvlen[0];
+    if (!a->argv[0] || len < 4 || len > 7) {
+        return;
+    }
+    memcpy(cmd, a->argv[0], len);
+    php_strtoupper(cmd, len);
+    if ((len == 5 && 0 == memcmp(cmd, "MULTI", 5)) || (len == 5 && 0 == memcmp(cmd, "WATCH", 5))) {
+        client->health_in_tx = 1;
+    } else if ((len == 4 && 0 == memcmp(cmd, "EXEC", 4)) || (len == 7 && 0 == memcmp(cmd, "DISCARD", 7))
+        || (len == 7 && 0 == memcmp(cmd, "UNWATCH", 7))
+    ) {
+        client->health_in_tx = 0;
+    }
+}
+
+/* Check whether an idle connection is still open, reconnecting if not */
+static int _hiredis_health_check(hiredis_t* client) {
+    redisContext* c = client->ctx;
+    struct pollfd pfd;
+    char b;
+    ssize_t n;
+    int dead;
+    if (client->raw_pending > 0 || client->pending_len > 0 || client->bg || client->hedge_discard > 0
+        || sdslen(c->obuf) > 0 || c->reader->pos < c->reader->len
+    ) {
+        // Replies are still due, so the connection is in use
+        return REDIS_OK;
+    }
+    client->health_checks++;
+    if (c->err) {
+        dead = 1;
+    } else {
+        pfd.fd = c->fd;
+        pfd.events = POLLIN;
+        #ifdef POLLRDHUP
+            pfd.events |= POLLRDHUP;
+        #endif
+        pfd.revents = 0;
+        client->io_syscalls++;
+        if (poll(&pfd, 1, 0) <= 0) {
+            return REDIS_OK;
+        }
+        #ifdef POLLRDHUP
+            dead = (pfd.revents & (POLLERR | POLLHUP | POLLNVAL | POLLRDHUP)) != 0;
+        #else
+            dead = (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) != 0;
+        #endif
+        if (!dead && !PHP_HIREDIS_IS_TLS(client)) {
+            // Readable with nothing in flight: EOF or a reset, or an
+            // unsolicited message we leave for the reader. TLS sockets
+            // may hold session tickets, so only the flags count there.
+            client->io_syscalls++;
+            n = recv(c->fd, &b, 1, MSG_PEEK | MSG_DONTWAIT);
+            dead = n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+        }
+    }
+    if (!dead) {
+        return REDIS_OK;
+    } else if (client->health_in_tx) {
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR_EOF, "Connection closed while idle inside MULTI/WATCH");
+        return REDIS_ERR;
+    }
+    client->health_reconnects++;
+    return _hiredis_reconnect(client);
+}
+
+#endif
+
+/* Run by every command entry point before its first write: the Fiber
+   ownership check, the idle health check, which may reconnect, and the
+   idle clock behind it */
+static int _hiredis_io_before_send(hiredis_t* client) {
+    #if PHP_VERSION_ID >= 80100
+        if (_hiredis_fiber_busy(client)) {
+            return REDIS_ERR;
+        }
+    #endif
+    #ifdef PHP_HIREDIS_HEALTH
+        uint64_t now;
+        int rc = REDIS_OK;
+        if (client->health_idle_ms > 0 && client->ctx) {
+            now = _hiredis_health_now_ms();
+            if (now - client->health_last_ms >= (uint64_t)client->health_idle_ms) {
+                rc = _hiredis_health_check(client);
+            }
+            client->health_last_ms = now;
+        }
+        return rc;
+    #else
+        return REDIS_OK;
+    #endif
+}
+
+/* {{{ proto void Hiredis::__construct()
+   Constructor for Hiredis. */
+PHP_METHOD(Hiredis, __construct) {
+    hiredis_t* client;
+    if (zend_parse_parameters_none() == FAILURE) {
+        return;
+    }
+    return_value = getThis();
+    client = Z_HIREDIS_P(return_value);
+    client->ctx = NULL;
+    client->timeout_us = -1;
+    client->keep_alive_int_s = -1;
+    client->max_read_buf = REDIS_READER_MAX_BUF;
+    client->throw_exceptions = 0;
+    client->auto_pipeline = 0;
+    client->raw_pending = 0;
+    #ifdef PHP_HIREDIS_HEALTH
+        client->health_idle_ms = (long)HIREDIS_G(health_idle_ms);
+    #endif
+}
+/* }}} */
+
+/* {{{ proto void Hiredis::__destruct()
+   Destructor for Hiredis. */
+PHP_METHOD(Hiredis, __destruct) {
+    hiredis_t* client;
+    return_value = getThis();
+    client = Z_HIREDIS_P(return_value);
+    _hiredis_conn_deinit(client);
+}
+/* }}} */
+
+/* {{{ proto void Hiredis::__call(string func, array args)
+   Magic command handler. */
+PHP_METHOD(Hiredis, __call) {
+    hiredis_t* client;
+    char* ofunc;
+    char* func;
+    strlen_t func_len;
+    char* cmd;
+    zval* func_args;
+    int func_argc;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "sa", &ofunc, &func_len, &func_args) == FAILURE) {
+        RETURN_FALSE;
+    }
+
+    client = Z_HIREDIS_P(getThis());
+    PHP_HIREDIS_ENSURE_CTX(client);
+
+    func = estrndup(ofunc, func_len);
+    php_strtoupper(func, func_len);
+    cmd = _hiredis_cmd_info_find(func, func_len) ? func : NULL;
+
+    if (cmd) {
+        _hiredis_convert_zval_to_array_of_zvals(func_args, &func_args, &func_argc);
+        _hiredis_send_raw_array(INTERNAL_FUNCTION_PARAM_PASSTHRU, client, cmd, func_args, func_argc, 0);
+        efree(func_args);
+    } else {
+        #if PHP_MAJOR_VERSION >= 7
+            zend_throw_error(NULL, "Call to undefined method Hiredis::%s()", func);
+        #else
+            zend_throw_exception_ex(NULL, 0 TSRMLS_CC, "Call to undefined method Hiredis::%s()", func);
+        #endif
+    }
+    efree(func);
+}
+/* }}} */
+
+/* {{{ proto bool hiredis_connect(string ip, int port [, float timeout_s])
+   Connect to a server via TCP. */
+PHP_FUNCTION(hiredis_connect) {
+    zval* zobj;
+    hiredis_t* client;
+    char* ip;
+    strlen_t ip_len;
+    long port;
+    double timeout_s = -1;
+    #ifdef HAVE_HIREDIS_USDT
+        uint64_t probe_start = PHP_HIREDIS_PROBE_ENABLED(connect) ? _hiredis_probe_now_ns() : 0;
+    #endif
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "Osl|d", &zobj, hiredis_ce, &ip, &ip_len, &port, &timeout_s) == FAILURE) {
+        RETURN_FALSE;
+    }
+    client = Z_HIREDIS_P(zobj);
+    PHP_HIREDIS_ENSURE_IDLE(client);
+    _hiredis_conn_deinit(client);
+    if (timeout_s >= 0) {
+        client->timeout_us = (long)(timeout_s * 1000 * 1000);
+    }
+    if (!(client->ctx = redisConnect(ip, port))) {
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "redisConnect returned NULL");
+        RETVAL_FALSE;
+    } else if (client->ctx->err) {
+        PHP_HIREDIS_SET_ERROR(client);
+        RETVAL_FALSE;
+    } else {
+        RETVAL_BOOL(REDIS_OK == _hiredis_conn_init(client));
+    }
+    #ifdef HAVE_HIREDIS_USDT
+        if (probe_start) {
+            PHP_HIREDIS_PROBE5(connect, ip, (int)port, zend_is_true(return_value),
+                _hiredis_probe_now_ns() - probe_start, client->ctx && !client->ctx->err ? client->ctx->fd : -1);
+        }
+    #endif
+}
+/* }}} */
+
+/* {{{ proto bool hiredis_connect_unix(string path)
+   Connect to a server via Unix socket. */
+PHP_FUNCTION(hiredis_connect_unix) {
+    zval* zobj;
+    hiredis_t* client;
+    char* path;
+    strlen_t path_len;
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "Os", &zobj, hiredis_ce, &path, &path_len) == FAILURE) {
+        RETURN_FALSE;
+    }
+    client = Z_HIREDIS_P(zobj);
+    PHP_HIREDIS_ENSURE_IDLE(client);
+    _hiredis_conn_deinit(client);
+    if (!(client->ctx = redisConnectUnix(path))) {
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "redisConnectUnix returned NULL");
+        RETURN_FALSE;
+    } else if (client->ctx->err) {
+        PHP_HIREDIS_SET_ERROR(client);
+        RETURN_FALSE;
+    }
+    if (REDIS_OK != _hiredis_conn_init(client)) {
+        RETURN_FALSE;
+    }
+    RETURN_TRUE;
+}
+/* }}} */
+
+#if PHP_MAJOR_VERSION >= 7
+/* {{{ proto bool hiredis_connect_sentinel(string master_name, array sentinels [, float timeout_s [, bool replica]])
+   Connect to the current master of master_name, or to a healthy replica if
+   replica is set, as reported by the sentinels ("host:port" strings). The
+   topology is cached across requests, so a normal connect is a single
+   connect to the right node. */
+PHP_FUNCTION(hiredis_connect_sentinel) {
+    zval* zobj;
+    hiredis_t* client;
+    char* name;
+    strlen_t name_len;
+    zval* sentinels;
+    double timeout_s = -1;
+    zend_bool replica = 0;
+    zval topo;
+    char errstr[128];
+    const char* p;
+    int cached, nodes, idx;
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "Osa|db", &zobj, hiredis_ce, &name, &name_len, &sentinels, &timeout_s, &replica) == FAILURE) {
+        RETURN_FALSE;
+    }
+    client = Z_HIREDIS_P(zobj);
+    PHP_HIREDIS_ENSURE_IDLE(client);
+    _hiredis_conn_deinit(client);
+    if (timeout_s >= 0) {
+        client->timeout_us = (long)(timeout_s * 1000 * 1000);
+    }
+
+    cached = _hiredis_sentinel_cache_get(name, name_len, &topo);
+    for (;;) {
+        if (!cached) {
+            if (REDIS_OK != _hiredis_sentinel_resolve(Z_ARRVAL_P(sentinels), name, name_len, client->timeout_us, &topo, errstr, sizeof(errstr))) {
+                _hiredis_sentinel_cache_del(name, name_len);
+                PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, errstr);
+                RETURN_FALSE;
+            }
+            _hiredis_sentinel_cache_put(name, name_len, &topo);
+        }
+        idx = 0;
+        if (replica) {
+            for (nodes = 1, p = Z_STRVAL(topo); (p = memchr(p, '\n', Z_STRVAL(topo) + Z_STRLEN(topo) - p)); p++) {
+                nodes++;
+            }
+            if (nodes > 1) {
+                idx = 1 + (int)((_hiredis_now_ms() ^ (uint64_t)getpid()) % (nodes - 1));
+            }
+        }
+        if (REDIS_OK == _hiredis_sentinel_connect(client, &topo, idx)) {
+            break;
+        }
+        zval_ptr_dtor(&topo);
+        if (!cached) {
+            _hiredis_sentinel_cache_del(name, name_len);
+            PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "Cannot connect to the node reported by Sentinel");
+            RETURN_FALSE;
+        }
+        // The cached node is gone; ask the sentinels again
+        _hiredis_sentinel_cache_del(name, name_len);
+        cached = 0;
+    }
+    zval_ptr_dtor(&topo);
+
+    client->sentinel_name = estrndup(name, name_len);
+    client->sentinel_name_len = name_len;
+    #ifdef PHP_HIREDIS_BG_READER
+        if (HIREDIS_G(sentinel_watch)) {
+            _hiredis_sentinel_watch(name, name_len, Z_ARRVAL_P(sentinels));
+        }
+    #endif
+    if (REDIS_OK != _hiredis_conn_init(client)) {
+        RETURN_FALSE;
+    }
+    RETURN_TRUE;
+}
+/* }}} */
+#endif
+
+#ifdef PHP_HIREDIS_TLS
+/* {{{ proto bool hiredis_connect_tls(string host, int port [, array options [, float timeout_s]])
+   Connect to a server over TLS. Options: ca_file, ca_path, cert, key,
+   verify (true) and server_name (host), which is sent as SNI and checked
+   against the certificate. Sessions are resumed across connections in the
+   same worker. */
+PHP_FUNCTION(hiredis_connect_tls) {
+    zval* zobj;
+    hiredis_t* client;
+    char* host;
+    strlen_t host_len;
+    zend_long port;
+    zval* options = NULL;
+    zval* zv;
+    double timeout_s = -1;
+    const char* opt[5] = { NULL, NULL, NULL, NULL, NULL };
+    static const char* opt_names[5] = { "ca_file", "ca_path", "cert", "key", "server_name" };
+    const char* errstr;
+    int verify = 1;
+    int i;
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "Osl|a!d", &zobj, hiredis_ce, &host, &host_len, &port, &options, &timeout_s) == FAILURE) {
+        RETURN_FALSE;
+    }
+    client = Z_HIREDIS_P(zobj);
+    PHP_HIREDIS_ENSURE_IDLE(client);
+    _hiredis_conn_deinit(client);
+    if (client->bg_enabled) {
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "Background reader cannot be used over TLS");
+        RETURN_FALSE;
+    }
+    if (options) {
+        for (i = 0; i < 5; i++) {
+            if ((zv = zend_hash_str_find(Z_ARRVAL_P(options), opt_names[i], strlen(opt_names[i]))) && Z_TYPE_P(zv) == IS_STRING) {
+                opt[i] = Z_STRVAL_P(zv);
+            }
+        }
+        if ((zv = zend_hash_str_find(Z_ARRVAL_P(options), "verify", sizeof("verify")-1))) {
+            verify = zend_is_true(zv);
+        }
+    }
+    if (timeout_s >= 0) {
+        client->timeout_us = (long)(timeout_s * 1000 * 1000);
+    }
+    if (!(client->tls_ctx = _hiredis_tls_ctx_get(opt[0], opt[1], opt[2], opt[3], verify, &errstr))) {
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, errstr);
+        RETURN_FALSE;
+    }
+    client->tls_verify = verify;
+    client->tls_name = estrdup(opt[4] ? opt[4] : host);
+    spprintf(&client->tls_key, 0, "%s:" ZEND_LONG_FMT "/%s/%p", host, port, client->tls_name, (void*)client->tls_ctx);
+
+    if (!(client->ctx = redisConnect(host, (int)port))) {
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "redisConnect returned NULL");
+        RETURN_FALSE;
+    } else if (client->ctx->err) {
+        PHP_HIREDIS_SET_ERROR(client);
+        RETURN_FALSE;
+    }
+    // Bound the handshake by the timeout too
+    if (client->timeout_us >= 0 && REDIS_OK != _hiredis_set_timeout(client, client->timeout_us)) {
+        RETURN_FALSE;
+    }
+    if (REDIS_OK != _hiredis_tls_handshake(client)) {
+        PHP_HIREDIS_SET_ERROR(client);
+        RETURN_FALSE;
+    }
+    if (REDIS_OK != _hiredis_conn_init(client)) {
+        RETURN_FALSE;
+    }
+    RETURN_TRUE;
+}
+/* }}} */
+#endif
+
+/* {{{ proto bool hiredis_reconnect()
+   Reonnect to a server. */
+#ifdef HAVE_HIREDIS_RECONNECT
+PHP_FUNCTION(hiredis_reconnect) {
+    zval* zobj;
+    hiredis_t* client;
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "O", &zobj, hiredis_ce) == FAILURE) {
+        RETURN_FALSE;
+    }
+    client = Z_HIREDIS_P(zobj);
+    PHP_HIREDIS_ENSURE_CTX(client);
+    _hiredis_pipeline_flush(client);
+    if (REDIS_OK != _hiredis_reconnect(client)) {
+        RETURN_FALSE;
+    }
+    RETURN_TRUE;
+}
+#endif
+/* }}} */
+
+/* {{{ proto bool hiredis_set_timeout(int timeout_us)
+   Set read/write timeout in microseconds. */
+PHP_FUNCTION(hiredis_set_timeout) {
+    zval* zobj;
+    hiredis_t* client;
+    long timeout_us;
+    struct timeval timeout_tv;
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "Ol", &zobj, hiredis_ce, &timeout_us) == FAILURE) {
+        RETURN_FALSE;
+    }
+    client = Z_HIREDIS_P(zobj);
+    client->timeout_us = timeout_us;
+    if (!client->ctx) {
+        RETURN_TRUE;
+    }
+    if (REDIS_OK != _hiredis_set_timeout(client, timeout_us)) {
+        RETURN_FALSE;
+    }
+    RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto int hiredis_get_timeout()
+   Get read/write timeout in microseconds. */
+PHP_FUNCTION(hiredis_get_timeout) {
+    zval* zobj;
+    hiredis_t* client;
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "O", &zobj, hiredis_ce) == FAILURE) {
+        RETURN_FALSE;
+    }
+    client = Z_HIREDIS_P(zobj);
+    RETURN_LONG(client->timeout_us);
+}
+/* }}} */
+
+/* {{{ proto bool hiredis_set_keep_alive_int(int keep_alive_int_s)
+   Set keep alive interval in seconds. */
+PHP_FUNCTION(hiredis_set_keep_alive_int) {
+    zval* zobj;
+    hiredis_t* client;
+    long keep_alive_int_s;
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "Ol", &zobj, hiredis_ce, &keep_alive_int_s) == FAILURE) {
+        RETURN_FALSE;
+    }
+    client = Z_HIREDIS_P(zobj);
+    client->keep_alive_int_s = keep_alive_int_s;
+    if (!client->ctx) {
+        RETURN_TRUE;
+    }
+    if (REDIS_OK != _hiredis_set_keep_alive_int(client, keep_alive_int_s)) {
+        RETURN_FALSE;
+    }
+    RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto int hiredis_get_keep_alive_int()
+   Get keep alive interval in seconds.*/
+PHP_FUNCTION(hiredis_get_keep_alive_int) {
+    zval* zobj;
+    hiredis_t* client;
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "O", &zobj, hiredis_ce) == FAILURE) {
+        RETURN_FALSE;
+    }
+    client = Z_HIREDIS_P(zobj);
+    RETURN_LONG(client->keep_alive_int_s);
+}
+/* }}} */
+
+/* {{{ proto bool hiredis_set_max_read_buf(int max_bytes)
+   Set max read buffer in bytes. */
+PHP_FUNCTION(hiredis_set_max_read_buf) {
+    zval* zobj;
+    hiredis_t* client;
+    long max_bytes;
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "Ol", &zobj, hiredis_ce, &max_bytes) == FAILURE) {
+        RETURN_FALSE;
+    }
+    client = Z_HIREDIS_P(zobj);
+    client->max_read_buf = max_bytes;
+    if (client->ctx) {
+        client->ctx->reader->maxbuf = max_bytes;
+    }
+    RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto int hiredis_get_max_read_buf()
+   Get max read buffer in bytes. */
+PHP_FUNCTION(hiredis_get_max_read_buf) {
+    zval* zobj;
+    hiredis_t* client;
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "O", &zobj, hiredis_ce) == FAILURE) {
+        RETURN_FALSE;
+    }
+    client = Z_HIREDIS_P(zobj);
+    RETURN_LONG(client->max_read_buf);
+}
+/* }}} */
+
+/* {{{ proto bool hiredis_set_throw_exceptions(bool on_off)
+   Set whether to throw exceptions on ERR replies from server. */
+PHP_FUNCTION(hiredis_set_throw_exceptions) {
+    zval* zobj;
+    hiredis_t* client;
+    zend_bool on_off;
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "Ob", &zobj, hiredis_ce, &on_off) == FAILURE) {
+        RETURN_FALSE;
+    }
+    client = Z_HIREDIS_P(zobj);
+    client->throw_exceptions = on_off ? 1 : 0;
+    RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto bool hiredis_get_throw_exceptions()
+   Get whether throw_exceptions is enabled. */
+PHP_FUNCTION(hiredis_get_throw_exceptions) {
+    zval* zobj;
+    hiredis_t* client;
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "O", &zobj, hiredis_ce) == FAILURE) {
+        RETURN_FALSE;
+    }
+    client = Z_HIREDIS_P(zobj);
+    RETURN_BOOL(client->throw_exceptions);
+}
+/* }}} */
+
+#if PHP_MAJOR_VERSION >= 7
+/* {{{ proto bool hiredis_set_auto_pipeline(bool on_off)
+   Set whether commands are queued and return HiredisFuture objects. */
+PHP_FUNCTION(hiredis_set_auto_pipeline) {
+    zval* zobj;
+    hiredis_t* client;
+    zend_bool on_off;
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "Ob", &zobj, hiredis_ce, &on_off) == FAILURE) {
+        RETURN_FALSE;
+    }
+    client = Z_HIREDIS_P(zobj);
+    if (!on_off && client->ctx && REDIS_OK != _hiredis_pipeline_flush(client)) {
+        RETURN_FALSE;
+    }
+    client->auto_pipeline = on_off ? 1 : 0;
+    RETURN_TRUE;
+}
+/* }}} */
+
+#ifdef PHP_HIREDIS_BG_READER
+/* {{{ proto bool hiredis_set_background_reader(bool on_off)
+   Read and parse appendRaw replies on a helper thread. */
+PHP_FUNCTION(hiredis_set_background_reader) {
+    zval* zobj;
+    hiredis_t* client;
+    zend_bool on_off;
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "Ob", &zobj, hiredis_ce, &on_off) == FAILURE) {
+        RETURN_FALSE;
+    }
+    client = Z_HIREDIS_P(zobj);
+    if (client->raw_pending > 0) {
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "Cannot switch background reader with replies pending");
+        RETURN_FALSE;
+    }
+    if (on_off && client->hedge) {
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "Background reader cannot be used with hedging");
+        RETURN_FALSE;
+    }
+    #if PHP_VERSION_ID >= 80100
+        if (on_off && Z_TYPE(client->fiber_scheduler) != IS_UNDEF) {
+            PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "Background reader cannot be used with a fiber scheduler");
+            RETURN_FALSE;
+        }
+    #endif
+    if (!on_off) {
+        _hiredis_bg_free(client);
+    }
+    client->bg_enabled = on_off ? 1 : 0;
+    RETURN_TRUE;
+}
+/* }}} */
+#endif
+
+#if PHP_MAJOR_VERSION >= 7
+/* {{{ proto bool hiredis_set_hedging(?array replicas [, array options])
+   Hedge read-only commands to the replicas ("host:port" strings) when the
+   primary is slow. Options: delay_us (fixed delay; default is adaptive),
+   percentile (95), min_samples (100, before adapting), min_delay_us
+   (1000), budget (0.05 hedges per read at most). null turns it off. */
+PHP_FUNCTION(hiredis_set_hedging) {
+    zval* zobj;
+    hiredis_t* client;
+    hiredis_hedge_t* h;
+    zval* replicas;
+    zval* options = NULL;
+    zval* zv;
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "Oa!|a", &zobj, hiredis_ce, &replicas, &options) == FAILURE) {
+        RETURN_FALSE;
+    }
+    client = Z_HIREDIS_P(zobj);
+    if (client->bg_enabled) {
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "Hedging cannot be used with the background reader");
+        RETURN_FALSE;
+    }
+    if (client->ctx && REDIS_OK != PHP_HIREDIS_HEDGE_SETTLE(client)) {
+        PHP_HIREDIS_SET_ERROR(client);
+        RETURN_FALSE;
+    }
+    _hiredis_hedge_free(client);
+    if (!replicas || zend_hash_num_elements(Z_ARRVAL_P(replicas)) == 0) {
+        RETURN_TRUE;
+    }
+
+    h = ecalloc(1, sizeof(hiredis_hedge_t));
+    ZVAL_UNDEF(&h->root[0]);
+    ZVAL_UNDEF(&h->root[1]);
+    h->percentile = 95;
+    h->min_samples = 100;
+    h->min_delay_us = 1000;
+    h->budget = 0.05;
+    h->tokens = 1;
+    zend_hash_init(&h->hists, 16, NULL, _hiredis_hedge_hist_dtor, 0);
+    h->addrs = safe_emalloc(zend_hash_num_elements(Z_ARRVAL_P(replicas)), sizeof(char*), 0);
+    ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(replicas), zv) {
+        if (Z_TYPE_P(zv) == IS_STRING) {
+            h->addrs[h->naddrs++] = estrndup(Z_STRVAL_P(zv), Z_STRLEN_P(zv));
+        }
+    } ZEND_HASH_FOREACH_END();
+    if (options) {
+        if ((zv = zend_hash_str_find(Z_ARRVAL_P(options), "delay_us", sizeof("delay_us")-1))) {
+            h->delay_us = MAX(zval_get_long(zv), 0);
+        }
+        if ((zv = zend_hash_str_find(Z_ARRVAL_P(options), "percentile", sizeof("percentile")-1))) {
+            h->percentile = MIN(MAX(zval_get_long(zv), 1), 100);
+        }
+        if ((zv = zend_hash_str_find(Z_ARRVAL_P(options), "min_samples", sizeof("min_samples")-1))) {
+            h->min_samples = MAX(zval_get_long(zv), 1);
+        }
+        if ((zv = zend_hash_str_find(Z_ARRVAL_P(options), "min_delay_us", sizeof("min_delay_us")-1))) {
+            h->min_delay_us = MAX(zval_get_long(zv), 0);
+        }
+        if ((zv = zend_hash_str_find(Z_ARRVAL_P(options), "budget", sizeof("budget")-1))) {
+            h->budget = MAX(zval_get_double(zv), 0);
+        }
+    }
+    client->hedge = h;
+    if (client->ctx) {
+        // Connect now so the first slow read can already be hedged
+        _hiredis_hedge_connect(client);
+    }
+    RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto array hiredis_get_hedge_stats()
+   Return hedging counters and the current delay per command. */
+PHP_FUNCTION(hiredis_get_hedge_stats) {
+    zval* zobj;
+    hiredis_t* client;
+    hiredis_hedge_t* h;
+    hiredis_hedge_hist_t* hist;
+    zend_string* cmd;
+    zval delays;
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "O", &zobj, hiredis_ce) == FAILURE) {
+        RETURN_FALSE;
+    }
+    client = Z_HIREDIS_P(zobj);
+    if (!(h = client->hedge)) {
+        RETURN_FALSE;
+    }
+    array_init(return_value);
+    add_assoc_long(return_value, "hedged", h->hedged);
+    add_assoc_long(return_value, "won", h->won);
+    add_assoc_long(return_value, "over_budget", h->over_budget);
+    array_init(&delays);
+    ZEND_HASH_FOREACH_STR_KEY_PTR(&h->hists, cmd, hist) {
+        add_assoc_long_ex(&delays, ZSTR_VAL(cmd), ZSTR_LEN(cmd), (zend_long)_hiredis_hedge_delay(h, hist));
+    } ZEND_HASH_FOREACH_END();
+    add_assoc_zval(return_value, "delay_us", &delays);
+}
+/* }}} */
+#endif
+
+#if PHP_MAJOR_VERSION >= 7
+#ifdef PHP_HIREDIS_HEALTH
+/* {{{ proto bool hiredis_set_health_check(int idle_ms)
+   Check whether the connection is still open before the first command
+   after idle_ms without one, and reconnect if it is not. 0 disables the
+   check. Defaults to hiredis.health_idle_ms. */
+PHP_FUNCTION(hiredis_set_health_check) {
+    zval* zobj;
+    hiredis_t* client;
+    zend_long idle_ms;
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "Ol", &zobj, hiredis_ce, &idle_ms) == FAILURE) {
+        RETURN_FALSE;
+    }
+    client = Z_HIREDIS_P(zobj);
+    client->health_idle_ms = idle_ms > 0 ? (long)idle_ms : 0;
+    RETURN_TRUE;
+}
+/* }}} */
+#endif
+
+/* {{{ proto bool hiredis_set_decode_hint(string command, ?string hint)
+   Decode replies to command in C: "numeric" (numeric bulk strings become
+   int/float), "double", "map" (flat pairs become key => value),
+   "map_numeric", "scores" (member => float, for WITHSCORES) or "info"
+   (nested array). null or "none" removes the hint. Hints apply to
+   synchronous calls only, not to auto_pipeline futures or appendRaw. */
+PHP_FUNCTION(hiredis_set_decode_hint) {
+    zval* zobj;
+    hiredis_t* client;
+    char* cmd;
+    strlen_t cmd_len;
+    char* name = NULL;
+    strlen_t name_len = 0;
+    zend_string* key;
+    zval tmp;
+    long hint = 0;
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "Oss!", &zobj, hiredis_ce, &cmd, &cmd_len, &name, &name_len) == FAILURE) {
+        RETURN_FALSE;
+    }
+    client = Z_HIREDIS_P(zobj);
+    if (name && (hint = _hiredis_decode_hint_parse(name, name_len)) < 0) {
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "Unknown decode hint");
+        RETURN_FALSE;
+    }
+    key = zend_string_init(cmd, cmd_len, 0);
+    php_strtoupper(ZSTR_VAL(key), ZSTR_LEN(key));
+    if (hint) {
+        if (!client->decode_hints) {
+            ALLOC_HASHTABLE(client->decode_hints);
+            zend_hash_init(client->decode_hints, 8, NULL, NULL, 0);
+        }
+        ZVAL_LONG(&tmp, hint);
+        zend_hash_update(client->decode_hints, key, &tmp);
+    } else if (client->decode_hints) {
+        zend_hash_del(client->decode_hints, key);
+    }
+    zend_string_release(key);
+    RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto bool hiredis_decode_next(string hint)
+   Use a decode hint for the next command only, overriding the one set for
+   its name. */
+PHP_FUNCTION(hiredis_decode_next) {
+    zval* zobj;
+    hiredis_t* client;
+    char* name;
+    strlen_t name_len;
+    long hint;
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "Os", &zobj, hiredis_ce, &name, &name_len) == FAILURE) {
+        RETURN_FALSE;
+    }
+    client = Z_HIREDIS_P(zobj);
+    if ((hint = _hiredis_decode_hint_parse(name, name_len)) < 0) {
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "Unknown decode hint");
+        RETURN_FALSE;
+    }
+    client->decode_next = hint;
+    RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto bool hiredis_set_lazy_replies(int min_elements)
+   Return array replies of at least min_elements elements from sendRaw and
+   sendRawArray as HiredisLazyReply objects. Pass 0 to turn this off. */
+PHP_FUNCTION(hiredis_set_lazy_replies) {
+    zval* zobj;
+    hiredis_t* client;
+    zend_long min_elements;
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "Ol", &zobj, hiredis_ce, &min_elements) == FAILURE) {
+        RETURN_FALSE;
+    }
+    client = Z_HIREDIS_P(zobj);
+    client->lazy_min = min_elements > 0 ? (long)min_elements : 0;
+    RETURN_TRUE;
+}
+/* }}} */
+#endif
+
+/* {{{ proto bool hiredis_get_auto_pipeline()
+   Get whether auto_pipeline is enabled. */
+PHP_FUNCTION(hiredis_get_auto_pipeline) {
+    zval* zobj;
+    hiredis_t* client;
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "O", &zobj, hiredis_ce) == FAILURE) {
+        RETURN_FALSE;
+    }
+    client = Z_HIREDIS_P(zobj);
+    RETURN_BOOL(client->auto_pipeline);
+}
+/* }}} */
+
+#if PHP_VERSION_ID >= 80100
+/* {{{ proto bool hiredis_set_fiber_scheduler(?callable scheduler)
+   Make waits inside a Fiber suspend it. The scheduler is called as
+   scheduler(resource $stream, bool $writable, Fiber $fiber) and must resume
+   $fiber once $stream is ready. Pass null to go back to blocking I/O. */
+PHP_FUNCTION(hiredis_set_fiber_scheduler) {
+    zval* zobj;
+    hiredis_t* client;
+    zval* scheduler;
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "Oz", &zobj, hiredis_ce, &scheduler) == FAILURE) {
+        RETURN_FALSE;
+    }
+    if (Z_TYPE_P(scheduler) != IS_NULL && !zend_is_callable(scheduler, 0, NULL)) {
+        zend_argument_type_error(1, "must be a valid callback or null");
+        RETURN_THROWS();
+    }
+    client = Z_HIREDIS_P(zobj);
+    PHP_HIREDIS_ENSURE_IDLE(client);
+    zval_ptr_dtor(&client->fiber_scheduler);
+    ZVAL_UNDEF(&client->fiber_scheduler);
+    if (Z_TYPE_P(scheduler) != IS_NULL) {
+        ZVAL_COPY(&client->fiber_scheduler, scheduler);
+    }
+    if (!client->ctx) {
+        RETURN_TRUE;
+    }
+    if (REDIS_OK != _hiredis_io_set_blocking(client, Z_TYPE_P(scheduler) == IS_NULL)) {
+        PHP_HIREDIS_SET_ERROR(client);
+        RETURN_FALSE;
+    }
+    #ifdef HAVE_HIREDIS_URING
+        client->io_uring = Z_TYPE_P(scheduler) == IS_NULL && HIREDIS_G(use_uring) && !PHP_HIREDIS_IS_TLS(client) && _hiredis_uring_get() != NULL;
+    #endif
+    RETURN_TRUE;
+}
+/* }}} */
+#endif
+
+/* {{{ proto bool hiredis_flush()
+   Send queued commands and resolve their futures. */
+PHP_FUNCTION(hiredis_flush) {
+    zval* zobj;
+    hiredis_t* client;
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "O", &zobj, hiredis_ce) == FAILURE) {
+        RETURN_FALSE;
+    }
+    client = Z_HIREDIS_P(zobj);
+    PHP_HIREDIS_ENSURE_CTX(client);
+    if (REDIS_OK != _hiredis_pipeline_flush(client)) {
+        RETURN_FALSE;
+    }
+    RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto mixed HiredisFuture::get()
+   Return reply, flushing the pipeline if it has not been read yet. */
+PHP_METHOD(HiredisFuture, get) {
+    hiredis_future_t* future;
+    hiredis_t* client;
+    if (zend_parse_parameters_none() == FAILURE) {
+        return;
+    }
+    future = Z_HIREDIS_FUTURE_P(getThis());
+    if (Z_TYPE(future->client) != IS_OBJECT) {
+        RETURN_FALSE;
+    }
+    client = Z_HIREDIS_P(&future->client);
+    if (future->state == PHP_HIREDIS_FUTURE_PENDING) {
+        PHP_HIREDIS_ENSURE_IDLE(client);
+        if (REDIS_OK != _hiredis_pipeline_flush(client) || EG(exception)) {
+            RETURN_FALSE;
+        }
+    }
+    if (future->state == PHP_HIREDIS_FUTURE_FAILED) {
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, Z_STRVAL(future->value));
+        RETURN_FALSE;
+    }
+    RETURN_ZVAL(&future->value, 1, 0);
+}
+/* }}} */
+
+/* {{{ proto void HiredisStreamArg::__construct(resource stream [, int length])
+   Wrap a stream to be sent as a command arg. Without a length the stream
+   must be a regular file and is sent from its current position to EOF. */
+PHP_METHOD(HiredisStreamArg, __construct) {
+    hiredis_stream_arg_t* arg;
+    zval* zstream;
+    zend_long length = -1;
+    zend_bool length_null = 1;
+    php_stream* stream;
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "r|l!", &zstream, &length, &length_null) == FAILURE) {
+        return;
+    }
+    php_stream_from_zval(stream, zstream);
+    (void)stream;
+    arg = Z_HIREDIS_STREAM_ARG_P(getThis());
+    zval_ptr_dtor(&arg->stream);
+    ZVAL_COPY(&arg->stream, zstream);
+    arg->length = length_null || length < 0 ? -1 : length;
+}
+/* }}} */
+
+/* {{{ proto bool HiredisFuture::isReady()
+   Return whether the reply has been read. */
+PHP_METHOD(HiredisFuture, isReady) {
+    hiredis_future_t* future;
+    if (zend_parse_parameters_none() == FAILURE) {
+        return;
+    }
+    future = Z_HIREDIS_FUTURE_P(getThis());
+    RETURN_BOOL(future->state != PHP_HIREDIS_FUTURE_PENDING);
+}
+/* }}} */
+#endif
+
+/* {{{ proto mixed HiredisLazyReply::offsetGet(int offset)
+   Return an element, decoding it on first access. */
+PHP_METHOD(HiredisLazyReply, offsetGet) {
+    zval* offset;
+    zval* zv;
+    zend_long idx;
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "z", &offset) == FAILURE) {
+        return;
+    }
+    if (!_hiredis_lazy_reply_index(offset, &idx)
+        || !(zv = _hiredis_lazy_reply_get(Z_HIREDIS_LAZY_REPLY_P(getThis()), idx))
+    ) {
+        RETURN_NULL();
+    }
+    RETURN_ZVAL(zv, 1, 0);
+}
+/* }}} */
+
+/* {{{ proto bool HiredisLazyReply::offsetExists(int offset)
+   Return whether an element exists and is not nil. */
+PHP_METHOD(HiredisLazyReply, offsetExists) {
+    zval* offset;
+    zval* zv;
+    zend_long idx;
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "z", &offset) == FAILURE) {
+        return;
+    }
+    if (!_hiredis_lazy_reply_index(offset, &idx)
+        || !(zv = _hiredis_lazy_reply_get(Z_HIREDIS_LAZY_REPLY_P(getThis()), idx))
+    ) {
+        RETURN_FALSE;
+    }
+    RETURN_BOOL(Z_TYPE_P(zv) != IS_NULL);
+}
+/* }}} */
+
+/* {{{ proto void HiredisLazyReply::offsetSet(mixed offset, mixed value)
+   Replies are read-only; always throws. */
+PHP_METHOD(HiredisLazyReply, offsetSet) {
+    zval* offset;
+    zval* value;
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "zz", &offset, &value) == FAILURE) {
+        return;
+    }
+    zend_throw_exception(hiredis_exception_ce, "HiredisLazyReply is read-only", 0);
+}
+/* }}} */
+
+/* {{{ proto void HiredisLazyReply::offsetUnset(mixed offset)
+   Replies are read-only; always throws. */
+PHP_METHOD(HiredisLazyReply, offsetUnset) {
+    zval* offset;
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "z", &offset) == FAILURE) {
+        return;
+    }
+    zend_throw_exception(hiredis_exception_ce, "HiredisLazyReply is read-only", 0);
+}
+/* }}} */
+
+/* {{{ proto int HiredisLazyReply::count()
+   Return the number of elements. */
+PHP_METHOD(HiredisLazyReply, count) {
+    if (zend_parse_parameters_none() == FAILURE) {
+        return;
+    }
+    RETURN_LONG(Z_HIREDIS_LAZY_REPLY_P(getThis())->count);
+}
+/* }}} */
+
+/* {{{ proto array HiredisLazyReply::toArray()
+   Decode every element and return the reply as a plain array. */
+PHP_METHOD(HiredisLazyReply, toArray) {
+    hiredis_lazy_reply_t* lr;
+    zval* zv;
+    uint32_t i;
+    if (zend_parse_parameters_none() == FAILURE) {
+        return;
+    }
+    lr = Z_HIREDIS_LAZY_REPLY_P(getThis());
+    array_init_size(return_value, lr->count);
+    zend_hash_real_init(Z_ARRVAL_P(return_value), 1);
+    for (i = 0; i < lr->count; i++) {
+        zv = _hiredis_lazy_reply_get(lr, i);
+        Z_TRY_ADDREF_P(zv);
+        _hiredis_array_append(Z_ARRVAL_P(return_value), i, zv);
+    }
+}
+/* }}} */
+
+/* {{{ proto Iterator HiredisLazyReply::getIterator()
+   Return an iterator over the elements. foreach does not need this and
+   iterates the reply directly. */
+PHP_METHOD(HiredisLazyReply, getIterator) {
+    if (zend_parse_parameters_none() == FAILURE) {
+        return;
+    }
+    #if PHP_MAJOR_VERSION >= 8
+        zend_create_internal_iterator_zval(return_value, getThis());
+    #else
+        {
+            zval arr;
+            zend_call_method_with_0_params(getThis(), hiredis_lazy_reply_ce, NULL, "toarray", &arr);
+            object_init_ex(return_value, spl_ce_ArrayIterator);
+            zend_call_method_with_1_params(return_value, spl_ce_ArrayIterator, &spl_ce_ArrayIterator->constructor, "__construct", NULL, &arr);
+            zval_ptr_dtor(&arr);
+        }
+    #endif
+}
+/* }}} */
+
+/* Fetch hiredis_stream_consumer_t inside zval */
+static inline hiredis_stream_consumer_t* hiredis_stream_consumer_obj_fetch(zend_object* obj) {
+    return (hiredis_stream_consumer_t*)((char*)(obj) - XtOffsetOf(hiredis_stream_consumer_t, std));
+}
+
+/* Allocate/deallocate hiredis_stream_consumer_t object */
+static void hiredis_stream_consumer_obj_free(zend_object *object) {
+    hiredis_stream_consumer_t* sc;
+    sc = hiredis_stream_consumer_obj_fetch(object);
+    zval_ptr_dtor(&sc->client);
+    zval_ptr_dtor(&sc->acks);
+    if (sc->stream) {
+        zend_string_release(sc->stream);
+    }
+    if (sc->group) {
+        zend_string_release(sc->group);
+    }
+    if (sc->consumer) {
+        zend_string_release(sc->consumer);
+    }
+    if (sc->claim_cursor) {
+        zend_string_release(sc->claim_cursor);
+    }
+    zend_object_std_dtor(&sc->std);
+}
+static inline zend_object* hiredis_stream_consumer_obj_new(zend_class_entry *ce) {
+    hiredis_stream_consumer_t* sc;
+    sc = ecalloc(1, sizeof(hiredis_stream_consumer_t) + zend_object_properties_size(ce));
+    ZVAL_UNDEF(&sc->client);
+    array_init(&sc->acks);
+    sc->count = 100;
+    sc->block_ms = -1;
+    sc->auto_ack = 1;
+    zend_object_std_init(&sc->std, ce);
+    object_properties_init(&sc->std, ce);
+    sc->std.handlers = &hiredis_stream_consumer_obj_handlers;
+    return &sc->std;
+}
+
+/* Add stream entries [[id, [field, value, ...]], ...] from src to dest as
+   id => [field => value, ...]. Entries deleted since they were delivered
+   come back with nil fields and map to null. Ids are also appended to
+   ids when given. Strings are shared with src, not copied. */
+static void _hiredis_stream_entries(zval* src, zval* dest, zval* ids) {
+    zval* entry;
+    zval* zid;
+    zval* zfields;
+    zval* f;
+    zval* v;
+    zval fields;
+    uint32_t i, n;
+    if (Z_TYPE_P(src) != IS_ARRAY) {
+        return;
+    }
+    ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(src), entry) {
+        if (Z_TYPE_P(entry) != IS_ARRAY
+            || !(zid = zend_hash_index_find(Z_ARRVAL_P(entry), 0))
+            || Z_TYPE_P(zid) != IS_STRING
+        ) {
+            continue;
+        }
+        zfields = zend_hash_index_find(Z_ARRVAL_P(entry), 1);
+        if (zfields && Z_TYPE_P(zfields) == IS_ARRAY) {
+            n = zend_hash_num_elements(Z_ARRVAL_P(zfields));
+            array_init_size(&fields, n / 2);
+            for (i = 0; i + 1 < n; i += 2) {
+                f = zend_hash_index_find(Z_ARRVAL_P(zfields), i);
+                v = zend_hash_index_find(Z_ARRVAL_P(zfields), i + 1);
+                if (f && v && Z_TYPE_P(f) == IS_STRING) {
+                    Z_TRY_ADDREF_P(v);
+                    zend_symtable_update(Z_ARRVAL(fields), Z_STR_P(f), v);
+                }
+            }
+        } else {
+            ZVAL_NULL(&fields);
+        }
+        zend_hash_update(Z_ARRVAL_P(dest), Z_STR_P(zid), &fields);
+        if (ids) {
+            Z_TRY_ADDREF_P(zid);
+            add_next_index_zval(ids, zid);
+        }
+    } ZEND_HASH_FOREACH_END();
+}
+
+/* Return the client of a consumer with its pipeline flushed, or NULL with
+   the error set */
+static hiredis_t* _hiredis_consumer_client(hiredis_stream_consumer_t* sc) {
+    hiredis_t* client;
+    if (Z_TYPE(sc->client) != IS_OBJECT) {
+        zend_throw_exception(hiredis_exception_ce, "HiredisStreamConsumer is not initialized", 0);
+        return NULL;
+    }
+    client = Z_HIREDIS_P(&sc->client);
+    if (!client->ctx) {
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "No redisContext");
+        return NULL;
+    }
+    if (client->raw_pending > 0) {
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "Cannot use consumer with appendRaw replies pending");
+        return NULL;
+    }
+    if (REDIS_OK != _hiredis_pipeline_flush(client) || REDIS_OK != _hiredis_io_before_send(client)) {
+        return NULL;
+    }
+    return client;
+}
+
+/* Append XACK for the queued ids to the output buffer */
+static int _hiredis_consumer_append_ack(hiredis_t* client, hiredis_stream_consumer_t* sc) {
+    HashTable* ht = Z_ARRVAL(sc->acks);
+    const char** argv;
+    size_t* argvlen;
+    zval* zv;
+    int argc, rc;
+    argc = 3 + zend_hash_num_elements(ht);
+    argv = safe_emalloc(argc, sizeof(char*), 0);
+    argvlen = safe_emalloc(argc, sizeof(size_t), 0);
+    argv[0] = "XACK";
+    argvlen[0] = sizeof("XACK")-1;
+    argv[1] = ZSTR_VAL(sc->stream);
+    argvlen[1] = ZSTR_LEN(sc->stream);
+    argv[2] = ZSTR_VAL(sc->group);
+    argvlen[2] = ZSTR_LEN(sc->group);
+    argc = 3;
+    ZEND_HASH_FOREACH_VAL(ht, zv) {
+        argv[argc] = Z_STRVAL_P(zv);
+        argvlen[argc++] = Z_STRLEN_P(zv);
+    } ZEND_HASH_FOREACH_END();
+    rc = redisAppendCommandArgv(client->ctx, argc, argv, argvlen);
+    efree(argv);
+    efree(argvlen);
+    return rc;
+}
+
+/* Read the XACK reply. On success the ack queue is cleared and the number
+   of acknowledged entries returned; an error reply leaves the queue as is
+   so the ids are sent again next time. With quiet an error reply is only
+   recorded for getLastError and never thrown. */
+static int _hiredis_consumer_read_ack(hiredis_t* client, hiredis_stream_consumer_t* sc, zend_long* acked, int quiet) {
+    zval reply;
+    if (REDIS_OK != _hiredis_io_get_reply(client, &reply)) {
+        PHP_HIREDIS_SET_ERROR(client);
+        return REDIS_ERR;
+    }
+    if (client->reply_is_error && quiet) {
+        client->err = REDIS_ERR;
+        snprintf(client->errstr, sizeof(client->errstr), "%s", Z_STRVAL(reply));
+        zval_ptr_dtor(&reply);
+        return REDIS_ERR;
+    } else if (client->reply_is_error) {
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, Z_STRVAL(reply));
+        zval_ptr_dtor(&reply);
+        return REDIS_ERR;
+    }
+    *acked = Z_TYPE(reply) == IS_LONG ? Z_LVAL(reply) : 0;
+    zval_ptr_dtor(&reply);
+    zend_hash_clean(Z_ARRVAL(sc->acks));
+    return REDIS_OK;
+}
+
+/* Send one command and read its reply into `reply` */
+static int _hiredis_consumer_call(hiredis_t* client, int argc, const char** argv, const size_t* argvlen, zval* reply) {
+    if (REDIS_OK != redisAppendCommandArgv(client->ctx, argc, argv, argvlen)
+        || REDIS_OK != _hiredis_io_get_reply(client, reply)
+    ) {
+        PHP_HIREDIS_SET_ERROR(client);
+        return REDIS_ERR;
+    }
+    return REDIS_OK;
+}
+
+/* {{{ proto void HiredisStreamConsumer::__construct(Hiredis client, string stream, string group, string consumer [, array options])
+   Create a consumer. Options are count (entries per read, default 100),
+   block (ms to block in read, default none) and auto_ack (default true:
+   entries returned by read or claim are acknowledged with the next read). */
+PHP_METHOD(HiredisStreamConsumer, __construct) {
+    hiredis_stream_consumer_t* sc;
+    zval* zclient;
+    zend_string* stream;
+    zend_string* group;
+    zend_string* consumer;
+    zval* options = NULL;
+    zval* zv;
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "OSSS|a", &zclient, hiredis_ce, &stream, &group, &consumer, &options) == FAILURE) {
+        return;
+    }
+    sc = Z_HIREDIS_STREAM_CONSUMER_P(getThis());
+    if (Z_TYPE(sc->client) != IS_UNDEF) {
+        zend_throw_exception(hiredis_exception_ce, "HiredisStreamConsumer is already initialized", 0);
+        return;
+    }
+    ZVAL_COPY(&sc->client, zclient);
+    sc->stream = zend_string_copy(stream);
+    sc->group = zend_string_copy(group);
+    sc->consumer = zend_string_copy(consumer);
+    if (options) {
+        if ((zv = zend_hash_str_find(Z_ARRVAL_P(options), "count", sizeof("count")-1))) {
+            sc->count = zval_get_long(zv);
+        }
+        if ((zv = zend_hash_str_find(Z_ARRVAL_P(options), "block", sizeof("block")-1))) {
+            sc->block_ms = Z_TYPE_P(zv) == IS_NULL ? -1 : zval_get_long(zv);
+        }
+        if ((zv = zend_hash_str_find(Z_ARRVAL_P(options), "auto_ack", sizeof("auto_ack")-1))) {
+            sc->auto_ack = zend_is_true(zv);
+        }
+    }
+}
+/* }}} */
+
+/* {{{ proto bool HiredisStreamConsumer::createGroup([string start_id [, bool mkstream]])
+   Create the consumer group (XGROUP CREATE), by default at '$' and
+   creating the stream. An existing group is not an error. */
+PHP_METHOD(HiredisStreamConsumer, createGroup) {
+    hiredis_stream_consumer_t* sc;
+    hiredis_t* client;
+    char* start = "$";
+    strlen_t start_len = 1;
+    zend_bool mkstream = 1;
+    const char* argv[6];
+    size_t argvlen[6];
+    zval reply;
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "|sb", &start, &start_len, &mkstream) == FAILURE) {
+        return;
+    }
+    sc = Z_HIREDIS_STREAM_CONSUMER_P(getThis());
+    if (!(client = _hiredis_consumer_client(sc))) {
+        RETURN_FALSE;
+    }
+    argv[0] = "XGROUP";
+    argvlen[0] = sizeof("XGROUP")-1;
+    argv[1] = "CREATE";
+    argvlen[1] = sizeof("CREATE")-1;
+    argv[2] = ZSTR_VAL(sc->stream);
+    argvlen[2] = ZSTR_LEN(sc->stream);
+    argv[3] = ZSTR_VAL(sc->group);
+    argvlen[3] = ZSTR_LEN(sc->group);
+    argv[4] = start;
+    argvlen[4] = start_len;
+    argv[5] = "MKSTREAM";
+    argvlen[5] = sizeof("MKSTREAM")-1;
+    if (REDIS_OK != _hiredis_consumer_call(client, mkstream ? 6 : 5, argv, argvlen, &reply)) {
+        RETURN_FALSE;
+    }
+    if (client->reply_is_error && strncmp(Z_STRVAL(reply), "BUSYGROUP", sizeof("BUSYGROUP")-1) != 0) {
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, Z_STRVAL(reply));
+        RETVAL_FALSE;
+    } else {
+        RETVAL_TRUE;
+    }
+    zval_ptr_dtor(&reply);
+}
+/* }}} */
+
+/* {{{ proto array HiredisStreamConsumer::read()
+   Read new entries with XREADGROUP as [id => [field => value, ...]]. Queued
+   acks go out in the same write. An empty array means BLOCK timed out. If
+   the XACK fails the entries are still returned, the ids stay queued and
+   the error is left for getLastError. */
+PHP_METHOD(HiredisStreamConsumer, read) {
+    hiredis_stream_consumer_t* sc;
+    hiredis_t* client;
+    const char* argv[12];
+    size_t argvlen[12];
+    char count_buf[32];
+    char block_buf[32];
+    int argc = 0;
+    int acking;
+    zend_long acked;
+    zval reply;
+    zval* zv;
+    zval* entries;
+    if (zend_parse_parameters_none() == FAILURE) {
+        return;
+    }
+    sc = Z_HIREDIS_STREAM_CONSUMER_P(getThis());
+    if (!(client = _hiredis_consumer_client(sc))) {
+        RETURN_FALSE;
+    }
+
+    // XACK <previous batch> + XREADGROUP in one write
+    acking = zend_hash_num_elements(Z_ARRVAL(sc->acks)) > 0;
+    if (acking && REDIS_OK != _hiredis_consumer_append_ack(client, sc)) {
+        PHP_HIREDIS_SET_ERROR(client);
+        RETURN_FALSE;
+    }
+    #define PHP_HIREDIS_XARG(s, l) do { argv[argc] = (s); argvlen[argc++] = (l); } while (0)
+    PHP_HIREDIS_XARG("XREADGROUP", sizeof("XREADGROUP")-1);
+    PHP_HIREDIS_XARG("GROUP", sizeof("GROUP")-1);
+    PHP_HIREDIS_XARG(ZSTR_VAL(sc->group), ZSTR_LEN(sc->group));
+    PHP_HIREDIS_XARG(ZSTR_VAL(sc->consumer), ZSTR_LEN(sc->consumer));
+    if (sc->count > 0) {
+        PHP_HIREDIS_XARG("COUNT", sizeof("COUNT")-1);
+        PHP_HIREDIS_XARG(count_buf, snprintf(count_buf, sizeof(count_buf), ZEND_LONG_FMT, sc->count));
+    }
+    if (sc->block_ms >= 0) {
+        PHP_HIREDIS_XARG("BLOCK", sizeof("BLOCK")-1);
+        PHP_HIREDIS_XARG(block_buf, snprintf(block_buf, sizeof(block_buf), ZEND_LONG_FMT, sc->block_ms));
+    }
+    PHP_HIREDIS_XARG("STREAMS", sizeof("STREAMS")-1);
+    PHP_HIREDIS_XARG(ZSTR_VAL(sc->stream), ZSTR_LEN(sc->stream));
+    PHP_HIREDIS_XARG(">", 1);
+    #undef PHP_HIREDIS_XARG
+    if (REDIS_OK != redisAppendCommandArgv(client->ctx, argc, argv, argvlen)) {
+        PHP_HIREDIS_SET_ERROR(client);
+        RETURN_FALSE;
+    }
+    // XREADGROUP has already delivered its entries, so a failed XACK must
+    // not throw them away
+    if (acking && REDIS_OK != _hiredis_consumer_read_ack(client, sc, &acked, 1) && client->ctx->err) {
+        RETURN_FALSE;
+    }
+    if (REDIS_OK != _hiredis_io_get_reply(client, &reply)) {
+        PHP_HIREDIS_SET_ERROR(client);
+        RETURN_FALSE;
+    }
+    if (client->reply_is_error) {
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, Z_STRVAL(reply));
+        zval_ptr_dtor(&reply);
+        RETURN_FALSE;
+    }
+
+    // [[stream, entries]], or nil if BLOCK timed out
+    array_init(return_value);
+    if (Z_TYPE(reply) == IS_ARRAY) {
+        ZEND_HASH_FOREACH_VAL(Z_ARRVAL(reply), zv) {
+            if (Z_TYPE_P(zv) == IS_ARRAY && (entries = zend_hash_index_find(Z_ARRVAL_P(zv), 1))) {
+                _hiredis_stream_entries(entries, return_value, sc->auto_ack ? &sc->acks : NULL);
+            }
+        } ZEND_HASH_FOREACH_END();
+    }
+    zval_ptr_dtor(&reply);
+}
+/* }}} */
+
+/* {{{ proto int HiredisStreamConsumer::ack(string id [, string ...])
+   Queue ids to be acknowledged with the next read or flushAcks. Returns
+   the number of queued ids. */
+PHP_METHOD(HiredisStreamConsumer, ack) {
+    hiredis_stream_consumer_t* sc;
+    zval* args;
+    zval tmp;
+    int argc, i;
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "+", &args, &argc) == FAILURE) {
+        return;
+    }
+    sc = Z_HIREDIS_STREAM_CONSUMER_P(getThis());
+    for (i = 0; i < argc; i++) {
+        ZVAL_STR(&tmp, zval_get_string(&args[i]));
+        add_next_index_zval(&sc->acks, &tmp);
+    }
+    RETURN_LONG(zend_hash_num_elements(Z_ARRVAL(sc->acks)));
+}
+/* }}} */
+
+/* {{{ proto int HiredisStreamConsumer::flushAcks()
+   Send queued acks now. Returns the number of entries acknowledged. */
+PHP_METHOD(HiredisStreamConsumer, flushAcks) {
+    hiredis_stream_consumer_t* sc;
+    hiredis_t* client;
+    zend_long acked = 0;
+    if (zend_parse_parameters_none() == FAILURE) {
+        return;
+    }
+    sc = Z_HIREDIS_STREAM_CONSUMER_P(getThis());
+    if (zend_hash_num_elements(Z_ARRVAL(sc->acks)) == 0) {
+        RETURN_LONG(0);
+    }
+    if (!(client = _hiredis_consumer_client(sc))) {
+        RETURN_FALSE;
+    }
+    if (REDIS_OK != _hiredis_consumer_append_ack(client, sc)) {
+        PHP_HIREDIS_SET_ERROR(client);
+        RETURN_FALSE;
+    }
+    if (REDIS_OK != _hiredis_consumer_read_ack(client, sc, &acked, 0)) {
+        RETURN_FALSE;
+    }
+    RETURN_LONG(acked);
+}
+/* }}} */
+
+/* {{{ proto array HiredisStreamConsumer::claim(int min_idle_ms [, string start_id])
+   Take over entries idle for at least min_idle_ms with XAUTOCLAIM, up to
+   count per call. Without start_id the scan continues from the cursor of
+   the previous call; getClaimCursor() is "0-0" once it has wrapped. */
+PHP_METHOD(HiredisStreamConsumer, claim) {
+    hiredis_stream_consumer_t* sc;
+    hiredis_t* client;
+    zend_long min_idle;
+    zend_string* start = NULL;
+    const char* argv[8];
+    size_t argvlen[8];
+    char idle_buf[32];
+    char count_buf[32];
+    zval reply;
+    zval* zv;
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l|S!", &min_idle, &start) == FAILURE) {
+        return;
+    }
+    sc = Z_HIREDIS_STREAM_CONSUMER_P(getThis());
+    if (!(client = _hiredis_consumer_client(sc))) {
+        RETURN_FALSE;
+    }
+    if (!start) {
+        start = sc->claim_cursor;
+    }
+    argv[0] = "XAUTOCLAIM";
+    argvlen[0] = sizeof("XAUTOCLAIM")-1;
+    argv[1] = ZSTR_VAL(sc->stream);
+    argvlen[1] = ZSTR_LEN(sc->stream);
+    argv[2] = ZSTR_VAL(sc->group);
+    argvlen[2] = ZSTR_LEN(sc->group);
+    argv[3] = ZSTR_VAL(sc->consumer);
+    argvlen[3] = ZSTR_LEN(sc->consumer);
+    argv[4] = idle_buf;
+    argvlen[4] = snprintf(idle_buf, sizeof(idle_buf), ZEND_LONG_FMT, min_idle);
+    argv[5] = start ? ZSTR_VAL(start) : "0-0";
+    argvlen[5] = start ? ZSTR_LEN(start) : sizeof("0-0")-1;
+    argv[6] = "COUNT";
+    argvlen[6] = sizeof("COUNT")-1;
+    argv[7] = count_buf;
+    argvlen[7] = snprintf(count_buf, sizeof(count_buf), ZEND_LONG_FMT, sc->count > 0 ? sc->count : 100);
+    if (REDIS_OK != _hiredis_consumer_call(client, 8, argv, argvlen, &reply)) {
+        RETURN_FALSE;
+    }
+    if (client->reply_is_error) {
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, Z_STRVAL(reply));
+        zval_ptr_dtor(&reply);
+        RETURN_FALSE;
+    }
+
+    // [next cursor, entries(, deleted ids on Redis 7)]
+    array_init(return_value);
+    if (Z_TYPE(reply) == IS_ARRAY) {
+        if ((zv = zend_hash_index_find(Z_ARRVAL(reply), 0)) && Z_TYPE_P(zv) == IS_STRING) {
+            if (sc->claim_cursor) {
+                zend_string_release(sc->claim_cursor);
+            }
+            sc->claim_cursor = zend_string_copy(Z_STR_P(zv));
+        }
+        if ((zv = zend_hash_index_find(Z_ARRVAL(reply), 1))) {
+            _hiredis_stream_entries(zv, return_value, sc->auto_ack ? &sc->acks : NULL);
+        }
+    }
+    zval_ptr_dtor(&reply);
+}
+/* }}} */
+
+/* {{{ proto string HiredisStreamConsumer::getClaimCursor()
+   Return where the next claim() without start_id begins. */
+PHP_METHOD(HiredisStreamConsumer, getClaimCursor) {
+    hiredis_stream_consumer_t* sc;
+    if (zend_parse_parameters_none() == FAILURE) {
+        return;
+    }
+    sc = Z_HIREDIS_STREAM_CONSUMER_P(getThis());
+    if (!sc->claim_cursor) {
+        RETURN_STRINGL("0-0", sizeof("0-0")-1);
+    }
+    RETURN_STR_COPY(sc->claim_cursor);
+}
+/* }}} */
+
+/* {{{ proto int HiredisStreamConsumer::getPendingAcks()
+   Return the number of ids waiting to be acknowledged. */
+PHP_METHOD(HiredisStreamConsumer, getPendingAcks) {
+    if (zend_parse_parameters_none() == FAILURE) {
+        return;
+    }
+    RETURN_LONG(zend_hash_num_elements(Z_ARRVAL(Z_HIREDIS_STREAM_CONSUMER_P(getThis())->acks)));
+}
+/* }}} */
+
+/* {{{ proto bool HiredisStreamConsumer::setCount(int count)
+   Set the maximum number of entries per read or claim. */
+PHP_METHOD(HiredisStreamConsumer, setCount) {
+    zend_long count;
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &count) == FAILURE) {
+        return;
+    }
+    Z_HIREDIS_STREAM_CONSUMER_P(getThis())->count = count;
+    RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto bool HiredisStreamConsumer::setBlock(?int block_ms)
+   Set how long read blocks waiting for entries; null does not block. The
+   client timeout must be longer than block_ms. */
+PHP_METHOD(HiredisStreamConsumer, setBlock) {
+    zend_long block_ms = -1;
+    zend_bool block_null = 0;
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l!", &block_ms, &block_null) == FAILURE) {
+        return;
+    }
+    Z_HIREDIS_STREAM_CONSUMER_P(getThis())->block_ms = block_null || block_ms < 0 ? -1 : block_ms;
+    RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto bool HiredisStreamConsumer::setAutoAck(bool on_off)
+   Set whether entries returned by read and claim are acknowledged
+   with the next read. */
+PHP_METHOD(HiredisStreamConsumer, setAutoAck) {
+    zend_bool on_off;
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "b", &on_off) == FAILURE) {
+        return;
+    }
+    Z_HIREDIS_STREAM_CONSUMER_P(getThis())->auto_ack = on_off ? 1 : 0;
+    RETURN_TRUE;
+}
+/* }}} */
+#endif
+
+/* {{{ proto mixed hiredis_send_raw(string args...)
+   Send command and return result. */
+PHP_FUNCTION(hiredis_send_raw) {
+    _hiredis_send_raw(INTERNAL_FUNCTION_PARAM_PASSTHRU, 0, 0);
 }
+/* }}} */
 
-/* Invoked before connecting and at __destruct */
-static void _hiredis_conn_deinit(hiredis_t* client) {
-    if (client->ctx) {
-        redisFree(client->ctx);
-    }
-    client->ctx = NULL;
+/* {{{ proto string hiredis_send_raw_array(array args)
+   Send command and return result. */
+PHP_FUNCTION(hiredis_send_raw_array) {
+    _hiredis_send_raw(INTERNAL_FUNCTION_PARAM_PASSTHRU, 1, 0);
 }
+/* }}} */
 
-/* {{{ proto void Hiredis::__construct()
-   Constructor for Hiredis. */
-PHP_METHOD(Hiredis, __construct) {
-    hiredis_t* client;
-    if (zend_parse_parameters_none() == FAILURE) {
-        return;
-    }
-    return_value = getThis();
-    client = Z_HIREDIS_P(return_value);
-    client->ctx = NULL;
-    client->timeout_us = -1;
-    client->keep_alive_int_s = -1;
-    client->max_read_buf = REDIS_READER_MAX_BUF;
-    client->throw_exceptions = 0;
+/* {{{ proto string hiredis_append_command(string args...)
+   Append command to pipeline. */
+PHP_FUNCTION(hiredis_append_command) {
+    _hiredis_send_raw(INTERNAL_FUNCTION_PARAM_PASSTHRU, 0, 1);
 }
 /* }}} */
 
-/* {{{ proto void Hiredis::__destruct()
-   Destructor for Hiredis. */
-PHP_METHOD(Hiredis, __destruct) {
-    hiredis_t* client;
-    return_value = getThis();
-    client = Z_HIREDIS_P(return_value);
-    _hiredis_conn_deinit(client);
+/* {{{ proto string hiredis_append_command_array(array args)
+   Append command to pipeline. */
+PHP_FUNCTION(hiredis_append_command_array) {
+    _hiredis_send_raw(INTERNAL_FUNCTION_PARAM_PASSTHRU, 1, 1);
 }
 /* }}} */
 
-/* {{{ proto void Hiredis::__call(string func, array args)
-   Magic command handler. */
-PHP_METHOD(Hiredis, __call) {
+/* {{{ proto mixed hiredis_get_to_stream(string key, resource stream [, int chunk_size])
+   GET key and write the value to stream. Returns bytes written or NULL. */
+PHP_FUNCTION(hiredis_get_to_stream) {
+    zval* zobj;
     hiredis_t* client;
-    char* ofunc;
-    char* func;
-    strlen_t func_len;
-    char* cmd;
-    zval* func_args;
-    int func_argc;
-
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "sa", &ofunc, &func_len, &func_args) == FAILURE) {
+    zval* zkey;
+    zval* zstream;
+    long chunk_size = 0;
+    zval args[2];
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "Ozr|l", &zobj, hiredis_ce, &zkey, &zstream, &chunk_size) == FAILURE) {
         RETURN_FALSE;
     }
-
-    client = Z_HIREDIS_P(getThis());
+    client = Z_HIREDIS_P(zobj);
     PHP_HIREDIS_ENSURE_CTX(client);
-
-    func = estrndup(ofunc, func_len);
-    php_strtoupper(func, func_len);
-    cmd = NULL;
     #if PHP_MAJOR_VERSION >= 7
-        if (zend_hash_str_exists(&hiredis_cmd_map, func, func_len)) {
-            cmd = func;
-        }
+        ZVAL_STRINGL(&args[0], "GET", 3);
     #else
-        if (zend_hash_exists(&hiredis_cmd_map, func, func_len)) {
-            cmd = func;
-        }
+        ZVAL_STRINGL(&args[0], "GET", 3, 0);
+    #endif
+    memcpy(&args[1], zkey, sizeof(zval));
+    _hiredis_send_to_stream(INTERNAL_FUNCTION_PARAM_PASSTHRU, client, args, 2, zstream, chunk_size);
+    #if PHP_MAJOR_VERSION >= 7
+        zval_ptr_dtor(&args[0]);
     #endif
-
-    if (cmd) {
-        _hiredis_convert_zval_to_array_of_zvals(func_args, &func_args, &func_argc);
-        _hiredis_send_raw_array(INTERNAL_FUNCTION_PARAM_PASSTHRU, client, cmd, func_args, func_argc, 0);
-        efree(func_args);
-    } else {
-        #if PHP_MAJOR_VERSION >= 7
-            zend_throw_error(NULL, "Call to undefined method Hiredis::%s()", func);
-        #else
-            zend_throw_exception_ex(NULL, 0 TSRMLS_CC, "Call to undefined method Hiredis::%s()", func);
-        #endif
-    }
-    efree(func);
 }
 /* }}} */
 
-/* {{{ proto bool hiredis_connect(string ip, int port [, float timeout_s])
-   Connect to a server via TCP. */
-PHP_FUNCTION(hiredis_connect) {
+/* {{{ proto mixed hiredis_send_raw_array_to_stream(array args, resource stream [, int chunk_size])
+   Send command and write its bulk string reply to stream, returning bytes
+   written or NULL. Other replies are returned as sendRawArray would. */
+PHP_FUNCTION(hiredis_send_raw_array_to_stream) {
     zval* zobj;
     hiredis_t* client;
-    char* ip;
-    strlen_t ip_len;
-    long port;
-    double timeout_s = -1;
-    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "Osl|d", &zobj, hiredis_ce, &ip, &ip_len, &port, &timeout_s) == FAILURE) {
+    zval* zargs;
+    zval* zstream;
+    long chunk_size = 0;
+    zval* args;
+    int argc;
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "Oar|l", &zobj, hiredis_ce, &zargs, &zstream, &chunk_size) == FAILURE) {
         RETURN_FALSE;
     }
     client = Z_HIREDIS_P(zobj);
-    _hiredis_conn_deinit(client);
-    if (timeout_s >= 0) {
-        client->timeout_us = (long)(timeout_s * 1000 * 1000);
-    }
-    if (!(client->ctx = redisConnect(ip, port))) {
-        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "redisConnect returned NULL");
-        RETURN_FALSE;
-    } else if (client->ctx->err) {
-        PHP_HIREDIS_SET_ERROR(client);
-        RETURN_FALSE;
-    }
-    if (REDIS_OK == _hiredis_conn_init(client)) {
-        RETURN_TRUE;
+    PHP_HIREDIS_ENSURE_CTX(client);
+    _hiredis_convert_zval_to_array_of_zvals(zargs, &args, &argc);
+    if (argc < 1) {
+        efree(args);
+        WRONG_PARAM_COUNT;
     }
-    RETURN_FALSE;
+    _hiredis_send_to_stream(INTERNAL_FUNCTION_PARAM_PASSTHRU, client, args, argc, zstream, chunk_size);
+    efree(args);
 }
 /* }}} */
 
-/* {{{ proto bool hiredis_connect_unix(string path)
-   Connect to a server via Unix socket. */
-PHP_FUNCTION(hiredis_connect_unix) {
+/* {{{ proto string hiredis_get_reply()
+   Get reply from pipeline. */
+PHP_FUNCTION(hiredis_get_reply) {
     zval* zobj;
     hiredis_t* client;
-    char* path;
-    strlen_t path_len;
-    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "Os", &zobj, hiredis_ce, &path, &path_len) == FAILURE) {
+    #ifdef HAVE_HIREDIS_USDT
+        uint64_t probe_start = PHP_HIREDIS_PROBE_ENABLED(reply__done) ? _hiredis_probe_now_ns() : 0;
+    #endif
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "O", &zobj, hiredis_ce) == FAILURE) {
         RETURN_FALSE;
     }
     client = Z_HIREDIS_P(zobj);
-    _hiredis_conn_deinit(client);
-    if (!(client->ctx = redisConnectUnix(path))) {
-        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "redisConnectUnix returned NULL");
+    PHP_HIREDIS_ENSURE_CTX(client);
+    if (REDIS_OK != _hiredis_pipeline_flush(client)) {
         RETURN_FALSE;
-    } else if (client->ctx->err) {
+    }
+    if (client->raw_pending > 0) {
+        client->raw_pending--;
+    }
+    #ifdef PHP_HIREDIS_BG_READER
+        if (_hiredis_bg_has_reply(client)) {
+            if (REDIS_OK != _hiredis_bg_pop(client, return_value)) {
+                PHP_HIREDIS_SET_ERROR(client);
+                RETURN_FALSE;
+            }
+            #ifdef HAVE_HIREDIS_USDT
+                if (probe_start) {
+                    _hiredis_probe_reply_done(client, return_value, probe_start);
+                }
+            #endif
+            PHP_HIREDIS_RETURN_OR_THROW(client, return_value);
+            return;
+        }
+    #endif
+    if (REDIS_OK != _hiredis_io_get_reply(client, return_value)) {
         PHP_HIREDIS_SET_ERROR(client);
         RETURN_FALSE;
     }
-    if (REDIS_OK != _hiredis_conn_init(client)) {
+    #ifdef HAVE_HIREDIS_USDT
+        if (probe_start) {
+            _hiredis_probe_reply_done(client, return_value, probe_start);
+        }
+    #endif
+    PHP_HIREDIS_RETURN_OR_THROW(client, return_value);
+}
+/* }}} */
+
+/* {{{ proto array hiredis_get_io_stats()
+   Get I/O backend name and syscall/reply counters. */
+PHP_FUNCTION(hiredis_get_io_stats) {
+    zval* zobj;
+    hiredis_t* client;
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "O", &zobj, hiredis_ce) == FAILURE) {
         RETURN_FALSE;
     }
-    RETURN_TRUE;
+    client = Z_HIREDIS_P(zobj);
+    array_init(return_value);
+    #if PHP_MAJOR_VERSION >= 7
+        add_assoc_string(return_value, "backend", client->io_uring ? "io_uring" : "hiredis");
+    #else
+        add_assoc_string(return_value, "backend", client->io_uring ? "io_uring" : "hiredis", 1);
+    #endif
+    add_assoc_long(return_value, "syscalls", client->io_syscalls);
+    add_assoc_long(return_value, "replies", client->io_replies);
+    add_assoc_bool(return_value, "background_reader", client->bg != NULL);
+    #ifdef PHP_HIREDIS_HEALTH
+        add_assoc_long(return_value, "health_checks", client->health_checks);
+        add_assoc_long(return_value, "health_reconnects", client->health_reconnects);
+    #endif
+    #ifdef PHP_HIREDIS_TLS
+        if (client->tls_ssl) {
+            #ifdef SSL_OP_ENABLE_KTLS
+                add_assoc_bool(return_value, "ktls_send", BIO_get_ktls_send(SSL_get_wbio(client->tls_ssl)) != 0);
+                add_assoc_bool(return_value, "ktls_recv", BIO_get_ktls_recv(SSL_get_rbio(client->tls_ssl)) != 0);
+            #endif
+            add_assoc_bool(return_value, "tls_resumed", SSL_session_reused(client->tls_ssl) != 0);
+        }
+    #endif
 }
 /* }}} */
 
-/* {{{ proto bool hiredis_reconnect()
-   Reonnect to a server. */
-#ifdef HAVE_HIREDIS_RECONNECT
-PHP_FUNCTION(hiredis_reconnect) {
+#if PHP_MAJOR_VERSION >= 7
+/* Run a single-key read through the shared-memory cache. On a miss the
+   command is sent synchronously, even in auto_pipeline mode. */
+static void _hiredis_cached_cmd(INTERNAL_FUNCTION_PARAMETERS, const char* cmd) {
     zval* zobj;
     hiredis_t* client;
-    char* path;
-    size_t path_len;
-    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "O", &zobj, hiredis_ce) == FAILURE) {
+    char* key;
+    strlen_t key_len;
+    zend_long ttl_ms;
+    char* ckey = NULL;
+    size_t ckey_len = 0;
+    const char* argv[2];
+    size_t argvlen[2];
+    int rc;
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "Osl", &zobj, hiredis_ce, &key, &key_len, &ttl_ms) == FAILURE) {
         RETURN_FALSE;
     }
     client = Z_HIREDIS_P(zobj);
     PHP_HIREDIS_ENSURE_CTX(client);
-    if (REDIS_OK != redisReconnect(client->ctx)) {
+
+    if (hiredis_shm && ttl_ms > 0) {
+        ckey = _hiredis_shm_key(client, cmd[0], key, key_len, &ckey_len);
+        // If another worker holds the lease, poll until it stores the value
+        // or the lease runs out and passes to us
+        while (PHP_HIREDIS_SHM_WAIT == (rc = _hiredis_shm_get(ckey, ckey_len, return_value))) {
+            usleep(1000);
+        }
+        if (rc == PHP_HIREDIS_SHM_HIT) {
+            efree(ckey);
+            return;
+        }
+    }
+
+    argv[0] = cmd;
+    argvlen[0] = strlen(cmd);
+    argv[1] = key;
+    argvlen[1] = key_len;
+    #ifdef PHP_HIREDIS_BG_READER
+        if (REDIS_OK != _hiredis_bg_drain(client)) {
+            RETVAL_FALSE;
+        } else
+    #endif
+    if (REDIS_OK != _hiredis_pipeline_flush(client)) {
+        RETVAL_FALSE;
+    } else if (client->raw_pending > 0) {
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "Cannot use cache with replies pending");
+        RETVAL_FALSE;
+    } else if (REDIS_OK != _hiredis_io_before_send(client)) {
+        RETVAL_FALSE;
+    } else if (REDIS_OK != redisAppendCommandArgv(client->ctx, 2, argv, argvlen)
+        || REDIS_OK != _hiredis_io_get_reply(client, return_value)
+    ) {
         PHP_HIREDIS_SET_ERROR(client);
+        RETVAL_FALSE;
+    } else {
+        if (ckey && !client->reply_is_error) {
+            _hiredis_shm_put(ckey, ckey_len, return_value, ttl_ms);
+            efree(ckey);
+            ckey = NULL;
+        }
+        PHP_HIREDIS_RETURN_OR_THROW(client, return_value);
+    }
+    if (ckey) {
+        // Drop the lease so waiters fetch for themselves
+        _hiredis_shm_del(ckey, ckey_len);
+        efree(ckey);
+    }
+}
+
+/* {{{ proto mixed hiredis_cached_get(string key, int ttl_ms)
+   GET through the shared-memory cache. */
+PHP_FUNCTION(hiredis_cached_get) {
+    _hiredis_cached_cmd(INTERNAL_FUNCTION_PARAM_PASSTHRU, "GET");
+}
+/* }}} */
+
+/* {{{ proto mixed hiredis_cached_hgetall(string key, int ttl_ms)
+   HGETALL through the shared-memory cache. */
+PHP_FUNCTION(hiredis_cached_hgetall) {
+    _hiredis_cached_cmd(INTERNAL_FUNCTION_PARAM_PASSTHRU, "HGETALL");
+}
+/* }}} */
+
+/* {{{ proto bool hiredis_cache_invalidate(string key)
+   Drop cached GET/HGETALL values of key for this server. */
+PHP_FUNCTION(hiredis_cache_invalidate) {
+    zval* zobj;
+    hiredis_t* client;
+    char* key;
+    strlen_t key_len;
+    char* ckey;
+    size_t ckey_len;
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "Os", &zobj, hiredis_ce, &key, &key_len) == FAILURE) {
         RETURN_FALSE;
     }
-    if (REDIS_OK != _hiredis_conn_init(client)) {
+    client = Z_HIREDIS_P(zobj);
+    PHP_HIREDIS_ENSURE_CTX(client);
+    if (!hiredis_shm) {
         RETURN_FALSE;
     }
+    ckey = _hiredis_shm_key(client, 'G', key, key_len, &ckey_len);
+    _hiredis_shm_del(ckey, ckey_len);
+    ckey[0] = 'H';
+    _hiredis_shm_del(ckey, ckey_len);
+    efree(ckey);
     RETURN_TRUE;
 }
-#endif
 /* }}} */
 
-/* {{{ proto bool hiredis_set_timeout(int timeout_us)
-   Set read/write timeout in microseconds. */
-PHP_FUNCTION(hiredis_set_timeout) {
+/* Split a multi-key read into commands of `chunk` items each after the
+   fixed prefix (command name, plus key for hash/set commands), keep at
+   most `window` of them in flight and concatenate the replies in item
+   order. Each command stays short on the server while the pipeline keeps
+   throughput close to a single round trip. On an error reply the chunks
+   already sent are still read so the connection stays in sync. */
+static void _hiredis_chunked_cmd(INTERNAL_FUNCTION_PARAMETERS, const char* cmd, int with_key) {
     zval* zobj;
     hiredis_t* client;
-    long timeout_us;
-    struct timeval timeout_tv;
-    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "Ol", &zobj, hiredis_ce, &timeout_us) == FAILURE) {
+    char* key = NULL;
+    strlen_t key_len = 0;
+    zval* items;
+    zend_long chunk;
+    zend_bool assoc = 0;
+    zend_long window = PHP_HIREDIS_CHUNK_WINDOW;
+    zend_string** strs;
+    const char** argv;
+    size_t* argvlen;
+    uint32_t n, i, off, cnt, nchunks, sent, done;
+    int prefix, rc;
+    zval reply, err;
+    zval* zv;
+    if (with_key) {
+        rc = zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "Osal|bl", &zobj, hiredis_ce, &key, &key_len, &items, &chunk, &assoc, &window);
+    } else {
+        rc = zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "Oal|bl", &zobj, hiredis_ce, &items, &chunk, &assoc, &window);
+    }
+    if (rc == FAILURE) {
         RETURN_FALSE;
     }
     client = Z_HIREDIS_P(zobj);
-    client->timeout_us = timeout_us;
-    if (!client->ctx) {
-        RETURN_TRUE;
+    PHP_HIREDIS_ENSURE_CTX(client);
+    if (chunk <= 0 || window <= 0) {
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "Chunk size and window must be positive");
+        RETURN_FALSE;
     }
-    if (REDIS_OK != _hiredis_set_timeout(client, timeout_us)) {
+    #ifdef PHP_HIREDIS_BG_READER
+        if (REDIS_OK != _hiredis_bg_drain(client)) {
+            RETURN_FALSE;
+        }
+    #endif
+    if (REDIS_OK != _hiredis_pipeline_flush(client)) {
+        RETURN_FALSE;
+    } else if (client->raw_pending > 0) {
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "Cannot send chunked command with replies pending");
         RETURN_FALSE;
+    } else if (REDIS_OK != _hiredis_io_before_send(client)) {
+        RETURN_FALSE;
+    }
+    if ((n = zend_hash_num_elements(Z_ARRVAL_P(items))) == 0) {
+        array_init(return_value);
+        return;
+    }
+
+    if ((zend_long)n < chunk) {
+        chunk = n;
+    }
+    strs = safe_emalloc(n, sizeof(zend_string*), 0);
+    i = 0;
+    ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(items), zv) {
+        strs[i++] = zval_get_string(zv);
+    } ZEND_HASH_FOREACH_END();
+    prefix = with_key ? 2 : 1;
+    argv = safe_emalloc(prefix + chunk, sizeof(char*), 0);
+    argvlen = safe_emalloc(prefix + chunk, sizeof(size_t), 0);
+    argv[0] = cmd;
+    argvlen[0] = strlen(cmd);
+    if (with_key) {
+        argv[1] = key;
+        argvlen[1] = key_len;
+    }
+
+    ZVAL_UNDEF(&err);
+    array_init_size(return_value, n);
+    nchunks = (n + chunk - 1) / chunk;
+    for (sent = done = 0; done < nchunks; done++) {
+        while (Z_TYPE(err) == IS_UNDEF && sent < nchunks && sent - done < (zend_ulong)window) {
+            off = sent * chunk;
+            cnt = MIN((uint32_t)chunk, n - off);
+            for (i = 0; i < cnt; i++) {
+                argv[prefix + i] = ZSTR_VAL(strs[off + i]);
+                argvlen[prefix + i] = ZSTR_LEN(strs[off + i]);
+            }
+            if (REDIS_OK != redisAppendCommandArgv(client->ctx, prefix + cnt, argv, argvlen)) {
+                goto fail;
+            }
+            sent++;
+        }
+        if (done == sent) {
+            break;
+        } else if (REDIS_OK != _hiredis_io_get_reply(client, &reply)) {
+            goto fail;
+        }
+        if (client->reply_is_error) {
+            if (Z_TYPE(err) == IS_UNDEF) {
+                ZVAL_COPY_VALUE(&err, &reply);
+            } else {
+                zval_dtor(&reply);
+            }
+            continue;
+        }
+        if (Z_TYPE(err) == IS_UNDEF && Z_TYPE(reply) == IS_ARRAY) {
+            i = done * chunk;
+            ZEND_HASH_FOREACH_VAL(Z_ARRVAL(reply), zv) {
+                if (i >= n) {
+                    break;
+                }
+                Z_TRY_ADDREF_P(zv);
+                if (assoc) {
+                    zend_symtable_update(Z_ARRVAL_P(return_value), strs[i], zv);
+                } else {
+                    zend_hash_next_index_insert(Z_ARRVAL_P(return_value), zv);
+                }
+                i++;
+            } ZEND_HASH_FOREACH_END();
+        }
+        zval_ptr_dtor(&reply);
+    }
+    if (Z_TYPE(err) != IS_UNDEF) {
+        zval_ptr_dtor(return_value);
+        client->reply_is_error = 1;
+        PHP_HIREDIS_RETURN_OR_THROW(client, &err);
+    }
+    goto done;
+
+fail:
+    PHP_HIREDIS_SET_ERROR(client);
+    zval_ptr_dtor(return_value);
+    zval_ptr_dtor(&err);
+    RETVAL_FALSE;
+
+done:
+    for (i = 0; i < n; i++) {
+        zend_string_release(strs[i]);
+    }
+    efree(strs);
+    efree(argv);
+    efree(argvlen);
+}
+
+/* {{{ proto array hiredis_mget_chunked(array keys, int chunk [, bool assoc [, int window]])
+   MGET in pipelined commands of at most chunk keys. With assoc the result
+   is key => value. */
+PHP_FUNCTION(hiredis_mget_chunked) {
+    _hiredis_chunked_cmd(INTERNAL_FUNCTION_PARAM_PASSTHRU, "MGET", 0);
+}
+/* }}} */
+
+/* {{{ proto array hiredis_hmget_chunked(string key, array fields, int chunk [, bool assoc [, int window]])
+   HMGET in pipelined commands of at most chunk fields. */
+PHP_FUNCTION(hiredis_hmget_chunked) {
+    _hiredis_chunked_cmd(INTERNAL_FUNCTION_PARAM_PASSTHRU, "HMGET", 1);
+}
+/* }}} */
+
+/* {{{ proto array hiredis_smismember_chunked(string key, array members, int chunk [, bool assoc [, int window]])
+   SMISMEMBER in pipelined commands of at most chunk members. */
+PHP_FUNCTION(hiredis_smismember_chunked) {
+    _hiredis_chunked_cmd(INTERNAL_FUNCTION_PARAM_PASSTHRU, "SMISMEMBER", 1);
+}
+/* }}} */
+
+/* Keys of one migrateKeys window. sent[i] marks keys whose RESTORE was
+   queued on the destination, so its replies can be matched back. */
+typedef struct {
+    zend_string** keys;
+    zend_bool* sent;
+    uint32_t n;
+} hiredis_migrate_batch_t;
+
+/* Return the next key of an array or Traversable as a string, or NULL once
+   it is exhausted or has thrown. The iterator is created on first use. */
+static zend_string* _hiredis_migrate_next_key(zval* keys, HashPosition* pos, zend_object_iterator** it) {
+    zend_class_entry* ce;
+    zend_string* key;
+    zval* zv;
+    if (Z_TYPE_P(keys) == IS_ARRAY) {
+        if (!(zv = zend_hash_get_current_data_ex(Z_ARRVAL_P(keys), pos))) {
+            return NULL;
+        }
+        zend_hash_move_forward_ex(Z_ARRVAL_P(keys), pos);
+    } else {
+        if (!*it) {
+            ce = Z_OBJCE_P(keys);
+            if (!(*it = ce->get_iterator(ce, keys, 0)) || EG(exception)) {
+                return NULL;
+            }
+            (*it)->index = 0;
+            if ((*it)->funcs->rewind) {
+                (*it)->funcs->rewind(*it);
+            }
+        } else {
+            (*it)->funcs->move_forward(*it);
+        }
+        if (EG(exception) || (*it)->funcs->valid(*it) != SUCCESS) {
+            return NULL;
+        }
+        if (!(zv = (*it)->funcs->get_current_data(*it)) || EG(exception)) {
+            return NULL;
+        }
+    }
+    key = zval_get_string(zv);
+    if (EG(exception)) {
+        zend_string_release(key);
+        return NULL;
+    }
+    return key;
+}
+
+/* Consume the next reply from the reader buffer without decoding it,
+   pointing [*start, *end) at its RESP bytes. They stay valid until the
+   next read on this connection. */
+static int _hiredis_io_get_raw_reply(hiredis_t* client, const char** start, const char** end) {
+    redisReader* r = client->ctx->reader;
+    const char* p;
+    int err;
+    if (r->pos >= 1024) {
+        sdsrange(r->buf, r->pos, -1);
+        r->pos = 0;
+        r->len = sdslen(r->buf);
+    }
+    for (;;) {
+        if (r->pos < r->len) {
+            p = _hiredis_resp_skip(r->buf + r->pos, r->buf + r->len, &err);
+            if (err) {
+                _hiredis_io_set_ctx_error(client->ctx, REDIS_ERR_PROTOCOL, "Protocol error");
+                return REDIS_ERR;
+            } else if (p) {
+                *start = r->buf + r->pos;
+                *end = p;
+                r->pos = p - r->buf;
+                client->io_replies++;
+                return REDIS_OK;
+            }
+        }
+        if (REDIS_OK != _hiredis_io_fill(client)) {
+            return REDIS_ERR;
+        }
+    }
+}
+
+/* Queue RESTORE key ttl payload [REPLACE] on c, copying the payload
+   straight from the source reader buffer into the output buffer */
+static int _hiredis_migrate_append_restore(redisContext* c, zend_string* key, long long ttl, const char* payload, size_t len, int replace) {
+    char hdr[64], mid[96];
+    int hlen, mlen;
+    sds buf;
+    hlen = snprintf(hdr, sizeof(hdr), "*%d\r\n$7\r\nRESTORE\r\n$%zu\r\n", replace ? 5 : 4, ZSTR_LEN(key));
+    mlen = snprintf(mid, sizeof(mid), "\r\n$%d\r\n%lld\r\n$%zu\r\n", snprintf(NULL, 0, "%lld", ttl), ttl, len);
+    if (!(buf = sdsMakeRoomFor(c->obuf, hlen + ZSTR_LEN(key) + mlen + len + sizeof("\r\n$7\r\nREPLACE\r\n")))) {
+        _hiredis_io_set_ctx_error(c, REDIS_ERR_OOM, "Out of memory");
+        return REDIS_ERR;
+    }
+    buf = sdscatlen(buf, hdr, hlen);
+    buf = sdscatlen(buf, ZSTR_VAL(key), ZSTR_LEN(key));
+    buf = sdscatlen(buf, mid, mlen);
+    buf = sdscatlen(buf, payload, len);
+    if (replace) {
+        buf = sdscatlen(buf, "\r\n$7\r\nREPLACE\r\n", sizeof("\r\n$7\r\nREPLACE\r\n") - 1);
+    } else {
+        buf = sdscatlen(buf, "\r\n", 2);
+    }
+    c->obuf = buf;
+    return REDIS_OK;
+}
+
+/* Record a per-key error message */
+static void _hiredis_migrate_error(zval* errors, zend_string* key, const char* msg, size_t len) {
+    zval zv;
+    ZVAL_STRINGL(&zv, msg, len);
+    zend_symtable_update(Z_ARRVAL_P(errors), key, &zv);
+}
+
+/* Fill b with up to window keys and queue PTTL+DUMP for each on client.
+   Clears *more once the keys run out. */
+static int _hiredis_migrate_queue(hiredis_t* client, hiredis_migrate_batch_t* b, zval* keys, HashPosition* pos, zend_object_iterator** it, uint32_t window, int* more) {
+    const char* argv[2];
+    size_t argvlen[2];
+    zend_string* key;
+    while (*more && b->n < window) {
+        if (!(key = _hiredis_migrate_next_key(keys, pos, it))) {
+            *more = 0;
+            break;
+        }
+        b->sent[b->n] = 0;
+        b->keys[b->n++] = key;
+        argv[0] = "PTTL";
+        argvlen[0] = 4;
+        argv[1] = ZSTR_VAL(key);
+        argvlen[1] = ZSTR_LEN(key);
+        if (REDIS_OK != redisAppendCommandArgv(client->ctx, 2, argv, argvlen)) {
+            return REDIS_ERR;
+        }
+        argv[0] = "DUMP";
+        if (REDIS_OK != redisAppendCommandArgv(client->ctx, 2, argv, argvlen)) {
+            return REDIS_ERR;
+        }
     }
-    RETURN_TRUE;
+    return REDIS_OK;
 }
-/* }}} */
 
-/* {{{ proto int hiredis_get_timeout()
-   Get read/write timeout in microseconds. */
-PHP_FUNCTION(hiredis_get_timeout) {
-    zval* zobj;
-    hiredis_t* client;
-    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "O", &zobj, hiredis_ce) == FAILURE) {
-        RETURN_FALSE;
+/* Release the keys of a batch */
+static void _hiredis_migrate_batch_reset(hiredis_migrate_batch_t* b) {
+    uint32_t i;
+    for (i = 0; i < b->n; i++) {
+        zend_string_release(b->keys[i]);
     }
-    client = Z_HIREDIS_P(zobj);
-    RETURN_LONG(client->timeout_us);
+    b->n = 0;
 }
-/* }}} */
 
-/* {{{ proto bool hiredis_set_keep_alive_int(int keep_alive_int_s)
-   Set keep alive interval in seconds. */
-PHP_FUNCTION(hiredis_set_keep_alive_int) {
+/* {{{ proto array hiredis_migrate_keys(Hiredis dest, iterable keys [, int window [, bool replace]])
+   Copy keys to dest with their remaining TTL using PTTL+DUMP here and
+   RESTORE there, window keys at a time. The next window of PTTL+DUMP is
+   in flight on this connection while the previous one is restored on
+   dest, and DUMP payloads go from this reader buffer to dest's output
+   buffer without becoming PHP strings. Returns ['migrated' => count,
+   'errors' => [key => message]]. Expects RESP2 replies. */
+PHP_FUNCTION(hiredis_migrate_keys) {
     zval* zobj;
+    zval* zdest;
+    zval* keys;
+    zend_long window = PHP_HIREDIS_MIGRATE_WINDOW;
+    zend_bool replace = 0;
     hiredis_t* client;
-    long keep_alive_int_s;
-    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "Ol", &zobj, hiredis_ce, &keep_alive_int_s) == FAILURE) {
+    hiredis_t* dest;
+    hiredis_t* failed = NULL;
+    hiredis_migrate_batch_t batches[3];
+    hiredis_migrate_batch_t* b;
+    hiredis_migrate_batch_t* pb;
+    HashPosition pos = 0;
+    zend_object_iterator* it = NULL;
+    const char* s;
+    const char* e;
+    const char* eol;
+    long long ttl, len;
+    zend_long migrated = 0;
+    zval errors, reply;
+    uint32_t i;
+    int k, more = 1, ttl_ok;
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "OOz|lb", &zobj, hiredis_ce, &zdest, hiredis_ce, &keys, &window, &replace) == FAILURE) {
         RETURN_FALSE;
     }
     client = Z_HIREDIS_P(zobj);
-    client->keep_alive_int_s = keep_alive_int_s;
-    if (!client->ctx) {
-        RETURN_TRUE;
+    dest = Z_HIREDIS_P(zdest);
+    PHP_HIREDIS_ENSURE_CTX(client);
+    if (!dest->ctx) {
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "Destination has no redisContext");
+        RETURN_FALSE;
+    } else if (dest == client) {
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "Source and destination must be different connections");
+        RETURN_FALSE;
+    } else if (window <= 0 || window > UINT32_MAX) {
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "Window must be positive");
+        RETURN_FALSE;
+    } else if (Z_TYPE_P(keys) != IS_ARRAY && !(Z_TYPE_P(keys) == IS_OBJECT && instanceof_function(Z_OBJCE_P(keys), zend_ce_traversable))) {
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "Keys must be an array or Traversable");
+        RETURN_FALSE;
     }
-    if (REDIS_OK != _hiredis_set_keep_alive_int(client, keep_alive_int_s)) {
+    #ifdef PHP_HIREDIS_BG_READER
+        if (REDIS_OK != _hiredis_bg_drain(client) || REDIS_OK != _hiredis_bg_drain(dest)) {
+            RETURN_FALSE;
+        }
+    #endif
+    if (REDIS_OK != _hiredis_pipeline_flush(client) || REDIS_OK != _hiredis_pipeline_flush(dest)) {
+        RETURN_FALSE;
+    } else if (client->raw_pending > 0 || dest->raw_pending > 0) {
+        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "Cannot migrate keys with replies pending");
+        RETURN_FALSE;
+    } else if (REDIS_OK != PHP_HIREDIS_HEDGE_SETTLE(client)) {
+        PHP_HIREDIS_SET_ERROR(client);
+        RETURN_FALSE;
+    } else if (REDIS_OK != _hiredis_io_before_send(client)) {
+        RETURN_FALSE;
+    } else if (REDIS_OK != _hiredis_io_before_send(dest)) {
+        PHP_HIREDIS_SET_ERROR_EX(client, dest->err, dest->errstr);
         RETURN_FALSE;
     }
-    RETURN_TRUE;
-}
-/* }}} */
 
-/* {{{ proto int hiredis_get_keep_alive_int()
-   Get keep alive interval in seconds.*/
-PHP_FUNCTION(hiredis_get_keep_alive_int) {
-    zval* zobj;
-    hiredis_t* client;
-    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "O", &zobj, hiredis_ce) == FAILURE) {
-        RETURN_FALSE;
+    for (k = 0; k < 3; k++) {
+        batches[k].keys = safe_emalloc(window, sizeof(zend_string*), 0);
+        batches[k].sent = safe_emalloc(window, sizeof(zend_bool), 0);
+        batches[k].n = 0;
+    }
+    if (Z_TYPE_P(keys) == IS_ARRAY) {
+        zend_hash_internal_pointer_reset_ex(Z_ARRVAL_P(keys), &pos);
+    }
+    array_init(&errors);
+    if (REDIS_OK != _hiredis_migrate_queue(client, &batches[0], keys, &pos, &it, (uint32_t)window, &more)) {
+        failed = client;
+        goto fail;
     }
-    client = Z_HIREDIS_P(zobj);
-    RETURN_LONG(client->keep_alive_int_s);
-}
-/* }}} */
 
-/* {{{ proto bool hiredis_set_max_read_buf(int max_bytes)
-   Set max read buffer in bytes. */
-PHP_FUNCTION(hiredis_set_max_read_buf) {
-    zval* zobj;
-    hiredis_t* client;
-    long max_bytes;
-    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "Ol", &zobj, hiredis_ce, &max_bytes) == FAILURE) {
-        RETURN_FALSE;
+    // Batch k is restored while batch k + 1 is dumped and the replies of
+    // batch k - 1 are read from dest, so three slots rotate
+    for (k = 0; ; k++) {
+        b = &batches[k % 3];
+        if (b->n > 0) {
+            // Keep the next window in flight while this one is restored
+            if (REDIS_OK != _hiredis_migrate_queue(client, &batches[(k + 1) % 3], keys, &pos, &it, (uint32_t)window, &more)) {
+                failed = client;
+                goto fail;
+            }
+            if (REDIS_OK != _hiredis_io_flush(client)) {
+                failed = client;
+                goto fail;
+            }
+            for (i = 0; i < b->n; i++) {
+                if (REDIS_OK != _hiredis_io_get_raw_reply(client, &s, &e)) {
+                    failed = client;
+                    goto fail;
+                }
+                ttl = 0;
+                ttl_ok = 0;
+                if (*s == ':' && _hiredis_resp_int(s + 1, e - 2, &ttl)) {
+                    ttl_ok = 1;
+                } else if (*s == '-') {
+                    _hiredis_migrate_error(&errors, b->keys[i], s + 1, e - s - 3);
+                } else {
+                    _hiredis_migrate_error(&errors, b->keys[i], ZEND_STRL("Unexpected PTTL reply"));
+                }
+                if (REDIS_OK != _hiredis_io_get_raw_reply(client, &s, &e)) {
+                    failed = client;
+                    goto fail;
+                }
+                if (!ttl_ok) {
+                    continue;
+                } else if (*s == '-') {
+                    _hiredis_migrate_error(&errors, b->keys[i], s + 1, e - s - 3);
+                    continue;
+                }
+                eol = memchr(s, '\r', e - s);
+                if (*s != '$' || !_hiredis_resp_int(s + 1, eol, &len)) {
+                    _hiredis_migrate_error(&errors, b->keys[i], ZEND_STRL("Unexpected DUMP reply"));
+                    continue;
+                } else if (len < 0) {
+                    _hiredis_migrate_error(&errors, b->keys[i], ZEND_STRL("ERR no such key"));
+                    continue;
+                }
+                // -1 means no expiry, which RESTORE spells 0
+                if (REDIS_OK != _hiredis_migrate_append_restore(dest->ctx, b->keys[i], ttl > 0 ? ttl : 0, eol + 2, (size_t)len, replace)) {
+                    failed = dest;
+                    goto fail;
+                }
+                b->sent[i] = 1;
+            }
+            if (REDIS_OK != _hiredis_io_flush(dest)) {
+                failed = dest;
+                goto fail;
+            }
+        }
+        if (k > 0) {
+            pb = &batches[(k + 2) % 3];
+            for (i = 0; i < pb->n; i++) {
+                if (!pb->sent[i]) {
+                    continue;
+                } else if (REDIS_OK != _hiredis_io_get_reply(dest, &reply)) {
+                    failed = dest;
+                    goto fail;
+                }
+                if (dest->reply_is_error && Z_TYPE(reply) == IS_STRING) {
+                    zend_symtable_update(Z_ARRVAL(errors), pb->keys[i], &reply);
+                } else {
+                    migrated++;
+                    zval_ptr_dtor(&reply);
+                }
+            }
+            dest->reply_is_error = 0;
+            _hiredis_migrate_batch_reset(pb);
+        }
+        if (b->n == 0) {
+            break;
+        }
     }
-    client = Z_HIREDIS_P(zobj);
-    client->max_read_buf = max_bytes;
-    if (client->ctx) {
-        client->ctx->reader->maxbuf = max_bytes;
+
+    if (EG(exception)) {
+        zval_ptr_dtor(&errors);
+        RETVAL_FALSE;
+    } else {
+        array_init_size(return_value, 2);
+        add_assoc_long(return_value, "migrated", migrated);
+        add_assoc_zval(return_value, "errors", &errors);
     }
-    RETURN_TRUE;
-}
-/* }}} */
+    goto done;
 
-/* {{{ proto int hiredis_get_max_read_buf()
-   Get max read buffer in bytes. */
-PHP_FUNCTION(hiredis_get_max_read_buf) {
-    zval* zobj;
-    hiredis_t* client;
-    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "O", &zobj, hiredis_ce) == FAILURE) {
-        RETURN_FALSE;
+fail:
+    PHP_HIREDIS_SET_ERROR_EX(client, failed->ctx->err, failed->ctx->errstr);
+    zval_ptr_dtor(&errors);
+    RETVAL_FALSE;
+
+done:
+    if (it) {
+        zend_iterator_dtor(it);
+    }
+    for (k = 0; k < 3; k++) {
+        _hiredis_migrate_batch_reset(&batches[k]);
+        efree(batches[k].keys);
+        efree(batches[k].sent);
     }
-    client = Z_HIREDIS_P(zobj);
-    RETURN_LONG(client->max_read_buf);
 }
 /* }}} */
+#endif
 
-/* {{{ proto bool hiredis_set_throw_exceptions(bool on_off)
-   Set whether to throw exceptions on ERR replies from server. */
-PHP_FUNCTION(hiredis_set_throw_exceptions) {
+/* {{{ proto array hiredis_get_hot_keys([int limit])
+   Get this worker's hottest keys with estimated command counts. */
+PHP_FUNCTION(hiredis_get_hot_keys) {
     zval* zobj;
-    hiredis_t* client;
-    zend_bool on_off;
-    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "Ob", &zobj, hiredis_ce, &on_off) == FAILURE) {
+    long limit = PHP_HIREDIS_HOTKEYS_TOPK;
+    hiredis_hotkey_t* top[PHP_HIREDIS_HOTKEYS_TOPK];
+    int i, n;
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "O|l", &zobj, hiredis_ce, &limit) == FAILURE) {
         RETURN_FALSE;
     }
-    client = Z_HIREDIS_P(zobj);
-    client->throw_exceptions = on_off ? 1 : 0;
-    RETURN_TRUE;
+    n = _hiredis_hotkeys_sorted(top);
+    array_init(return_value);
+    for (i = 0; i < n && i < limit; i++) {
+        #if PHP_MAJOR_VERSION >= 7
+            add_assoc_long_ex(return_value, top[i]->key, top[i]->key_len, top[i]->count);
+        #else
+            add_assoc_long_ex(return_value, top[i]->key, top[i]->key_len + 1, top[i]->count);
+        #endif
+    }
 }
 /* }}} */
 
-/* {{{ proto bool hiredis_get_throw_exceptions()
-   Get whether throw_exceptions is enabled. */
-PHP_FUNCTION(hiredis_get_throw_exceptions) {
+/* {{{ proto bool hiredis_reset_hot_keys()
+   Clear this worker's hot-key counters. */
+PHP_FUNCTION(hiredis_reset_hot_keys) {
     zval* zobj;
-    hiredis_t* client;
+    int i;
     if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "O", &zobj, hiredis_ce) == FAILURE) {
         RETURN_FALSE;
     }
-    client = Z_HIREDIS_P(zobj);
-    RETURN_BOOL(client->throw_exceptions);
-}
-/* }}} */
-
-/* {{{ proto mixed hiredis_send_raw(string args...)
-   Send command and return result. */
-PHP_FUNCTION(hiredis_send_raw) {
-    _hiredis_send_raw(INTERNAL_FUNCTION_PARAM_PASSTHRU, 0, 0);
-}
-/* }}} */
-
-/* {{{ proto string hiredis_send_raw_array(array args)
-   Send command and return result. */
-PHP_FUNCTION(hiredis_send_raw_array) {
-    _hiredis_send_raw(INTERNAL_FUNCTION_PARAM_PASSTHRU, 1, 0);
-}
-/* }}} */
-
-/* {{{ proto string hiredis_append_command(string args...)
-   Append command to pipeline. */
-PHP_FUNCTION(hiredis_append_command) {
-    _hiredis_send_raw(INTERNAL_FUNCTION_PARAM_PASSTHRU, 0, 1);
-}
-/* }}} */
-
-/* {{{ proto string hiredis_append_command_array(array args)
-   Append command to pipeline. */
-PHP_FUNCTION(hiredis_append_command_array) {
-    _hiredis_send_raw(INTERNAL_FUNCTION_PARAM_PASSTHRU, 1, 1);
+    for (i = 0; i < HIREDIS_G(hotkeys_top_len); i++) {
+        pefree(HIREDIS_G(hotkeys_top)[i].key, 1);
+    }
+    HIREDIS_G(hotkeys_top_len) = 0;
+    HIREDIS_G(hotkeys_samples) = 0;
+    if (HIREDIS_G(hotkeys_sketch)) {
+        memset(HIREDIS_G(hotkeys_sketch), 0, PHP_HIREDIS_HOTKEYS_DEPTH * PHP_HIREDIS_HOTKEYS_WIDTH * sizeof(uint32_t));
+    }
+    RETURN_TRUE;
 }
 /* }}} */
 
-/* {{{ proto string hiredis_get_reply()
-   Get reply from pipeline. */
-PHP_FUNCTION(hiredis_get_reply) {
+/* {{{ proto array hiredis_get_command_info(string cmd)
+   Get arity, flags and key positions for a command, or null if unknown. */
+PHP_FUNCTION(hiredis_get_command_info) {
     zval* zobj;
-    hiredis_t* client;
-    zval* reply = NULL;
-    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "O", &zobj, hiredis_ce) == FAILURE) {
+    char* cmd;
+    strlen_t cmd_len;
+    char* ucmd;
+    const hiredis_cmd_info_t* info;
+    int i;
+    #if PHP_MAJOR_VERSION >= 7
+        zval flags;
+    #else
+        zval* flags;
+    #endif
+    if (zend_parse_method_parameters(ZEND_NUM_ARGS(), getThis(), "Os", &zobj, hiredis_ce, &cmd, &cmd_len) == FAILURE) {
         RETURN_FALSE;
     }
-    client = Z_HIREDIS_P(zobj);
-    PHP_HIREDIS_ENSURE_CTX(client);
-    redisReplyReaderSetPrivdata(client->ctx->reader, (void*)return_value);
-    if (REDIS_OK != redisGetReply(client->ctx, (void**)&reply)) {
-        PHP_HIREDIS_SET_ERROR(client);
-        RETURN_FALSE;
-    } else if (reply) {
-        assert(reply == return_value);
-        PHP_HIREDIS_RETURN_OR_THROW(client, return_value);
-    } else {
-        PHP_HIREDIS_SET_ERROR_EX(client, REDIS_ERR, "redisGetReply returned NULL");
-        RETURN_FALSE;
+    ucmd = estrndup(cmd, cmd_len);
+    php_strtoupper(ucmd, cmd_len);
+    info = _hiredis_cmd_info_find(ucmd, cmd_len);
+    efree(ucmd);
+    if (!info) {
+        RETURN_NULL();
     }
+    array_init(return_value);
+    add_assoc_long(return_value, "arity", info->arity);
+    #if PHP_MAJOR_VERSION >= 7
+        array_init(&flags);
+        for (i = 0; hiredis_cmd_flag_names[i].name; i++) {
+            if (info->flags & hiredis_cmd_flag_names[i].flag) {
+                add_next_index_string(&flags, hiredis_cmd_flag_names[i].name);
+            }
+        }
+        add_assoc_zval(return_value, "flags", &flags);
+    #else
+        MAKE_STD_ZVAL(flags);
+        array_init(flags);
+        for (i = 0; hiredis_cmd_flag_names[i].name; i++) {
+            if (info->flags & hiredis_cmd_flag_names[i].flag) {
+                add_next_index_string(flags, hiredis_cmd_flag_names[i].name, 1);
+            }
+        }
+        add_assoc_zval(return_value, "flags", flags);
+    #endif
+    add_assoc_long(return_value, "first_key", info->first_key);
+    add_assoc_long(return_value, "last_key", info->last_key);
+    add_assoc_long(return_value, "key_step", info->key_step);
+    add_assoc_bool(return_value, "loaded", (info->flags & PHP_HIREDIS_CMD_LOADED) != 0);
 }
 /* }}} */
 
@@ -882,6 +7369,12 @@ zend_function_entry hiredis_methods[] = {
     PHP_ME(Hiredis, __call,      arginfo_hiredis_call, ZEND_ACC_PUBLIC)
     PHP_ME_MAPPING(connect,              hiredis_connect,              arginfo_hiredis_connect,              ZEND_ACC_PUBLIC)
     PHP_ME_MAPPING(connectUnix,          hiredis_connect_unix,         arginfo_hiredis_connect_unix,         ZEND_ACC_PUBLIC)
+#if PHP_MAJOR_VERSION >= 7
+    PHP_ME_MAPPING(connectSentinel,      hiredis_connect_sentinel,     arginfo_hiredis_connect_sentinel,     ZEND_ACC_PUBLIC)
+#endif
+#ifdef PHP_HIREDIS_TLS
+    PHP_ME_MAPPING(connectTls,           hiredis_connect_tls,          arginfo_hiredis_connect_tls,          ZEND_ACC_PUBLIC)
+#endif
     PHP_ME_MAPPING(setTimeout,           hiredis_set_timeout,          arginfo_hiredis_set_timeout,          ZEND_ACC_PUBLIC)
     PHP_ME_MAPPING(getTimeout,           hiredis_get_timeout,          arginfo_hiredis_none,                 ZEND_ACC_PUBLIC)
     PHP_ME_MAPPING(setKeepAliveInterval, hiredis_set_keep_alive_int,   arginfo_hiredis_set_keep_alive_int,   ZEND_ACC_PUBLIC)
@@ -890,18 +7383,158 @@ zend_function_entry hiredis_methods[] = {
     PHP_ME_MAPPING(getMaxReadBuf,        hiredis_get_max_read_buf,     arginfo_hiredis_none,                 ZEND_ACC_PUBLIC)
     PHP_ME_MAPPING(setThrowExceptions,   hiredis_set_throw_exceptions, arginfo_hiredis_set_throw_exceptions, ZEND_ACC_PUBLIC)
     PHP_ME_MAPPING(getThrowExceptions,   hiredis_get_throw_exceptions, arginfo_hiredis_none,                 ZEND_ACC_PUBLIC)
+#if PHP_MAJOR_VERSION >= 7
+    PHP_ME_MAPPING(setAutoPipeline,      hiredis_set_auto_pipeline,    arginfo_hiredis_set_auto_pipeline,    ZEND_ACC_PUBLIC)
+    PHP_ME_MAPPING(getAutoPipeline,      hiredis_get_auto_pipeline,    arginfo_hiredis_none,                 ZEND_ACC_PUBLIC)
+    PHP_ME_MAPPING(flush,                hiredis_flush,                arginfo_hiredis_none,                 ZEND_ACC_PUBLIC)
+#ifdef PHP_HIREDIS_BG_READER
+    PHP_ME_MAPPING(setBackgroundReader,  hiredis_set_background_reader, arginfo_hiredis_set_background_reader, ZEND_ACC_PUBLIC)
+#endif
+    PHP_ME_MAPPING(setHedging,           hiredis_set_hedging,          arginfo_hiredis_set_hedging,          ZEND_ACC_PUBLIC)
+    PHP_ME_MAPPING(getHedgeStats,        hiredis_get_hedge_stats,      arginfo_hiredis_none,                 ZEND_ACC_PUBLIC)
+    PHP_ME_MAPPING(setLazyReplies,       hiredis_set_lazy_replies,     arginfo_hiredis_set_lazy_replies,     ZEND_ACC_PUBLIC)
+    PHP_ME_MAPPING(setDecodeHint,        hiredis_set_decode_hint,      arginfo_hiredis_set_decode_hint,      ZEND_ACC_PUBLIC)
+    PHP_ME_MAPPING(decodeNext,           hiredis_decode_next,          arginfo_hiredis_decode_next,          ZEND_ACC_PUBLIC)
+    PHP_ME_MAPPING(cachedGet,            hiredis_cached_get,           arginfo_hiredis_cached_get,           ZEND_ACC_PUBLIC)
+    PHP_ME_MAPPING(cachedHGetAll,        hiredis_cached_hgetall,       arginfo_hiredis_cached_get,           ZEND_ACC_PUBLIC)
+    PHP_ME_MAPPING(cacheInvalidate,      hiredis_cache_invalidate,     arginfo_hiredis_cache_invalidate,     ZEND_ACC_PUBLIC)
+    PHP_ME_MAPPING(mgetChunked,          hiredis_mget_chunked,         arginfo_hiredis_mget_chunked,         ZEND_ACC_PUBLIC)
+    PHP_ME_MAPPING(hmgetChunked,         hiredis_hmget_chunked,        arginfo_hiredis_key_chunked,          ZEND_ACC_PUBLIC)
+    PHP_ME_MAPPING(smismemberChunked,    hiredis_smismember_chunked,   arginfo_hiredis_key_chunked,          ZEND_ACC_PUBLIC)
+    PHP_ME_MAPPING(migrateKeys,          hiredis_migrate_keys,         arginfo_hiredis_migrate_keys,         ZEND_ACC_PUBLIC)
+#endif
+#if PHP_VERSION_ID >= 80100
+    PHP_ME_MAPPING(setFiberScheduler,    hiredis_set_fiber_scheduler,  arginfo_hiredis_set_fiber_scheduler,  ZEND_ACC_PUBLIC)
+#endif
     PHP_ME_MAPPING(sendRaw,              hiredis_send_raw,             arginfo_hiredis_send_raw,             ZEND_ACC_PUBLIC)
     PHP_ME_MAPPING(sendRawArray,         hiredis_send_raw_array,       arginfo_hiredis_send_raw_array,       ZEND_ACC_PUBLIC)
     PHP_ME_MAPPING(appendRaw,            hiredis_append_command,       arginfo_hiredis_send_raw,             ZEND_ACC_PUBLIC)
     PHP_ME_MAPPING(appendRawArray,       hiredis_append_command_array, arginfo_hiredis_send_raw_array,       ZEND_ACC_PUBLIC)
     PHP_ME_MAPPING(getReply,             hiredis_get_reply,            arginfo_hiredis_none,                 ZEND_ACC_PUBLIC)
+    PHP_ME_MAPPING(getToStream,          hiredis_get_to_stream,        arginfo_hiredis_get_to_stream,        ZEND_ACC_PUBLIC)
+    PHP_ME_MAPPING(sendRawArrayToStream, hiredis_send_raw_array_to_stream, arginfo_hiredis_send_raw_array_to_stream, ZEND_ACC_PUBLIC)
     PHP_ME_MAPPING(getLastError,         hiredis_get_last_error,       arginfo_hiredis_none,                 ZEND_ACC_PUBLIC)
+    PHP_ME_MAPPING(getIoStats,           hiredis_get_io_stats,         arginfo_hiredis_none,                 ZEND_ACC_PUBLIC)
+    PHP_ME_MAPPING(getCommandInfo,       hiredis_get_command_info,     arginfo_hiredis_get_command_info,     ZEND_ACC_PUBLIC)
+    PHP_ME_MAPPING(getHotKeys,           hiredis_get_hot_keys,         arginfo_hiredis_get_hot_keys,         ZEND_ACC_PUBLIC)
+    PHP_ME_MAPPING(resetHotKeys,         hiredis_reset_hot_keys,       arginfo_hiredis_none,                 ZEND_ACC_PUBLIC)
 #ifdef HAVE_HIREDIS_RECONNECT
     PHP_ME_MAPPING(reconnect,            hiredis_reconnect,            arginfo_hiredis_none,                 ZEND_ACC_PUBLIC)
 #endif
+#ifdef PHP_HIREDIS_HEALTH
+    PHP_ME_MAPPING(setHealthCheck,       hiredis_set_health_check,     arginfo_hiredis_set_health_check,     ZEND_ACC_PUBLIC)
+#endif
+    PHP_FE_END
+};
+/* }}} */
+
+#if PHP_MAJOR_VERSION >= 7
+/* {{{ hiredis_stream_arg_methods */
+zend_function_entry hiredis_stream_arg_methods[] = {
+    PHP_ME(HiredisStreamArg, __construct, arginfo_hiredis_stream_arg_construct, ZEND_ACC_CTOR | ZEND_ACC_PUBLIC)
+    PHP_FE_END
+};
+/* }}} */
+
+/* {{{ hiredis_lazy_reply_methods */
+zend_function_entry hiredis_lazy_reply_methods[] = {
+    PHP_ME(HiredisLazyReply, offsetExists, arginfo_hiredis_lazy_reply_offset,     ZEND_ACC_PUBLIC)
+    PHP_ME(HiredisLazyReply, offsetGet,    arginfo_hiredis_lazy_reply_offset,     ZEND_ACC_PUBLIC)
+    PHP_ME(HiredisLazyReply, offsetSet,    arginfo_hiredis_lazy_reply_offset_set, ZEND_ACC_PUBLIC)
+    PHP_ME(HiredisLazyReply, offsetUnset,  arginfo_hiredis_lazy_reply_offset,     ZEND_ACC_PUBLIC)
+    PHP_ME(HiredisLazyReply, count,        arginfo_hiredis_none,                  ZEND_ACC_PUBLIC)
+    PHP_ME(HiredisLazyReply, getIterator,  arginfo_hiredis_none,                  ZEND_ACC_PUBLIC)
+    PHP_ME(HiredisLazyReply, toArray,      arginfo_hiredis_none,                  ZEND_ACC_PUBLIC)
+    PHP_FE_END
+};
+/* }}} */
+
+/* {{{ hiredis_stream_consumer_methods */
+zend_function_entry hiredis_stream_consumer_methods[] = {
+    PHP_ME(HiredisStreamConsumer, __construct,    arginfo_hiredis_stream_consumer_construct,    ZEND_ACC_CTOR | ZEND_ACC_PUBLIC)
+    PHP_ME(HiredisStreamConsumer, createGroup,    arginfo_hiredis_stream_consumer_create_group, ZEND_ACC_PUBLIC)
+    PHP_ME(HiredisStreamConsumer, read,           arginfo_hiredis_none,                         ZEND_ACC_PUBLIC)
+    PHP_ME(HiredisStreamConsumer, ack,            arginfo_hiredis_stream_consumer_ack,          ZEND_ACC_PUBLIC)
+    PHP_ME(HiredisStreamConsumer, flushAcks,      arginfo_hiredis_none,                         ZEND_ACC_PUBLIC)
+    PHP_ME(HiredisStreamConsumer, claim,          arginfo_hiredis_stream_consumer_claim,        ZEND_ACC_PUBLIC)
+    PHP_ME(HiredisStreamConsumer, getClaimCursor, arginfo_hiredis_none,                         ZEND_ACC_PUBLIC)
+    PHP_ME(HiredisStreamConsumer, getPendingAcks, arginfo_hiredis_none,                         ZEND_ACC_PUBLIC)
+    PHP_ME(HiredisStreamConsumer, setCount,       arginfo_hiredis_stream_consumer_set_count,    ZEND_ACC_PUBLIC)
+    PHP_ME(HiredisStreamConsumer, setBlock,       arginfo_hiredis_stream_consumer_set_block,    ZEND_ACC_PUBLIC)
+    PHP_ME(HiredisStreamConsumer, setAutoAck,     arginfo_hiredis_stream_consumer_set_auto_ack, ZEND_ACC_PUBLIC)
+    PHP_FE_END
+};
+/* }}} */
+
+/* {{{ hiredis_future_methods */
+zend_function_entry hiredis_future_methods[] = {
+    PHP_ME(HiredisFuture, get,     arginfo_hiredis_none, ZEND_ACC_PUBLIC)
+    PHP_ME(HiredisFuture, isReady, arginfo_hiredis_none, ZEND_ACC_PUBLIC)
     PHP_FE_END
 };
 /* }}} */
+#endif
+
+/* {{{ PHP_INI */
+PHP_INI_BEGIN()
+    STD_PHP_INI_BOOLEAN("hiredis.use_uring", "1", PHP_INI_ALL, OnUpdateBool, use_uring, zend_hiredis_globals, hiredis_globals)
+    STD_PHP_INI_BOOLEAN("hiredis.load_command_table", "1", PHP_INI_ALL, OnUpdateBool, load_command_table, zend_hiredis_globals, hiredis_globals)
+#if PHP_MAJOR_VERSION >= 7
+    STD_PHP_INI_ENTRY("hiredis.shm_cache_size", "0", PHP_INI_SYSTEM, OnUpdateLong, shm_cache_size, zend_hiredis_globals, hiredis_globals)
+    STD_PHP_INI_ENTRY("hiredis.shm_cache_slot_size", "4096", PHP_INI_SYSTEM, OnUpdateLong, shm_cache_slot_size, zend_hiredis_globals, hiredis_globals)
+    STD_PHP_INI_ENTRY("hiredis.shm_cache_lease_ms", "100", PHP_INI_ALL, OnUpdateLong, shm_cache_lease_ms, zend_hiredis_globals, hiredis_globals)
+    STD_PHP_INI_ENTRY("hiredis.intern_max_len", "16", PHP_INI_ALL, OnUpdateLong, intern_max_len, zend_hiredis_globals, hiredis_globals)
+    STD_PHP_INI_ENTRY("hiredis.sentinel_ttl_ms", "1000", PHP_INI_ALL, OnUpdateLong, sentinel_ttl_ms, zend_hiredis_globals, hiredis_globals)
+    STD_PHP_INI_BOOLEAN("hiredis.sentinel_watch", "1", PHP_INI_SYSTEM, OnUpdateBool, sentinel_watch, zend_hiredis_globals, hiredis_globals)
+    STD_PHP_INI_ENTRY("hiredis.health_idle_ms", "0", PHP_INI_ALL, OnUpdateLong, health_idle_ms, zend_hiredis_globals, hiredis_globals)
+#endif
+#ifdef PHP_HIREDIS_TLS
+    STD_PHP_INI_BOOLEAN("hiredis.tls_ktls", "1", PHP_INI_ALL, OnUpdateBool, tls_ktls, zend_hiredis_globals, hiredis_globals)
+#endif
+    STD_PHP_INI_ENTRY("hiredis.hotkeys_sample_rate", "0", PHP_INI_ALL, OnUpdateLong, hotkeys_sample_rate, zend_hiredis_globals, hiredis_globals)
+PHP_INI_END()
+/* }}} */
+
+/* {{{ PHP_GINIT_FUNCTION */
+static PHP_GINIT_FUNCTION(hiredis) {
+    memset(hiredis_globals, 0, sizeof(*hiredis_globals));
+}
+/* }}} */
+
+/* {{{ PHP_GSHUTDOWN_FUNCTION */
+static PHP_GSHUTDOWN_FUNCTION(hiredis) {
+    int i;
+    for (i = 0; i < hiredis_globals->hotkeys_top_len; i++) {
+        pefree(hiredis_globals->hotkeys_top[i].key, 1);
+    }
+    if (hiredis_globals->hotkeys_sketch) {
+        pefree(hiredis_globals->hotkeys_sketch, 1);
+    }
+    if (hiredis_globals->cmd_table) {
+        zend_hash_destroy(hiredis_globals->cmd_table);
+        pefree(hiredis_globals->cmd_table, 1);
+    }
+    #if PHP_MAJOR_VERSION >= 7
+        if (hiredis_globals->sentinel_cache) {
+            zend_hash_destroy(hiredis_globals->sentinel_cache);
+            pefree(hiredis_globals->sentinel_cache, 1);
+        }
+    #endif
+    #ifdef PHP_HIREDIS_TLS
+        if (hiredis_globals->tls_sessions) {
+            zend_hash_destroy(hiredis_globals->tls_sessions);
+            pefree(hiredis_globals->tls_sessions, 1);
+        }
+        if (hiredis_globals->tls_ctxs) {
+            zend_hash_destroy(hiredis_globals->tls_ctxs);
+            pefree(hiredis_globals->tls_ctxs, 1);
+        }
+    #endif
+    #ifdef HAVE_HIREDIS_URING
+        _hiredis_uring_free(hiredis_globals);
+    #endif
+}
+/* }}} */
 
 /* {{{ PHP_MINFO_FUNCTION */
 PHP_MINFO_FUNCTION(hiredis) {
@@ -911,7 +7544,48 @@ PHP_MINFO_FUNCTION(hiredis) {
     php_info_print_table_header(2, "hiredis support", "enabled");
     php_info_print_table_row(2, "hiredis module version", PHP_HIREDIS_VERSION);
     php_info_print_table_row(2, "hiredis version", hiredis_version);
+    #ifdef HAVE_HIREDIS_URING
+        php_info_print_table_row(2, "io_uring backend", "available");
+    #else
+        php_info_print_table_row(2, "io_uring backend", "not available");
+    #endif
+    #ifdef PHP_HIREDIS_TLS
+        #ifdef SSL_OP_ENABLE_KTLS
+            php_info_print_table_row(2, "TLS", "available (kTLS capable)");
+        #else
+            php_info_print_table_row(2, "TLS", "available");
+        #endif
+    #else
+        php_info_print_table_row(2, "TLS", "not available");
+    #endif
+    #if PHP_MAJOR_VERSION >= 7
+        if (hiredis_shm) {
+            char buf[32];
+            php_info_print_table_row(2, "shared cache", "enabled");
+            snprintf(buf, sizeof(buf), "%llu", (unsigned long long)hiredis_shm->hits);
+            php_info_print_table_row(2, "shared cache hits", buf);
+            snprintf(buf, sizeof(buf), "%llu", (unsigned long long)hiredis_shm->misses);
+            php_info_print_table_row(2, "shared cache misses", buf);
+            snprintf(buf, sizeof(buf), "%llu", (unsigned long long)hiredis_shm->stores);
+            php_info_print_table_row(2, "shared cache stores", buf);
+        } else {
+            php_info_print_table_row(2, "shared cache", "disabled");
+        }
+    #endif
     php_info_print_table_end();
+    if (HIREDIS_G(hotkeys_top_len) > 0) {
+        hiredis_hotkey_t* top[PHP_HIREDIS_HOTKEYS_TOPK];
+        char count[16];
+        int i, n;
+        n = _hiredis_hotkeys_sorted(top);
+        php_info_print_table_start();
+        php_info_print_table_header(2, "Hot key (this worker)", "Estimated count");
+        for (i = 0; i < n && i < 10; i++) {
+            snprintf(count, sizeof(count), "%u", top[i]->count);
+            php_info_print_table_row(2, top[i]->key, count);
+        }
+        php_info_print_table_end();
+    }
     DISPLAY_INI_ENTRIES();
 }
 /* }}} */
@@ -920,6 +7594,16 @@ PHP_MINFO_FUNCTION(hiredis) {
 PHP_MINIT_FUNCTION(hiredis) {
     zend_class_entry ce;
 
+    REGISTER_INI_ENTRIES();
+    #ifdef PHP_HIREDIS_TLS
+        redisInitOpenSSL();
+    #endif
+    #if PHP_MAJOR_VERSION >= 7
+        if (HIREDIS_G(shm_cache_size) > 0) {
+            _hiredis_shm_init((size_t)HIREDIS_G(shm_cache_size), (size_t)HIREDIS_G(shm_cache_slot_size));
+        }
+    #endif
+
     // Register Hiredis class
     INIT_CLASS_ENTRY(ce, "Hiredis", hiredis_methods);
     #if PHP_MAJOR_VERSION >= 7
@@ -934,6 +7618,9 @@ PHP_MINIT_FUNCTION(hiredis) {
         hiredis_obj_handlers.offset = XtOffsetOf(hiredis_t, std);
         hiredis_obj_handlers.free_obj = hiredis_obj_free;
     #endif
+    #if PHP_VERSION_ID >= 80100
+        hiredis_obj_handlers.get_gc = hiredis_obj_get_gc;
+    #endif
 
     // Register HiredisException class
     INIT_CLASS_ENTRY(ce, "HiredisException", NULL);
@@ -943,182 +7630,277 @@ PHP_MINIT_FUNCTION(hiredis) {
         hiredis_exception_ce = zend_register_internal_class_ex(&ce, zend_exception_get_default(TSRMLS_C), NULL TSRMLS_CC);
     #endif
 
-    // Init hiredis_cmd_map for __call
-    zend_hash_init(&hiredis_cmd_map, 0, NULL, NULL, 1);
     #if PHP_MAJOR_VERSION >= 7
-        #define PHP_HIREDIS_MAP_CMD(pcmd) \
-            zend_hash_str_add_empty_element(&hiredis_cmd_map, (pcmd), sizeof((pcmd))-1);
+        // Register HiredisFuture class
+        INIT_CLASS_ENTRY(ce, "HiredisFuture", hiredis_future_methods);
+        hiredis_future_ce = zend_register_internal_class(&ce);
+        hiredis_future_ce->ce_flags |= ZEND_ACC_FINAL;
+        hiredis_future_ce->create_object = hiredis_future_obj_new;
+        memcpy(&hiredis_future_obj_handlers, zend_get_std_object_handlers(), sizeof(hiredis_future_obj_handlers));
+        hiredis_future_obj_handlers.offset = XtOffsetOf(hiredis_future_t, std);
+        hiredis_future_obj_handlers.free_obj = hiredis_future_obj_free;
+        hiredis_future_obj_handlers.clone_obj = NULL;
+
+        // Register HiredisStreamArg class
+        INIT_CLASS_ENTRY(ce, "HiredisStreamArg", hiredis_stream_arg_methods);
+        hiredis_stream_arg_ce = zend_register_internal_class(&ce);
+        hiredis_stream_arg_ce->ce_flags |= ZEND_ACC_FINAL;
+        hiredis_stream_arg_ce->create_object = hiredis_stream_arg_obj_new;
+        memcpy(&hiredis_stream_arg_obj_handlers, zend_get_std_object_handlers(), sizeof(hiredis_stream_arg_obj_handlers));
+        hiredis_stream_arg_obj_handlers.offset = XtOffsetOf(hiredis_stream_arg_t, std);
+        hiredis_stream_arg_obj_handlers.free_obj = hiredis_stream_arg_obj_free;
+        hiredis_stream_arg_obj_handlers.clone_obj = NULL;
+
+        // Register HiredisLazyReply class. get_iterator is set before the
+        // interfaces so IteratorAggregate keeps it for foreach.
+        INIT_CLASS_ENTRY(ce, "HiredisLazyReply", hiredis_lazy_reply_methods);
+        hiredis_lazy_reply_ce = zend_register_internal_class(&ce);
+        hiredis_lazy_reply_ce->ce_flags |= ZEND_ACC_FINAL;
+        hiredis_lazy_reply_ce->create_object = hiredis_lazy_reply_obj_new;
+        hiredis_lazy_reply_ce->get_iterator = hiredis_lazy_reply_get_iterator;
+        #if PHP_VERSION_ID >= 70200
+            zend_class_implements(hiredis_lazy_reply_ce, 3, zend_ce_arrayaccess, zend_ce_countable, zend_ce_aggregate);
+        #else
+            zend_class_implements(hiredis_lazy_reply_ce, 2, zend_ce_arrayaccess, zend_ce_aggregate);
+        #endif
+        memcpy(&hiredis_lazy_reply_obj_handlers, zend_get_std_object_handlers(), sizeof(hiredis_lazy_reply_obj_handlers));
+        hiredis_lazy_reply_obj_handlers.offset = XtOffsetOf(hiredis_lazy_reply_t, std);
+        hiredis_lazy_reply_obj_handlers.free_obj = hiredis_lazy_reply_obj_free;
+        hiredis_lazy_reply_obj_handlers.clone_obj = NULL;
+        hiredis_lazy_reply_obj_handlers.read_dimension = hiredis_lazy_reply_read_dimension;
+        hiredis_lazy_reply_obj_handlers.has_dimension = hiredis_lazy_reply_has_dimension;
+        hiredis_lazy_reply_obj_handlers.count_elements = hiredis_lazy_reply_count_elements;
+
+        // Register HiredisStreamConsumer class
+        INIT_CLASS_ENTRY(ce, "HiredisStreamConsumer", hiredis_stream_consumer_methods);
+        hiredis_stream_consumer_ce = zend_register_internal_class(&ce);
+        hiredis_stream_consumer_ce->ce_flags |= ZEND_ACC_FINAL;
+        hiredis_stream_consumer_ce->create_object = hiredis_stream_consumer_obj_new;
+        memcpy(&hiredis_stream_consumer_obj_handlers, zend_get_std_object_handlers(), sizeof(hiredis_stream_consumer_obj_handlers));
+        hiredis_stream_consumer_obj_handlers.offset = XtOffsetOf(hiredis_stream_consumer_t, std);
+        hiredis_stream_consumer_obj_handlers.free_obj = hiredis_stream_consumer_obj_free;
+        hiredis_stream_consumer_obj_handlers.clone_obj = NULL;
+    #endif
+
+    // Init hiredis_cmd_map for __call. This is the fallback table; each
+    // worker replaces it with the server's COMMAND reply on first connect.
+    #if PHP_MAJOR_VERSION >= 7
+        zend_hash_init(&hiredis_cmd_map, 256, NULL, _hiredis_cmd_info_dtor, 1);
+        #define PHP_HIREDIS_MAP_CMD(pcmd, parity, pflags, pfirst, plast, pstep) do { \
+            hiredis_cmd_info_t _info = { (parity), (pflags), (pfirst), (plast), (pstep) }; \
+            zend_hash_str_add_mem(&hiredis_cmd_map, (pcmd), sizeof((pcmd))-1, &_info, sizeof(_info)); \
+        } while (0)
     #else
-        #define PHP_HIREDIS_MAP_CMD(pcmd) \
-            zend_hash_add_empty_element(&hiredis_cmd_map, (pcmd), sizeof((pcmd))-1);
-    #endif
-    PHP_HIREDIS_MAP_CMD("APPEND");
-    PHP_HIREDIS_MAP_CMD("AUTH");
-    PHP_HIREDIS_MAP_CMD("BGREWRITEAOF");
-    PHP_HIREDIS_MAP_CMD("BGSAVE");
-    PHP_HIREDIS_MAP_CMD("BITCOUNT");
-    PHP_HIREDIS_MAP_CMD("BITOP");
-    PHP_HIREDIS_MAP_CMD("BITPOS");
-    PHP_HIREDIS_MAP_CMD("BLPOP");
-    PHP_HIREDIS_MAP_CMD("BRPOP");
-    PHP_HIREDIS_MAP_CMD("BRPOPLPUSH");
-    PHP_HIREDIS_MAP_CMD("CLIENT");
-    PHP_HIREDIS_MAP_CMD("CLUSTER");
-    PHP_HIREDIS_MAP_CMD("COMMAND");
-    PHP_HIREDIS_MAP_CMD("CONFIG");
-    PHP_HIREDIS_MAP_CMD("DBSIZE");
-    PHP_HIREDIS_MAP_CMD("DEBUG");
-    PHP_HIREDIS_MAP_CMD("DECR");
-    PHP_HIREDIS_MAP_CMD("DECRBY");
-    PHP_HIREDIS_MAP_CMD("DEL");
-    PHP_HIREDIS_MAP_CMD("DISCARD");
-    PHP_HIREDIS_MAP_CMD("DUMP");
-    PHP_HIREDIS_MAP_CMD("ECHO");
-    PHP_HIREDIS_MAP_CMD("EVAL");
-    PHP_HIREDIS_MAP_CMD("EVALSHA");
-    PHP_HIREDIS_MAP_CMD("EXEC");
-    PHP_HIREDIS_MAP_CMD("EXISTS");
-    PHP_HIREDIS_MAP_CMD("EXPIRE");
-    PHP_HIREDIS_MAP_CMD("EXPIREAT");
-    PHP_HIREDIS_MAP_CMD("FLUSHALL");
-    PHP_HIREDIS_MAP_CMD("FLUSHDB");
-    PHP_HIREDIS_MAP_CMD("GEOADD");
-    PHP_HIREDIS_MAP_CMD("GEODIST");
-    PHP_HIREDIS_MAP_CMD("GEOHASH");
-    PHP_HIREDIS_MAP_CMD("GEOPOS");
-    PHP_HIREDIS_MAP_CMD("GEORADIUS");
-    PHP_HIREDIS_MAP_CMD("GEORADIUSBYMEMBER");
-    PHP_HIREDIS_MAP_CMD("GET");
-    PHP_HIREDIS_MAP_CMD("GETBIT");
-    PHP_HIREDIS_MAP_CMD("GETRANGE");
-    PHP_HIREDIS_MAP_CMD("GETSET");
-    PHP_HIREDIS_MAP_CMD("HDEL");
-    PHP_HIREDIS_MAP_CMD("HEXISTS");
-    PHP_HIREDIS_MAP_CMD("HGET");
-    PHP_HIREDIS_MAP_CMD("HGETALL");
-    PHP_HIREDIS_MAP_CMD("HINCRBY");
-    PHP_HIREDIS_MAP_CMD("HINCRBYFLOAT");
-    PHP_HIREDIS_MAP_CMD("HKEYS");
-    PHP_HIREDIS_MAP_CMD("HLEN");
-    PHP_HIREDIS_MAP_CMD("HMGET");
-    PHP_HIREDIS_MAP_CMD("HMSET");
-    PHP_HIREDIS_MAP_CMD("HSCAN");
-    PHP_HIREDIS_MAP_CMD("HSET");
-    PHP_HIREDIS_MAP_CMD("HSETNX");
-    PHP_HIREDIS_MAP_CMD("HSTRLEN");
-    PHP_HIREDIS_MAP_CMD("HVALS");
-    PHP_HIREDIS_MAP_CMD("INCR");
-    PHP_HIREDIS_MAP_CMD("INCRBY");
-    PHP_HIREDIS_MAP_CMD("INCRBYFLOAT");
-    PHP_HIREDIS_MAP_CMD("INFO");
-    PHP_HIREDIS_MAP_CMD("KEYS");
-    PHP_HIREDIS_MAP_CMD("LASTSAVE");
-    PHP_HIREDIS_MAP_CMD("LINDEX");
-    PHP_HIREDIS_MAP_CMD("LINSERT");
-    PHP_HIREDIS_MAP_CMD("LLEN");
-    PHP_HIREDIS_MAP_CMD("LPOP");
-    PHP_HIREDIS_MAP_CMD("LPUSH");
-    PHP_HIREDIS_MAP_CMD("LPUSHX");
-    PHP_HIREDIS_MAP_CMD("LRANGE");
-    PHP_HIREDIS_MAP_CMD("LREM");
-    PHP_HIREDIS_MAP_CMD("LSET");
-    PHP_HIREDIS_MAP_CMD("LTRIM");
-    PHP_HIREDIS_MAP_CMD("MGET");
-    PHP_HIREDIS_MAP_CMD("MIGRATE");
-    PHP_HIREDIS_MAP_CMD("MONITOR");
-    PHP_HIREDIS_MAP_CMD("MOVE");
-    PHP_HIREDIS_MAP_CMD("MSET");
-    PHP_HIREDIS_MAP_CMD("MSETNX");
-    PHP_HIREDIS_MAP_CMD("MULTI");
-    PHP_HIREDIS_MAP_CMD("OBJECT");
-    PHP_HIREDIS_MAP_CMD("PERSIST");
-    PHP_HIREDIS_MAP_CMD("PEXPIRE");
-    PHP_HIREDIS_MAP_CMD("PEXPIREAT");
-    PHP_HIREDIS_MAP_CMD("PFADD");
-    PHP_HIREDIS_MAP_CMD("PFCOUNT");
-    PHP_HIREDIS_MAP_CMD("PFMERGE");
-    PHP_HIREDIS_MAP_CMD("PING");
-    PHP_HIREDIS_MAP_CMD("PSETEX");
-    PHP_HIREDIS_MAP_CMD("PSUBSCRIBE");
-    PHP_HIREDIS_MAP_CMD("PTTL");
-    PHP_HIREDIS_MAP_CMD("PUBLISH");
-    PHP_HIREDIS_MAP_CMD("PUBSUB");
-    PHP_HIREDIS_MAP_CMD("PUNSUBSCRIBE");
-    PHP_HIREDIS_MAP_CMD("QUIT");
-    PHP_HIREDIS_MAP_CMD("RANDOMKEY");
-    PHP_HIREDIS_MAP_CMD("RENAME");
-    PHP_HIREDIS_MAP_CMD("RENAMENX");
-    PHP_HIREDIS_MAP_CMD("RESTORE");
-    PHP_HIREDIS_MAP_CMD("ROLE");
-    PHP_HIREDIS_MAP_CMD("RPOP");
-    PHP_HIREDIS_MAP_CMD("RPOPLPUSH");
-    PHP_HIREDIS_MAP_CMD("RPUSH");
-    PHP_HIREDIS_MAP_CMD("RPUSHX");
-    PHP_HIREDIS_MAP_CMD("SADD");
-    PHP_HIREDIS_MAP_CMD("SAVE");
-    PHP_HIREDIS_MAP_CMD("SCAN");
-    PHP_HIREDIS_MAP_CMD("SCARD");
-    PHP_HIREDIS_MAP_CMD("SCRIPT");
-    PHP_HIREDIS_MAP_CMD("SDIFF");
-    PHP_HIREDIS_MAP_CMD("SDIFFSTORE");
-    PHP_HIREDIS_MAP_CMD("SELECT");
-    PHP_HIREDIS_MAP_CMD("SET");
-    PHP_HIREDIS_MAP_CMD("SETBIT");
-    PHP_HIREDIS_MAP_CMD("SETEX");
-    PHP_HIREDIS_MAP_CMD("SETNX");
-    PHP_HIREDIS_MAP_CMD("SETRANGE");
-    PHP_HIREDIS_MAP_CMD("SHUTDOWN");
-    PHP_HIREDIS_MAP_CMD("SINTER");
-    PHP_HIREDIS_MAP_CMD("SINTERSTORE");
-    PHP_HIREDIS_MAP_CMD("SISMEMBER");
-    PHP_HIREDIS_MAP_CMD("SLAVEOF");
-    PHP_HIREDIS_MAP_CMD("SLOWLOG");
-    PHP_HIREDIS_MAP_CMD("SMEMBERS");
-    PHP_HIREDIS_MAP_CMD("SMOVE");
-    PHP_HIREDIS_MAP_CMD("SORT");
-    PHP_HIREDIS_MAP_CMD("SPOP");
-    PHP_HIREDIS_MAP_CMD("SRANDMEMBER");
-    PHP_HIREDIS_MAP_CMD("SREM");
-    PHP_HIREDIS_MAP_CMD("SSCAN");
-    PHP_HIREDIS_MAP_CMD("STRLEN");
-    PHP_HIREDIS_MAP_CMD("SUBSCRIBE");
-    PHP_HIREDIS_MAP_CMD("SUNION");
-    PHP_HIREDIS_MAP_CMD("SUNIONSTORE");
-    PHP_HIREDIS_MAP_CMD("SYNC");
-    PHP_HIREDIS_MAP_CMD("TIME");
-    PHP_HIREDIS_MAP_CMD("TTL");
-    PHP_HIREDIS_MAP_CMD("TYPE");
-    PHP_HIREDIS_MAP_CMD("UNSUBSCRIBE");
-    PHP_HIREDIS_MAP_CMD("UNWATCH");
-    PHP_HIREDIS_MAP_CMD("WAIT");
-    PHP_HIREDIS_MAP_CMD("WATCH");
-    PHP_HIREDIS_MAP_CMD("ZADD");
-    PHP_HIREDIS_MAP_CMD("ZCARD");
-    PHP_HIREDIS_MAP_CMD("ZCOUNT");
-    PHP_HIREDIS_MAP_CMD("ZINCRBY");
-    PHP_HIREDIS_MAP_CMD("ZINTERSTORE");
-    PHP_HIREDIS_MAP_CMD("ZLEXCOUNT");
-    PHP_HIREDIS_MAP_CMD("ZRANGE");
-    PHP_HIREDIS_MAP_CMD("ZRANGEBYLEX");
-    PHP_HIREDIS_MAP_CMD("ZRANGEBYSCORE");
-    PHP_HIREDIS_MAP_CMD("ZRANK");
-    PHP_HIREDIS_MAP_CMD("ZREM");
-    PHP_HIREDIS_MAP_CMD("ZREMRANGEBYLEX");
-    PHP_HIREDIS_MAP_CMD("ZREMRANGEBYRANK");
-    PHP_HIREDIS_MAP_CMD("ZREMRANGEBYSCORE");
-    PHP_HIREDIS_MAP_CMD("ZREVRANGE");
-    PHP_HIREDIS_MAP_CMD("ZREVRANGEBYLEX");
-    PHP_HIREDIS_MAP_CMD("ZREVRANGEBYSCORE");
-    PHP_HIREDIS_MAP_CMD("ZREVRANK");
-    PHP_HIREDIS_MAP_CMD("ZSCAN");
-    PHP_HIREDIS_MAP_CMD("ZSCORE");
-    PHP_HIREDIS_MAP_CMD("ZUNIONSTORE");
+        zend_hash_init(&hiredis_cmd_map, 256, NULL, NULL, 1);
+        #define PHP_HIREDIS_MAP_CMD(pcmd, parity, pflags, pfirst, plast, pstep) do { \
+            hiredis_cmd_info_t _info = { (parity), (pflags), (pfirst), (plast), (pstep) }; \
+            zend_hash_add(&hiredis_cmd_map, (pcmd), sizeof((pcmd))-1, &_info, sizeof(_info), NULL); \
+        } while (0)
+    #endif
+    PHP_HIREDIS_MAP_CMD("APPEND", 3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("AUTH", -2, PHP_HIREDIS_CMD_NOSCRIPT|PHP_HIREDIS_CMD_FAST, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("BGREWRITEAOF", 1, PHP_HIREDIS_CMD_ADMIN, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("BGSAVE", -1, PHP_HIREDIS_CMD_ADMIN, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("BITCOUNT", -2, PHP_HIREDIS_CMD_READONLY, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("BITOP", -4, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM, 2, -1, 1);
+    PHP_HIREDIS_MAP_CMD("BITPOS", -3, PHP_HIREDIS_CMD_READONLY, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("BLPOP", -3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_NOSCRIPT|PHP_HIREDIS_CMD_BLOCKING, 1, -2, 1);
+    PHP_HIREDIS_MAP_CMD("BRPOP", -3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_NOSCRIPT|PHP_HIREDIS_CMD_BLOCKING, 1, -2, 1);
+    PHP_HIREDIS_MAP_CMD("BRPOPLPUSH", 4, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM|PHP_HIREDIS_CMD_NOSCRIPT|PHP_HIREDIS_CMD_BLOCKING, 1, 2, 1);
+    PHP_HIREDIS_MAP_CMD("CLIENT", -2, PHP_HIREDIS_CMD_ADMIN|PHP_HIREDIS_CMD_NOSCRIPT, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("CLUSTER", -2, PHP_HIREDIS_CMD_ADMIN, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("COMMAND", -1, PHP_HIREDIS_CMD_RANDOM, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("CONFIG", -2, PHP_HIREDIS_CMD_ADMIN, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("DBSIZE", 1, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_FAST, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("DEBUG", -2, PHP_HIREDIS_CMD_ADMIN|PHP_HIREDIS_CMD_NOSCRIPT, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("DECR", 2, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("DECRBY", 3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("DEL", -2, PHP_HIREDIS_CMD_WRITE, 1, -1, 1);
+    PHP_HIREDIS_MAP_CMD("DISCARD", 1, PHP_HIREDIS_CMD_NOSCRIPT|PHP_HIREDIS_CMD_FAST, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("DUMP", 2, PHP_HIREDIS_CMD_READONLY, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("ECHO", 2, PHP_HIREDIS_CMD_FAST, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("EVAL", -3, PHP_HIREDIS_CMD_NOSCRIPT|PHP_HIREDIS_CMD_MOVABLEKEYS, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("EVALSHA", -3, PHP_HIREDIS_CMD_NOSCRIPT|PHP_HIREDIS_CMD_MOVABLEKEYS, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("EXEC", 1, PHP_HIREDIS_CMD_NOSCRIPT, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("EXISTS", -2, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_FAST, 1, -1, 1);
+    PHP_HIREDIS_MAP_CMD("EXPIRE", 3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("EXPIREAT", 3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("FLUSHALL", -1, PHP_HIREDIS_CMD_WRITE, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("FLUSHDB", -1, PHP_HIREDIS_CMD_WRITE, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("GEOADD", -5, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("GEODIST", -4, PHP_HIREDIS_CMD_READONLY, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("GEOHASH", -2, PHP_HIREDIS_CMD_READONLY, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("GEOPOS", -2, PHP_HIREDIS_CMD_READONLY, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("GEORADIUS", -6, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_MOVABLEKEYS, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("GEORADIUSBYMEMBER", -5, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_MOVABLEKEYS, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("GET", 2, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("GETBIT", 3, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("GETRANGE", 4, PHP_HIREDIS_CMD_READONLY, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("GETSET", 3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("HDEL", -3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("HEXISTS", 3, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("HGET", 3, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("HGETALL", 2, PHP_HIREDIS_CMD_READONLY, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("HINCRBY", 4, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("HINCRBYFLOAT", 4, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("HKEYS", 2, PHP_HIREDIS_CMD_READONLY, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("HLEN", 2, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("HMGET", -3, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("HMSET", -4, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("HSCAN", -3, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_RANDOM, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("HSET", -4, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("HSETNX", 4, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("HSTRLEN", 3, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("HVALS", 2, PHP_HIREDIS_CMD_READONLY, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("INCR", 2, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("INCRBY", 3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("INCRBYFLOAT", 3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("INFO", -1, PHP_HIREDIS_CMD_RANDOM, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("KEYS", 2, PHP_HIREDIS_CMD_READONLY, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("LASTSAVE", 1, PHP_HIREDIS_CMD_FAST|PHP_HIREDIS_CMD_RANDOM, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("LINDEX", 3, PHP_HIREDIS_CMD_READONLY, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("LINSERT", 5, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("LLEN", 2, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("LPOP", -2, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("LPUSH", -3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("LPUSHX", -3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("LRANGE", 4, PHP_HIREDIS_CMD_READONLY, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("LREM", 4, PHP_HIREDIS_CMD_WRITE, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("LSET", 4, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("LTRIM", 4, PHP_HIREDIS_CMD_WRITE, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("MGET", -2, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_FAST, 1, -1, 1);
+    PHP_HIREDIS_MAP_CMD("MIGRATE", -6, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_MOVABLEKEYS, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("MONITOR", 1, PHP_HIREDIS_CMD_ADMIN|PHP_HIREDIS_CMD_NOSCRIPT, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("MOVE", 3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("MSET", -3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM, 1, -1, 2);
+    PHP_HIREDIS_MAP_CMD("MSETNX", -3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM, 1, -1, 2);
+    PHP_HIREDIS_MAP_CMD("MULTI", 1, PHP_HIREDIS_CMD_NOSCRIPT|PHP_HIREDIS_CMD_FAST, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("OBJECT", -2, PHP_HIREDIS_CMD_READONLY, 2, 2, 1);
+    PHP_HIREDIS_MAP_CMD("PERSIST", 2, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("PEXPIRE", 3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("PEXPIREAT", 3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("PFADD", -2, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("PFCOUNT", -2, PHP_HIREDIS_CMD_READONLY, 1, -1, 1);
+    PHP_HIREDIS_MAP_CMD("PFMERGE", -2, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM, 1, -1, 1);
+    PHP_HIREDIS_MAP_CMD("PING", -1, PHP_HIREDIS_CMD_FAST, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("PSETEX", 4, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("PSUBSCRIBE", -2, PHP_HIREDIS_CMD_PUBSUB|PHP_HIREDIS_CMD_NOSCRIPT, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("PTTL", 2, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("PUBLISH", 3, PHP_HIREDIS_CMD_PUBSUB|PHP_HIREDIS_CMD_FAST, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("PUBSUB", -2, PHP_HIREDIS_CMD_PUBSUB, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("PUNSUBSCRIBE", -1, PHP_HIREDIS_CMD_PUBSUB|PHP_HIREDIS_CMD_NOSCRIPT, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("QUIT", -1, 0, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("RANDOMKEY", 1, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_RANDOM, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("RENAME", 3, PHP_HIREDIS_CMD_WRITE, 1, 2, 1);
+    PHP_HIREDIS_MAP_CMD("RENAMENX", 3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_FAST, 1, 2, 1);
+    PHP_HIREDIS_MAP_CMD("RESTORE", -4, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("ROLE", 1, PHP_HIREDIS_CMD_NOSCRIPT|PHP_HIREDIS_CMD_FAST, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("RPOP", -2, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("RPOPLPUSH", 3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM, 1, 2, 1);
+    PHP_HIREDIS_MAP_CMD("RPUSH", -3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("RPUSHX", -3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("SADD", -3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("SAVE", 1, PHP_HIREDIS_CMD_ADMIN|PHP_HIREDIS_CMD_NOSCRIPT, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("SCAN", -2, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_RANDOM, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("SCARD", 2, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("SCRIPT", -2, PHP_HIREDIS_CMD_NOSCRIPT, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("SDIFF", -2, PHP_HIREDIS_CMD_READONLY, 1, -1, 1);
+    PHP_HIREDIS_MAP_CMD("SDIFFSTORE", -3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM, 1, -1, 1);
+    PHP_HIREDIS_MAP_CMD("SELECT", 2, PHP_HIREDIS_CMD_FAST, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("SET", -3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("SETBIT", 4, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("SETEX", 4, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("SETNX", 3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("SETRANGE", 4, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("SHUTDOWN", -1, PHP_HIREDIS_CMD_ADMIN|PHP_HIREDIS_CMD_NOSCRIPT, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("SINTER", -2, PHP_HIREDIS_CMD_READONLY, 1, -1, 1);
+    PHP_HIREDIS_MAP_CMD("SINTERSTORE", -3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM, 1, -1, 1);
+    PHP_HIREDIS_MAP_CMD("SISMEMBER", 3, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("SLAVEOF", 3, PHP_HIREDIS_CMD_ADMIN|PHP_HIREDIS_CMD_NOSCRIPT, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("SLOWLOG", -2, PHP_HIREDIS_CMD_ADMIN, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("SMEMBERS", 2, PHP_HIREDIS_CMD_READONLY, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("SMOVE", 4, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_FAST, 1, 2, 1);
+    PHP_HIREDIS_MAP_CMD("SORT", -2, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM|PHP_HIREDIS_CMD_MOVABLEKEYS, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("SPOP", -2, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_FAST|PHP_HIREDIS_CMD_RANDOM, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("SRANDMEMBER", -2, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_RANDOM, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("SREM", -3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("SSCAN", -3, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_RANDOM, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("STRLEN", 2, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("SUBSCRIBE", -2, PHP_HIREDIS_CMD_PUBSUB|PHP_HIREDIS_CMD_NOSCRIPT, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("SUNION", -2, PHP_HIREDIS_CMD_READONLY, 1, -1, 1);
+    PHP_HIREDIS_MAP_CMD("SUNIONSTORE", -3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM, 1, -1, 1);
+    PHP_HIREDIS_MAP_CMD("SYNC", 1, PHP_HIREDIS_CMD_ADMIN|PHP_HIREDIS_CMD_NOSCRIPT, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("TIME", 1, PHP_HIREDIS_CMD_FAST|PHP_HIREDIS_CMD_RANDOM, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("TTL", 2, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("TYPE", 2, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("UNSUBSCRIBE", -1, PHP_HIREDIS_CMD_PUBSUB|PHP_HIREDIS_CMD_NOSCRIPT, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("UNWATCH", 1, PHP_HIREDIS_CMD_NOSCRIPT|PHP_HIREDIS_CMD_FAST, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("WAIT", 3, PHP_HIREDIS_CMD_NOSCRIPT, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("WATCH", -2, PHP_HIREDIS_CMD_NOSCRIPT|PHP_HIREDIS_CMD_FAST, 1, -1, 1);
+    PHP_HIREDIS_MAP_CMD("XACK", -4, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("XADD", -5, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM|PHP_HIREDIS_CMD_RANDOM|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("XAUTOCLAIM", -6, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_RANDOM|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("XCLAIM", -6, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_RANDOM|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("XDEL", -3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("XGROUP", -2, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM, 2, 2, 1);
+    PHP_HIREDIS_MAP_CMD("XINFO", -2, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_RANDOM, 2, 2, 1);
+    PHP_HIREDIS_MAP_CMD("XLEN", 2, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("XPENDING", -3, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_RANDOM, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("XRANGE", -4, PHP_HIREDIS_CMD_READONLY, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("XREAD", -4, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_BLOCKING|PHP_HIREDIS_CMD_MOVABLEKEYS, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("XREADGROUP", -7, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_BLOCKING|PHP_HIREDIS_CMD_MOVABLEKEYS, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("XREVRANGE", -4, PHP_HIREDIS_CMD_READONLY, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("XSETID", 3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("XTRIM", -4, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_RANDOM, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("ZADD", -4, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("ZCARD", 2, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("ZCOUNT", 4, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("ZINCRBY", 4, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("ZINTERSTORE", -4, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM|PHP_HIREDIS_CMD_MOVABLEKEYS, 0, 0, 0);
+    PHP_HIREDIS_MAP_CMD("ZLEXCOUNT", 4, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("ZRANGE", -4, PHP_HIREDIS_CMD_READONLY, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("ZRANGEBYLEX", -4, PHP_HIREDIS_CMD_READONLY, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("ZRANGEBYSCORE", -4, PHP_HIREDIS_CMD_READONLY, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("ZRANK", 3, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("ZREM", -3, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("ZREMRANGEBYLEX", 4, PHP_HIREDIS_CMD_WRITE, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("ZREMRANGEBYRANK", 4, PHP_HIREDIS_CMD_WRITE, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("ZREMRANGEBYSCORE", 4, PHP_HIREDIS_CMD_WRITE, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("ZREVRANGE", -4, PHP_HIREDIS_CMD_READONLY, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("ZREVRANGEBYLEX", -4, PHP_HIREDIS_CMD_READONLY, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("ZREVRANGEBYSCORE", -4, PHP_HIREDIS_CMD_READONLY, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("ZREVRANK", 3, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("ZSCAN", -3, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_RANDOM, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("ZSCORE", 3, PHP_HIREDIS_CMD_READONLY|PHP_HIREDIS_CMD_FAST, 1, 1, 1);
+    PHP_HIREDIS_MAP_CMD("ZUNIONSTORE", -4, PHP_HIREDIS_CMD_WRITE|PHP_HIREDIS_CMD_DENYOOM|PHP_HIREDIS_CMD_MOVABLEKEYS, 0, 0, 0);
     #undef PHP_HIREDIS_MAP_CMD
+
+    return SUCCESS;
+}
+/* }}} */
+
+/* {{{ PHP_RSHUTDOWN_FUNCTION */
+PHP_RSHUTDOWN_FUNCTION(hiredis) {
+    #if PHP_MAJOR_VERSION >= 7
+        if (HIREDIS_G(intern_table)) {
+            zend_hash_destroy(HIREDIS_G(intern_table));
+            FREE_HASHTABLE(HIREDIS_G(intern_table));
+            HIREDIS_G(intern_table) = NULL;
+        }
+    #endif
+    return SUCCESS;
 }
 /* }}} */
 
 /* {{{ PHP_MSHUTDOWN_FUNCTION */
 PHP_MSHUTDOWN_FUNCTION(hiredis) {
+    UNREGISTER_INI_ENTRIES();
+    #ifdef PHP_HIREDIS_BG_READER
+        _hiredis_sentinel_watch_stop();
+    #endif
+    #if PHP_MAJOR_VERSION >= 7
+        _hiredis_shm_free();
+    #endif
     zend_hash_destroy(&hiredis_cmd_map);
     return SUCCESS;
 }
@@ -1132,10 +7914,14 @@ zend_module_entry hiredis_module_entry = {
     PHP_MINIT(hiredis),
     PHP_MSHUTDOWN(hiredis),
     NULL,
-    NULL,
+    PHP_RSHUTDOWN(hiredis),
     PHP_MINFO(hiredis),
     PHP_HIREDIS_VERSION,
-    STANDARD_MODULE_PROPERTIES
+    PHP_MODULE_GLOBALS(hiredis),
+    PHP_GINIT(hiredis),
+    PHP_GSHUTDOWN(hiredis),
+    NULL,
+    STANDARD_MODULE_PROPERTIES_EX
 };
 /* }}} */
 
@@ -26,6 +26,23 @@
 
 #include <hiredis.h>
 
+#ifdef HAVE_HIREDIS_THREADS
+#include <pthread.h>
+#endif
+
+#ifdef HAVE_HIREDIS_URING
+#include <liburing.h>
+#endif
+
+#ifdef HAVE_HIREDIS_SSL
+#include <hiredis_ssl.h>
+#include <openssl/ssl.h>
+#endif
+
+typedef struct _hiredis_future_t hiredis_future_t;
+typedef struct _hiredis_bg_t hiredis_bg_t;
+typedef struct _hiredis_hedge_t hiredis_hedge_t;
+
 typedef struct {
 #if PHP_MAJOR_VERSION < 7
     zend_object std;
@@ -37,11 +54,188 @@ typedef struct {
     int throw_exceptions;
     int err;
     char errstr[128];
+    zval* reply_root;
+    int reply_is_error;
+    int auto_pipeline;
+    int raw_pending;
+    hiredis_future_t** pending;
+    int pending_len;
+    int pending_cap;
+    HashTable* sf_map;
+    hiredis_bg_t* bg;
+    int bg_enabled;
+    hiredis_hedge_t* hedge;
+    int hedge_discard;
+    char* sentinel_name;
+    size_t sentinel_name_len;
+#ifdef HAVE_HIREDIS_SSL
+    SSL_CTX* tls_ctx;
+    SSL* tls_ssl;
+    char* tls_key;
+    char* tls_name;
+    int tls_verify;
+#endif
+    long lazy_min;
+    uint32_t* lazy_offsets;
+    long lazy_count;
+    long lazy_done;
+    size_t lazy_off;
+    long decode_hint;
+    long decode_next;
+    HashTable* decode_hints;
+    long health_idle_ms;
+    uint64_t health_last_ms;
+    int health_in_tx;
+    HashTable* session_cmds;
+    long health_checks;
+    long health_reconnects;
+    int io_uring;
+    long io_syscalls;
+    long io_replies;
+#if PHP_VERSION_ID >= 80100
+    zval fiber_scheduler;
+    zval fiber_stream;
+    int fiber_stream_fd;
+    zend_fiber* fiber_owner;
+#endif
 #if PHP_MAJOR_VERSION >= 7
     zend_object std;
 #endif
 } hiredis_t;
 
+#define PHP_HIREDIS_CMD_WRITE       (1<<0)
+#define PHP_HIREDIS_CMD_READONLY    (1<<1)
+#define PHP_HIREDIS_CMD_DENYOOM     (1<<2)
+#define PHP_HIREDIS_CMD_ADMIN       (1<<3)
+#define PHP_HIREDIS_CMD_PUBSUB      (1<<4)
+#define PHP_HIREDIS_CMD_NOSCRIPT    (1<<5)
+#define PHP_HIREDIS_CMD_FAST        (1<<6)
+#define PHP_HIREDIS_CMD_MOVABLEKEYS (1<<7)
+#define PHP_HIREDIS_CMD_BLOCKING    (1<<8)
+#define PHP_HIREDIS_CMD_RANDOM      (1<<9)
+#define PHP_HIREDIS_CMD_LOADED      (1<<15)
+
+/* Reply decode hints. NUMERIC and DOUBLE turn bulk strings into numbers;
+   with MAP only the values of the flat pair array are converted and the
+   pairs become key => value. */
+#define PHP_HIREDIS_DECODE_NUMERIC (1<<0)
+#define PHP_HIREDIS_DECODE_DOUBLE  (1<<1)
+#define PHP_HIREDIS_DECODE_MAP     (1<<2)
+#define PHP_HIREDIS_DECODE_INFO    (1<<3)
+
+/* Command metadata as reported by COMMAND. Negative arity means "at least
+   -arity args"; a negative last_key counts back from the last arg. */
+typedef struct {
+    short arity;
+    unsigned short flags;
+    short first_key;
+    short last_key;
+    short key_step;
+} hiredis_cmd_info_t;
+
+#if PHP_MAJOR_VERSION >= 7
+#define PHP_HIREDIS_FUTURE_PENDING 0
+#define PHP_HIREDIS_FUTURE_READY   1
+#define PHP_HIREDIS_FUTURE_FAILED  2
+
+struct _hiredis_future_t {
+    zval client;
+    zval value;
+    int state;
+    int slot;
+    uint32_t* fanout;
+    int fanout_len;
+    zend_object std;
+};
+
+typedef struct {
+    zval stream;
+    zend_long length;
+    zend_object std;
+} hiredis_stream_arg_t;
+
+/* Array reply kept as raw RESP. offsets has count + 1 entries, the last
+   one being the end of raw; values is allocated on first access. */
+typedef struct {
+    zend_string* raw;
+    uint32_t* offsets;
+    uint32_t count;
+    zval* values;
+    zend_object std;
+} hiredis_lazy_reply_t;
+
+/* Consumer group reader. acks holds ids waiting for XACK; they are sent
+   in the same write as the next XREADGROUP. block_ms < 0 means no BLOCK. */
+typedef struct {
+    zval client;
+    zend_string* stream;
+    zend_string* group;
+    zend_string* consumer;
+    zend_long count;
+    zend_long block_ms;
+    int auto_ack;
+    zval acks;
+    zend_string* claim_cursor;
+    zend_object std;
+} hiredis_stream_consumer_t;
+#endif
+
+#define PHP_HIREDIS_HOTKEYS_DEPTH 4
+#define PHP_HIREDIS_HOTKEYS_WIDTH 2048
+#define PHP_HIREDIS_HOTKEYS_TOPK  32
+
+#define PHP_HIREDIS_INTERN_MAX 4096
+
+typedef struct {
+    char* key;
+    size_t key_len;
+    uint64_t hash;
+    uint32_t count;
+} hiredis_hotkey_t;
+
+ZEND_BEGIN_MODULE_GLOBALS(hiredis)
+    zend_bool use_uring;
+    zend_bool load_command_table;
+    HashTable* cmd_table;
+    int cmd_table_state;
+#if PHP_MAJOR_VERSION >= 7
+    zend_long shm_cache_size;
+    zend_long shm_cache_slot_size;
+    zend_long shm_cache_lease_ms;
+    zend_long hotkeys_sample_rate;
+    zend_long intern_max_len;
+    HashTable* intern_table;
+    zend_long sentinel_ttl_ms;
+    zend_bool sentinel_watch;
+    HashTable* sentinel_cache;
+    zend_long health_idle_ms;
+#ifdef HAVE_HIREDIS_SSL
+    zend_bool tls_ktls;
+    HashTable* tls_ctxs;
+    HashTable* tls_sessions;
+#endif
+#else
+    long hotkeys_sample_rate;
+#endif
+    long hotkeys_tick;
+    unsigned long hotkeys_samples;
+    uint32_t* hotkeys_sketch;
+    hiredis_hotkey_t hotkeys_top[PHP_HIREDIS_HOTKEYS_TOPK];
+    int hotkeys_top_len;
+#ifdef HAVE_HIREDIS_URING
+    struct io_uring ring;
+    int ring_state;
+    pid_t ring_pid;
+    char* ring_buf;
+#endif
+ZEND_END_MODULE_GLOBALS(hiredis)
+
+#ifdef ZTS
+#define HIREDIS_G(v) TSRMG(hiredis_globals_id, zend_hiredis_globals *, v)
+#else
+#define HIREDIS_G(v) (hiredis_globals.v)
+#endif
+
 extern zend_module_entry hiredis_module_entry;
 #define phpext_hiredis_ptr &hiredis_module_entry
 
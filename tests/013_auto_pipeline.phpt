@@ -0,0 +1,34 @@
+--TEST--
+Check Hiredis::setAutoPipeline
+--SKIPIF--
+<?php if (!extension_loaded("hiredis") || (int)shell_exec('netstat -tnlp | grep 6379 | grep redis-server | wc -l') < 1) print "skip"; ?>
+--FILE--
+<?php
+$h = new Hiredis();
+var_dump($h->connect('localhost', 6379));
+var_dump($h->setAutoPipeline(true));
+$set = $h->set('future1', 'bar');
+$get = $h->get('future1');
+$raw = $h->sendRaw('INCRBY', 'future2', 0);
+var_dump(get_class($get));
+var_dump($get->isReady());
+var_dump($get->get());
+var_dump($set->isReady());
+var_dump($set->get());
+var_dump(is_int($raw->get()));
+$h->del('future3');
+var_dump($h->flush());
+var_dump($h->setAutoPipeline(false));
+var_dump($h->exists('future3'));
+--EXPECT--
+bool(true)
+bool(true)
+string(13) "HiredisFuture"
+bool(false)
+string(3) "bar"
+bool(true)
+string(2) "OK"
+bool(true)
+bool(true)
+bool(true)
+int(0)
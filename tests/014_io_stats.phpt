@@ -0,0 +1,22 @@
+--TEST--
+Check Hiredis::getIoStats
+--SKIPIF--
+<?php if (!extension_loaded("hiredis") || (int)shell_exec('netstat -tnlp | grep 6379 | grep redis-server | wc -l') < 1) print "skip"; ?>
+--FILE--
+<?php
+$h = new Hiredis();
+var_dump($h->connect('localhost', 6379));
+$before = $h->getIoStats();
+var_dump($h->sendRaw('PING'));
+var_dump($h->sendRaw('PING'));
+$after = $h->getIoStats();
+var_dump(in_array($after['backend'], ['hiredis', 'io_uring']));
+var_dump($after['replies'] - $before['replies']);
+var_dump($after['syscalls'] > $before['syscalls']);
+--EXPECT--
+bool(true)
+string(4) "PONG"
+string(4) "PONG"
+bool(true)
+int(2)
+bool(true)
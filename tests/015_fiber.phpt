@@ -0,0 +1,62 @@
+--TEST--
+Check Hiredis::setFiberScheduler
+--SKIPIF--
+<?php if (!extension_loaded("hiredis") || PHP_VERSION_ID < 80100 || (int)shell_exec('netstat -tnlp | grep 6379 | grep redis-server | wc -l') < 1) print "skip"; ?>
+--FILE--
+<?php
+$watch = [];
+$scheduler = function ($stream, $writable, Fiber $fiber) use (&$watch) {
+    $watch[] = [$stream, $writable, $fiber];
+};
+$fibers = [];
+foreach ([1, 2] as $n) {
+    $fibers[$n] = new Fiber(function () use ($n, $scheduler) {
+        $h = new Hiredis();
+        $h->connect('localhost', 6379);
+        $h->setFiberScheduler($scheduler);
+        $h->set("fiber$n", "val$n");
+        return $h->get("fiber$n");
+    });
+    $fibers[$n]->start();
+}
+while ($watch) {
+    $r = $w = [];
+    foreach ($watch as $i => list($stream, $writable)) {
+        if ($writable) $w[$i] = $stream; else $r[$i] = $stream;
+    }
+    $e = null;
+    stream_select($r, $w, $e, 1);
+    foreach ($r + $w as $i => $stream) {
+        $fiber = $watch[$i][2];
+        unset($watch[$i]);
+        $fiber->resume();
+    }
+}
+var_dump($fibers[1]->getReturn());
+var_dump($fibers[2]->getReturn());
+
+// A client shared between Fibers is owned by the one waiting on a reply
+$h = new Hiredis();
+$h->connect('localhost', 6379);
+$h->setFiberScheduler($scheduler);
+$fiber = new Fiber(function () use ($h) {
+    return $h->blpop('fiber_busy_nokey', '0.2');
+});
+$fiber->start();
+var_dump($h->get('fiber1'), $h->getLastError());
+while ($watch) {
+    list($stream, , $f) = array_pop($watch);
+    $r = [$stream];
+    $w = $e = null;
+    stream_select($r, $w, $e, 1);
+    $f->resume();
+}
+var_dump($fiber->getReturn());
+var_dump($h->get('fiber1'));
+--EXPECT--
+string(4) "val1"
+string(4) "val2"
+bool(false)
+string(33) "Client is in use by another Fiber"
+NULL
+string(4) "val1"
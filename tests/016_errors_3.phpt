@@ -0,0 +1,31 @@
+--TEST--
+Check error replies nested in EXEC
+--SKIPIF--
+<?php if (!extension_loaded("hiredis") || (int)shell_exec('netstat -tnlp | grep 6379 | grep redis-server | wc -l') < 1) print "skip"; ?>
+--FILE--
+<?php
+$h = new Hiredis();
+$h->connect('localhost', 6379);
+$h->set('errs3', 'notanumber');
+var_dump($h->incr('errs3'));
+var_dump(strpos($h->getLastError(), 'ERR') === 0);
+$h->multi();
+$h->set('errs3', 'notanumber');
+$h->incr('errs3');
+$r = $h->exec();
+var_dump($r[0]);
+var_dump(get_class($r[1]));
+var_dump(strpos($r[1]->getMessage(), 'ERR') === 0);
+$h->setThrowExceptions(true);
+try {
+    $h->incr('errs3');
+} catch (HiredisException $e) {
+    var_dump(strpos($e->getMessage(), 'ERR') === 0);
+}
+--EXPECT--
+bool(false)
+bool(true)
+string(2) "OK"
+string(16) "HiredisException"
+bool(true)
+bool(true)
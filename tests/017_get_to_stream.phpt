@@ -0,0 +1,46 @@
+--TEST--
+Check Hiredis::getToStream
+--SKIPIF--
+<?php if (!extension_loaded("hiredis") || (int)shell_exec('netstat -tnlp | grep 6379 | grep redis-server | wc -l') < 1) print "skip"; ?>
+--FILE--
+<?php
+$h = new Hiredis();
+var_dump($h->connect('localhost', 6379));
+$value = str_repeat("0123456789abcdef\r\n", 20000);
+$h->set('stream1', $value);
+$h->del('stream2');
+$fp = fopen('php://memory', 'w+');
+var_dump($h->getToStream('stream1', $fp, 8192));
+rewind($fp);
+var_dump(stream_get_contents($fp) === $value);
+var_dump($h->getToStream('stream2', $fp));
+var_dump($h->sendRawArrayToStream(['GETRANGE', 'stream1', 0, 9], $fp));
+var_dump($h->sendRawArrayToStream(['INCR', 'stream1'], $fp));
+var_dump($h->getLastError() !== null);
+var_dump($h->sendRaw('PING'));
+// Non-bulk replies are decoded as usual and leave the connection usable
+$h->del('stream3', 'stream4');
+$h->sendRaw('RPUSH', 'stream4', 'a', 'b');
+var_dump($h->sendRawArrayToStream(['INCR', 'stream3'], $fp));
+var_dump($h->sendRawArrayToStream(['PING'], $fp));
+var_dump($h->sendRawArrayToStream(['LRANGE', 'stream4', 0, -1], $fp));
+var_dump($h->sendRaw('PING'));
+$h->del('stream1', 'stream3', 'stream4');
+--EXPECT--
+bool(true)
+int(360000)
+bool(true)
+NULL
+int(10)
+bool(false)
+bool(true)
+string(4) "PONG"
+int(1)
+string(4) "PONG"
+array(2) {
+  [0]=>
+  string(1) "a"
+  [1]=>
+  string(1) "b"
+}
+string(4) "PONG"
@@ -0,0 +1,43 @@
+--TEST--
+Check stream resources as command args
+--SKIPIF--
+<?php if (!extension_loaded("hiredis") || PHP_MAJOR_VERSION < 7 || (int)shell_exec('netstat -tnlp | grep 6379 | grep redis-server | wc -l') < 1) print "skip"; ?>
+--FILE--
+<?php
+$h = new Hiredis();
+var_dump($h->connect('localhost', 6379));
+$value = str_repeat("0123456789abcdef\r\n", 20000);
+$file = tempnam(sys_get_temp_dir(), 'hiredis');
+file_put_contents($file, $value);
+$fp = fopen($file, 'r');
+var_dump($h->sendRaw('SET', 'upload1', $fp));
+var_dump($h->get('upload1') === $value);
+fseek($fp, 18);
+var_dump($h->sendRawArray(['SET', 'upload1', new HiredisStreamArg($fp, 16)]));
+var_dump($h->get('upload1'));
+$mem = fopen('php://memory', 'w+');
+fwrite($mem, 'hello');
+rewind($mem);
+var_dump($h->sendRaw('SET', 'upload2', $mem));
+var_dump($h->getLastError() !== null);
+var_dump($h->sendRaw('SET', 'upload2', new HiredisStreamArg($mem, 5)));
+var_dump($h->get('upload2'));
+var_dump($h->sendRaw('PING'));
+$ctx = stream_context_create();
+var_dump($h->sendRaw('SET', 'upload3', $ctx));
+var_dump($h->get('upload3') === (string)$ctx);
+fclose($fp);
+unlink($file);
+--EXPECT--
+bool(true)
+string(2) "OK"
+bool(true)
+string(2) "OK"
+string(16) "0123456789abcdef"
+bool(false)
+bool(true)
+string(2) "OK"
+string(5) "hello"
+string(4) "PONG"
+string(2) "OK"
+bool(true)
@@ -0,0 +1,34 @@
+--TEST--
+Check Hiredis::getCommandInfo
+--SKIPIF--
+<?php if (!extension_loaded("hiredis") || PHP_MAJOR_VERSION < 7 || (int)shell_exec('netstat -tnlp | grep 6379 | grep redis-server | wc -l') < 1) print "skip"; ?>
+--FILE--
+<?php
+$h = new Hiredis();
+var_dump($h->connect('localhost', 6379));
+$get = $h->getCommandInfo('get');
+var_dump($get['arity'], in_array('readonly', $get['flags']), $get['first_key'], $get['last_key'], $get['key_step'], $get['loaded']);
+$mset = $h->getCommandInfo('MSET');
+var_dump(in_array('write', $mset['flags']), $mset['last_key'], $mset['key_step']);
+var_dump($h->getCommandInfo('NOSUCHCOMMAND'));
+// Random commands stay random with a loaded table from Redis 7+
+var_dump(in_array('random', $h->getCommandInfo('SRANDMEMBER')['flags']), in_array('random', $h->getCommandInfo('RANDOMKEY')['flags']));
+$h->del('cmdinfo1');
+var_dump($h->xadd('cmdinfo1', '*', 'a', 'b') !== false);
+var_dump($h->xlen('cmdinfo1'));
+--EXPECT--
+bool(true)
+int(2)
+bool(true)
+int(1)
+int(1)
+int(1)
+bool(true)
+bool(true)
+int(-1)
+int(2)
+NULL
+bool(true)
+bool(true)
+bool(true)
+int(1)
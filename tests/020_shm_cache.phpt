@@ -0,0 +1,41 @@
+--TEST--
+Check Hiredis::cachedGet and cachedHGetAll
+--SKIPIF--
+<?php if (!extension_loaded("hiredis") || PHP_MAJOR_VERSION < 7 || (int)shell_exec('netstat -tnlp | grep 6379 | grep redis-server | wc -l') < 1) print "skip"; ?>
+--INI--
+hiredis.shm_cache_size=1048576
+--FILE--
+<?php
+$h = new Hiredis();
+var_dump($h->connect('localhost', 6379));
+$h->set('shm1', 'a');
+$h->del('shm2');
+$h->hmset('shm3', 'f1', 'v1', 'f2', 'v2');
+var_dump($h->cachedGet('shm1', 60000));
+$h->set('shm1', 'b');
+var_dump($h->cachedGet('shm1', 60000));
+var_dump($h->cacheInvalidate('shm1'));
+var_dump($h->cachedGet('shm1', 60000));
+var_dump($h->cachedGet('shm2', 60000));
+var_dump($h->cachedHGetAll('shm3', 60000));
+var_dump($h->cachedHGetAll('shm3', 60000) === $h->hgetall('shm3'));
+var_dump($h->cachedGet('shm3', 60000));
+--EXPECT--
+bool(true)
+string(1) "a"
+string(1) "a"
+bool(true)
+string(1) "b"
+NULL
+array(4) {
+  [0]=>
+  string(2) "f1"
+  [1]=>
+  string(2) "v1"
+  [2]=>
+  string(2) "f2"
+  [3]=>
+  string(2) "v2"
+}
+bool(true)
+bool(false)
@@ -0,0 +1,38 @@
+--TEST--
+Check Hiredis::getHotKeys
+--SKIPIF--
+<?php if (!extension_loaded("hiredis") || (int)shell_exec('netstat -tnlp | grep 6379 | grep redis-server | wc -l') < 1) print "skip"; ?>
+--INI--
+hiredis.hotkeys_sample_rate=1
+--FILE--
+<?php
+$h = new Hiredis();
+var_dump($h->connect('localhost', 6379));
+for ($i = 0; $i < 50; $i++) {
+    $h->get('hot1');
+}
+// hot2 is seen 40 times and hot3 20 times, so their order is not a tie
+for ($i = 0; $i < 20; $i++) {
+    $h->get('hot2');
+    $h->get('hot2');
+    $h->sendRaw('mget', 'hot1', 'hot3');
+}
+$h->ping();
+$hot = $h->getHotKeys(2);
+var_dump(array_keys($hot));
+var_dump($hot['hot1'] >= 70, $hot['hot2'] >= 40);
+var_dump($h->resetHotKeys());
+var_dump($h->getHotKeys());
+--EXPECT--
+bool(true)
+array(2) {
+  [0]=>
+  string(4) "hot1"
+  [1]=>
+  string(4) "hot2"
+}
+bool(true)
+bool(true)
+bool(true)
+array(0) {
+}
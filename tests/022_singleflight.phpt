@@ -0,0 +1,48 @@
+--TEST--
+Check de-duplication of identical reads
+--SKIPIF--
+<?php if (!extension_loaded("hiredis") || PHP_MAJOR_VERSION < 7 || (int)shell_exec('netstat -tnlp | grep 6379 | grep redis-server | wc -l') < 1) print "skip"; ?>
+--FILE--
+<?php
+$h = new Hiredis();
+var_dump($h->connect('localhost', 6379));
+$h->mset('sf1', 'a', 'sf2', 'b');
+$h->del('sf3');
+var_dump($h->mget('sf1', 'sf2', 'sf1', 'sf3', 'sf2'));
+var_dump($h->setAutoPipeline(true));
+$a = $h->get('sf1');
+$b = $h->get('sf1');
+var_dump($a === $b);
+$h->set('sf1', 'c');
+$c = $h->get('sf1');
+var_dump($a === $c);
+$m = $h->mget('sf1', 'sf1');
+var_dump($a->get(), $b->get(), $c->get(), $m->get());
+var_dump($h->setAutoPipeline(false));
+--EXPECT--
+bool(true)
+array(5) {
+  [0]=>
+  string(1) "a"
+  [1]=>
+  string(1) "b"
+  [2]=>
+  string(1) "a"
+  [3]=>
+  NULL
+  [4]=>
+  string(1) "b"
+}
+bool(true)
+bool(true)
+bool(false)
+string(1) "a"
+string(1) "a"
+string(1) "c"
+array(2) {
+  [0]=>
+  string(1) "c"
+  [1]=>
+  string(1) "c"
+}
+bool(true)
@@ -0,0 +1,41 @@
+--TEST--
+Check Hiredis::setBackgroundReader
+--SKIPIF--
+<?php if (!extension_loaded("hiredis") || !method_exists('Hiredis', 'setBackgroundReader') || (int)shell_exec('netstat -tnlp | grep 6379 | grep redis-server | wc -l') < 1) print "skip"; ?>
+--FILE--
+<?php
+$h = new Hiredis();
+var_dump($h->connect('localhost', 6379));
+var_dump($h->setBackgroundReader(true));
+$h->del('bg1');
+for ($i = 0; $i < 2000; $i++) {
+    $h->appendRaw('RPUSH', 'bg1', $i);
+}
+var_dump($h->setBackgroundReader(false));
+$sum = 0;
+for ($i = 0; $i < 2000; $i++) {
+    $sum += $h->getReply();
+}
+var_dump($sum);
+$h->appendRaw('LRANGE', 'bg1', 0, 2);
+$h->appendRaw('HGET', 'bg1', 'x');
+var_dump($h->llen('bg1'));
+var_dump($h->getReply());
+var_dump($h->getReply());
+var_dump($h->getIoStats()['background_reader']);
+--EXPECT--
+bool(true)
+bool(true)
+bool(false)
+int(2001000)
+int(2000)
+array(3) {
+  [0]=>
+  string(1) "0"
+  [1]=>
+  string(1) "1"
+  [2]=>
+  string(1) "2"
+}
+bool(false)
+bool(true)
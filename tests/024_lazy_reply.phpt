@@ -0,0 +1,49 @@
+--TEST--
+Check lazily decoded array replies
+--SKIPIF--
+<?php if (!extension_loaded("hiredis") || PHP_MAJOR_VERSION < 7 || (int)shell_exec('netstat -tnlp | grep 6379 | grep redis-server | wc -l') < 1) print "skip"; ?>
+--FILE--
+<?php
+$h = new Hiredis();
+var_dump($h->connect('localhost', 6379));
+$h->del('lazy1', 'lazy2');
+$h->sendRawArray(array_merge(['RPUSH', 'lazy1'], range(0, 199)));
+$h->rpush('lazy2', 'a', 'b');
+var_dump($h->setLazyReplies(100));
+$r = $h->lrange('lazy1', 0, -1);
+var_dump(get_class($r), count($r), $r[0], $r['150'], isset($r[199]), isset($r[200]), $r[200]);
+$sum = 0;
+foreach ($r as $i => $v) {
+    $sum += $v;
+}
+var_dump($sum, $r->toArray() === array_map('strval', range(0, 199)));
+try {
+    $r[0] = 'x';
+} catch (HiredisException $e) {
+    var_dump($e->getMessage());
+}
+var_dump($h->lrange('lazy2', 0, -1));
+var_dump($h->setLazyReplies(0));
+var_dump(is_array($h->lrange('lazy1', 0, -1)));
+$h->del('lazy1', 'lazy2');
+--EXPECT--
+bool(true)
+bool(true)
+string(16) "HiredisLazyReply"
+int(200)
+string(1) "0"
+string(3) "150"
+bool(true)
+bool(false)
+NULL
+int(19900)
+bool(true)
+string(29) "HiredisLazyReply is read-only"
+array(2) {
+  [0]=>
+  string(1) "a"
+  [1]=>
+  string(1) "b"
+}
+bool(true)
+bool(true)
@@ -0,0 +1,31 @@
+--TEST--
+Check interning of short reply strings
+--SKIPIF--
+<?php if (!extension_loaded("hiredis") || PHP_MAJOR_VERSION < 7 || (int)shell_exec('netstat -tnlp | grep 6379 | grep redis-server | wc -l') < 1) print "skip"; ?>
+--FILE--
+<?php
+$h = new Hiredis();
+var_dump($h->connect('localhost', 6379));
+$long = str_repeat('x', 64);
+for ($i = 0; $i < 3; $i++) {
+    $h->hmset("intern$i", 'status', 'ok', 'n', (string)$i, 'e', '', 'long', $long);
+}
+$rows = [];
+for ($i = 0; $i < 3; $i++) {
+    $r = $h->hgetall("intern$i");
+    $rows[] = array_combine(array_values(array_filter($r, function ($k) { return $k % 2 == 0; }, ARRAY_FILTER_USE_KEY)),
+                            array_values(array_filter($r, function ($k) { return $k % 2 == 1; }, ARRAY_FILTER_USE_KEY)));
+}
+$rows[0]['status'] .= '!';
+var_dump($rows[0]['status'], $rows[1]['status'], $rows[2]['n'], $rows[2]['e'], $rows[1]['long'] === $long);
+ini_set('hiredis.intern_max_len', 0);
+var_dump($h->hget('intern1', 'status'));
+$h->del('intern0', 'intern1', 'intern2');
+--EXPECT--
+bool(true)
+string(3) "ok!"
+string(2) "ok"
+string(1) "2"
+string(0) ""
+bool(true)
+string(2) "ok"
@@ -0,0 +1,90 @@
+--TEST--
+Check HiredisStreamConsumer
+--SKIPIF--
+<?php if (!extension_loaded("hiredis") || PHP_MAJOR_VERSION < 7 || (int)shell_exec('netstat -tnlp | grep 6379 | grep redis-server | wc -l') < 1) print "skip"; ?>
+--FILE--
+<?php
+$h = new Hiredis();
+var_dump($h->connect('localhost', 6379));
+$h->del('xs1');
+$c = new HiredisStreamConsumer($h, 'xs1', 'g1', 'c1', ['count' => 2]);
+var_dump($c->createGroup('0'), $c->createGroup('0'));
+$h->xadd('xs1', '1-1', 'f', 'a');
+$h->xadd('xs1', '1-2', 'f', 'b', 'g', 'c');
+$h->xadd('xs1', '1-3', 'f', 'd');
+var_dump($c->read());
+var_dump($c->getPendingAcks());
+var_dump(array_keys($c->read()));
+var_dump($c->read());
+var_dump($h->xpending('xs1', 'g1')[0]);
+var_dump($c->flushAcks(), $h->xpending('xs1', 'g1')[0]);
+
+// Reclaim an entry another consumer never acknowledged
+$other = new HiredisStreamConsumer($h, 'xs1', 'g1', 'c2', ['auto_ack' => false]);
+$h->xadd('xs1', '1-4', 'f', 'e');
+var_dump(array_keys($other->read()));
+usleep(20000);
+var_dump($c->claim(10, '0-0'), $c->getClaimCursor());
+var_dump($c->ack('1-4'), $c->flushAcks());
+$h->del('xs1');
+
+// A failed XACK keeps its ids queued without losing the entries read
+$h->del('xs2');
+$bad = new HiredisStreamConsumer($h, 'xs2', 'g1', 'c1');
+$bad->createGroup('0');
+$h->xadd('xs2', '2-1', 'f', 'a');
+var_dump($bad->ack('bogus'));
+var_dump(array_keys($bad->read()));
+var_dump(strpos($h->getLastError(), 'ERR') === 0, $bad->getPendingAcks());
+var_dump($h->xpending('xs2', 'g1')[0]);
+$h->del('xs2');
+--EXPECT--
+bool(true)
+bool(true)
+bool(true)
+array(2) {
+  ["1-1"]=>
+  array(1) {
+    ["f"]=>
+    string(1) "a"
+  }
+  ["1-2"]=>
+  array(2) {
+    ["f"]=>
+    string(1) "b"
+    ["g"]=>
+    string(1) "c"
+  }
+}
+int(2)
+array(1) {
+  [0]=>
+  string(3) "1-3"
+}
+array(0) {
+}
+int(0)
+int(0)
+int(0)
+array(1) {
+  [0]=>
+  string(3) "1-4"
+}
+array(1) {
+  ["1-4"]=>
+  array(1) {
+    ["f"]=>
+    string(1) "e"
+  }
+}
+string(3) "0-0"
+int(2)
+int(1)
+int(1)
+array(1) {
+  [0]=>
+  string(3) "2-1"
+}
+bool(true)
+int(2)
+int(1)
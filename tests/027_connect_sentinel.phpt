@@ -0,0 +1,23 @@
+--TEST--
+Check connecting through Sentinel
+--SKIPIF--
+<?php if (!extension_loaded("hiredis") || PHP_MAJOR_VERSION < 7 || (int)shell_exec('netstat -tnlp | grep 26379 | grep redis-sentinel | wc -l') < 1) print "skip"; ?>
+--FILE--
+<?php
+$h = new Hiredis();
+var_dump($h->connectSentinel('mymaster', ['127.0.0.1:1']));
+var_dump($h->getLastError() !== null);
+var_dump($h->connectSentinel('mymaster', ['127.0.0.1:1', '127.0.0.1:26379']));
+var_dump($h->ping());
+// Served from the topology cache
+var_dump($h->connectSentinel('mymaster', ['127.0.0.1:26379']));
+var_dump($h->role()[0]);
+var_dump($h->connectSentinel('nosuchmaster', ['127.0.0.1:26379']));
+--EXPECT--
+bool(false)
+bool(true)
+bool(true)
+string(4) "PONG"
+bool(true)
+string(6) "master"
+bool(false)
@@ -0,0 +1,88 @@
+--TEST--
+Check hedged reads to replicas
+--SKIPIF--
+<?php if (!extension_loaded("hiredis") || PHP_MAJOR_VERSION < 7 || !getenv('TEST_PHP_EXECUTABLE') || (int)shell_exec('netstat -tnlp | grep 6379 | grep redis-server | wc -l') < 1) print "skip"; ?>
+--FILE--
+<?php
+$h = new Hiredis();
+var_dump($h->connect('localhost', 6379));
+var_dump($h->getHedgeStats());
+// The primary doubles as its own replica, so replies match either way
+var_dump($h->setHedging(['localhost:6379'], ['delay_us' => 1, 'budget' => 1]));
+$h->set('hedge1', 'v');
+for ($i = 0; $i < 50; $i++) {
+    if ($h->get('hedge1') !== 'v') {
+        echo "mismatch\n";
+    }
+}
+$h->multi();
+$h->get('hedge1');
+var_dump($h->exec());
+$s = $h->getHedgeStats();
+var_dump($s['over_budget'], $s['delay_us']['GET']);
+var_dump($h->setHedging(null));
+var_dump($h->getHedgeStats(), $h->get('hedge1'));
+$h->del('hedge1');
+
+// A primary behind a proxy that delays every request by 50ms loses to
+// the replica, which first gets the primary's SELECT
+$proxy = <<<'PHP'
+$srv = stream_socket_server('tcp://127.0.0.1:0');
+echo stream_socket_get_name($srv, false), "\n";
+$c = stream_socket_accept($srv, 10);
+$u = stream_socket_client('tcp://127.0.0.1:6379');
+for (;;) {
+    $r = [$c, $u];
+    $w = $e = null;
+    if (!stream_select($r, $w, $e, 10)) {
+        exit;
+    }
+    foreach ($r as $s) {
+        $d = fread($s, 65536);
+        if ($d === '' || $d === false) {
+            exit;
+        }
+        if ($s === $c) {
+            usleep(50000);
+            fwrite($u, $d);
+        } else {
+            fwrite($c, $d);
+        }
+    }
+}
+PHP;
+$p = proc_open(escapeshellarg(getenv('TEST_PHP_EXECUTABLE')) . ' -n -r ' . escapeshellarg($proxy), [1 => ['pipe', 'w']], $pipes);
+list(, $port) = explode(':', trim(fgets($pipes[1])));
+$h = new Hiredis();
+var_dump($h->connect('127.0.0.1', (int)$port));
+$h->select(9);
+$h->set('hedge2', 'db9');
+var_dump($h->setHedging(['127.0.0.1:6379'], ['delay_us' => 5000, 'budget' => 1]));
+usleep(20000);
+for ($i = 0; $i < 10; $i++) {
+    if ($h->get('hedge2') !== 'db9') {
+        echo "mismatch\n";
+    }
+}
+$s = $h->getHedgeStats();
+var_dump($s['hedged'] > 0, $s['won'] > 0);
+$h->del('hedge2');
+unset($h);
+proc_close($p);
+--EXPECT--
+bool(true)
+bool(false)
+bool(true)
+array(1) {
+  [0]=>
+  string(1) "v"
+}
+int(0)
+int(1)
+bool(true)
+bool(false)
+string(1) "v"
+bool(true)
+bool(true)
+bool(true)
+bool(true)
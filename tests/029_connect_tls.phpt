@@ -0,0 +1,38 @@
+--TEST--
+Check TLS connections and session resumption
+--SKIPIF--
+<?php if (!extension_loaded("hiredis") || !method_exists('Hiredis', 'connectTls') || !getenv('HIREDIS_TLS_CA') || (int)shell_exec('netstat -tnlp | grep 6380 | grep redis-server | wc -l') < 1) print "skip"; ?>
+--FILE--
+<?php
+// Expects redis-server --tls-port 6380 --port 6379 with certificates for
+// localhost signed by $HIREDIS_TLS_CA, and no client certificates
+$opts = ['ca_file' => getenv('HIREDIS_TLS_CA')];
+$h = new Hiredis();
+var_dump($h->connectTls('localhost', 6380, $opts));
+var_dump($h->set('tls1', str_repeat('x', 100000)));
+var_dump(strlen($h->get('tls1')));
+var_dump($h->getIoStats()['tls_resumed']);
+unset($h);
+
+// The session ticket from the first connection is reused
+$h2 = new Hiredis();
+var_dump($h2->connectTls('localhost', 6380, $opts));
+var_dump($h2->getIoStats()['tls_resumed']);
+var_dump($h2->del('tls1'));
+
+// Certificate checks
+$h3 = new Hiredis();
+var_dump($h3->connectTls('127.0.0.2', 6380, $opts + ['server_name' => 'wrong.example']));
+var_dump($h3->connectTls('127.0.0.2', 6380, $opts + ['server_name' => 'wrong.example', 'verify' => false]));
+var_dump($h3->ping());
+--EXPECT--
+bool(true)
+string(2) "OK"
+int(100000)
+bool(false)
+bool(true)
+bool(true)
+int(1)
+bool(false)
+bool(true)
+string(4) "PONG"
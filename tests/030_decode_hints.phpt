@@ -0,0 +1,69 @@
+--TEST--
+Check typed reply decoding hints
+--SKIPIF--
+<?php if (!extension_loaded("hiredis") || PHP_MAJOR_VERSION < 7 || (int)shell_exec('netstat -tnlp | grep 6379 | grep redis-server | wc -l') < 1) print "skip"; ?>
+--FILE--
+<?php
+$h = new Hiredis();
+var_dump($h->connect('localhost', 6379));
+$h->del('dec_z', 'dec_h');
+$h->zadd('dec_z', 1.5, 'a', 2, 'b', '+inf', 'c');
+$h->hset('dec_h', 'hits', 10, 'ratio', '0.25', 'name', 'x');
+
+var_dump($h->setDecodeHint('zrange', 'scores'));
+var_dump($h->zrange('dec_z', 0, -1, 'WITHSCORES'));
+var_dump($h->setDecodeHint('ZSCORE', 'double'));
+var_dump($h->zscore('dec_z', 'b'));
+var_dump($h->setDecodeHint('hgetall', 'map_numeric'));
+var_dump($h->hgetall('dec_h'));
+var_dump($h->setDecodeHint('hgetall', null));
+var_dump($h->hgetall('dec_h')[1]);
+
+var_dump($h->decodeNext('numeric'));
+var_dump($h->hmget('dec_h', 'hits', 'ratio', 'name'));
+var_dump($h->hget('dec_h', 'hits'));
+
+var_dump($h->decodeNext('info'));
+$info = $h->info();
+var_dump(is_int($info['server']['tcp_port']), is_array($info['keyspace']['db0']));
+var_dump($h->setDecodeHint('GET', 'bogus'), $h->getLastError());
+$h->del('dec_z', 'dec_h');
+--EXPECT--
+bool(true)
+bool(true)
+array(3) {
+  ["a"]=>
+  float(1.5)
+  ["b"]=>
+  float(2)
+  ["c"]=>
+  float(INF)
+}
+bool(true)
+float(2)
+bool(true)
+array(3) {
+  ["hits"]=>
+  int(10)
+  ["ratio"]=>
+  float(0.25)
+  ["name"]=>
+  string(1) "x"
+}
+bool(true)
+string(2) "10"
+bool(true)
+array(3) {
+  [0]=>
+  int(10)
+  [1]=>
+  float(0.25)
+  [2]=>
+  string(1) "x"
+}
+string(2) "10"
+bool(true)
+bool(true)
+bool(true)
+bool(false)
+string(19) "Unknown decode hint"
@@ -0,0 +1,63 @@
+--TEST--
+Check chunked MGET/HMGET/SMISMEMBER
+--SKIPIF--
+<?php if (!extension_loaded("hiredis") || PHP_MAJOR_VERSION < 7 || (int)shell_exec('netstat -tnlp | grep 6379 | grep redis-server | wc -l') < 1) print "skip"; ?>
+--FILE--
+<?php
+$h = new Hiredis();
+var_dump($h->connect('localhost', 6379));
+$keys = [];
+for ($i = 0; $i < 1000; $i++) {
+    $keys[] = "chunk:$i";
+}
+$h->del('chunk_h', 'chunk_s', ...$keys);
+$h->sendRawArray(array_merge(['MSET'], ...array_map(function ($k) { return [$k, "v$k"]; }, array_slice($keys, 0, 500))));
+$h->hset('chunk_h', 'a', 1, 'c', 3);
+$h->sadd('chunk_s', 'x', 'z');
+
+$r = $h->mgetChunked($keys, 64, false, 4);
+var_dump(count($r), $r[0], $r[499], $r[500], $r[999]);
+$r = $h->mgetChunked($keys, 7, true);
+var_dump(count($r), $r['chunk:10'], $r['chunk:700']);
+var_dump($h->mgetChunked([], 10));
+var_dump($h->hmgetChunked('chunk_h', ['a', 'b', 'c'], 2, true));
+var_dump($h->smismemberChunked('chunk_s', ['x', 'y', 'z'], 1));
+var_dump($h->mgetChunked($keys, 0), $h->getLastError());
+
+// An error reply fails the call but leaves the connection usable
+$h->set('chunk_str', 'x');
+var_dump($h->hmgetChunked('chunk_str', ['a', 'b', 'c'], 1));
+var_dump($h->ping());
+$h->del('chunk_h', 'chunk_s', 'chunk_str', ...$keys);
+--EXPECT--
+bool(true)
+int(1000)
+string(8) "vchunk:0"
+string(10) "vchunk:499"
+NULL
+NULL
+int(1000)
+string(9) "vchunk:10"
+NULL
+array(0) {
+}
+array(3) {
+  ["a"]=>
+  string(1) "1"
+  ["b"]=>
+  NULL
+  ["c"]=>
+  string(1) "3"
+}
+array(3) {
+  [0]=>
+  int(1)
+  [1]=>
+  int(0)
+  [2]=>
+  int(1)
+}
+bool(false)
+string(37) "Chunk size and window must be positive"
+bool(false)
+string(4) "PONG"
@@ -0,0 +1,61 @@
+--TEST--
+Check idle health checks and transparent reconnects
+--SKIPIF--
+<?php if (!extension_loaded("hiredis") || !method_exists('Hiredis', 'setHealthCheck') || (int)shell_exec('netstat -tnlp | grep 6379 | grep redis-server | wc -l') < 1) print "skip"; ?>
+--FILE--
+<?php
+$h = new Hiredis();
+$admin = new Hiredis();
+var_dump($h->connect('localhost', 6379), $admin->connect('localhost', 6379));
+var_dump($h->setHealthCheck(50));
+$h->select(2);
+$h->set('health1', 'db2');
+
+// Killed while idle: reconnects, and SELECT is replayed
+$admin->client('KILL', 'ID', $h->client('ID'));
+usleep(100000);
+var_dump($h->get('health1'));
+$s = $h->getIoStats();
+var_dump($s['health_checks'] >= 1, $s['health_reconnects']);
+
+// Busy connections are not checked
+$n = $h->getIoStats()['health_checks'];
+for ($i = 0; $i < 100; $i++) {
+    $h->ping();
+}
+var_dump($h->getIoStats()['health_checks'] - $n);
+
+// A rejected SELECT is not replayed, and entry points other than
+// sendRaw check too
+var_dump($h->select(100000));
+$admin->client('KILL', 'ID', $h->client('ID'));
+usleep(100000);
+var_dump($h->mgetChunked(['health1'], 10), $h->getIoStats()['health_reconnects']);
+
+// Inside MULTI the command fails instead
+$id = $h->client('ID');
+$h->multi();
+$admin->client('KILL', 'ID', $id);
+usleep(100000);
+var_dump($h->get('health1'));
+var_dump($h->getLastError());
+var_dump($h->reconnect(), $h->get('health1'));
+$h->del('health1');
+--EXPECT--
+bool(true)
+bool(true)
+bool(true)
+string(3) "db2"
+bool(true)
+int(1)
+int(0)
+bool(false)
+array(1) {
+  [0]=>
+  string(3) "db2"
+}
+int(2)
+bool(false)
+string(47) "Connection closed while idle inside MULTI/WATCH"
+bool(true)
+string(3) "db2"
@@ -0,0 +1,85 @@
+--TEST--
+Check migrateKeys copies keys with their TTL
+--SKIPIF--
+<?php if (!extension_loaded("hiredis") || PHP_MAJOR_VERSION < 7 || (int)shell_exec('netstat -tnlp | grep 6379 | grep redis-server | wc -l') < 1) print "skip"; ?>
+--FILE--
+<?php
+$src = new Hiredis();
+$dst = new Hiredis();
+var_dump($src->connect('localhost', 6379), $dst->connect('localhost', 6379));
+$dst->select(15);
+$keys = [];
+for ($i = 0; $i < 200; $i++) {
+    $keys[] = "mig:$i";
+}
+$src->del('mig:busy', 'mig:list', ...$keys);
+$dst->del('mig:busy', 'mig:list', ...$keys);
+foreach ($keys as $i => $k) {
+    $src->set($k, str_repeat('x', $i * 10));
+}
+$src->pexpire('mig:5', 100000);
+$src->rpush('mig:list', 'a', 'b');
+$src->set('mig:busy', 'src');
+$dst->set('mig:busy', 'dst');
+
+// Missing keys and BUSYKEY are reported per key without failing the call
+$r = $src->migrateKeys($dst, array_merge($keys, ['mig:missing', 'mig:busy']), 16);
+var_dump($r['migrated'], array_keys($r['errors']), strpos($r['errors']['mig:busy'], 'BUSYKEY') === 0, $r['errors']['mig:missing']);
+var_dump($dst->get('mig:1'), strlen($dst->get('mig:199')), $dst->get('mig:busy'));
+$ttl = $dst->pttl('mig:5');
+var_dump($ttl > 0 && $ttl <= 100000, $dst->pttl('mig:6'));
+
+// Any Traversable works, and replace overwrites existing keys
+$gen = (function () {
+    yield 'mig:busy';
+    yield 'mig:list';
+})();
+var_dump($src->migrateKeys($dst, $gen, 1, true));
+var_dump($dst->get('mig:busy'), $dst->lrange('mig:list', 0, -1));
+var_dump($src->migrateKeys($dst, [], 8));
+var_dump($src->migrateKeys($src, $keys), $src->getLastError());
+var_dump($src->ping(), $dst->ping());
+$src->del('mig:busy', 'mig:list', ...$keys);
+$dst->del('mig:busy', 'mig:list', ...$keys);
+--EXPECT--
+bool(true)
+bool(true)
+int(200)
+array(2) {
+  [0]=>
+  string(11) "mig:missing"
+  [1]=>
+  string(8) "mig:busy"
+}
+bool(true)
+string(15) "ERR no such key"
+string(10) "xxxxxxxxxx"
+int(1990)
+string(3) "dst"
+bool(true)
+int(-1)
+array(2) {
+  ["migrated"]=>
+  int(2)
+  ["errors"]=>
+  array(0) {
+  }
+}
+string(3) "src"
+array(2) {
+  [0]=>
+  string(1) "a"
+  [1]=>
+  string(1) "b"
+}
+array(2) {
+  ["migrated"]=>
+  int(0)
+  ["errors"]=>
+  array(0) {
+  }
+}
+bool(false)
+string(52) "Source and destination must be different connections"
+string(4) "PONG"
+string(4) "PONG"